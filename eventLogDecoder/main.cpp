@@ -0,0 +1,67 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "eventRecord.h"
+
+static void printUsage()
+{
+    std::cerr << "usage: EventLogDecoder [--json] <file>...\n";
+}
+
+/**
+ * @brief Prints the records of an event log file, one per line.
+ * @return Whether the whole file was decoded
+ */
+static bool decodeFile(const std::string& path, bool json)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << path << ": could not open the file\n";
+        return false;
+    }
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::string_view data = content;
+    if (!data.starts_with(Log::event_log_magic)) {
+        std::cerr << path << ": not an event log\n";
+        return false;
+    }
+    data.remove_prefix(Log::event_log_magic.size());
+
+    while (!data.empty()) {
+        std::size_t offset = content.size() - data.size();
+        try {
+            Log::EventRecord record = Log::decodeEventRecord(data);
+            std::cout << (json ? Log::formatEventRecordJson(record) : Log::formatEventRecordText(record)) << '\n';
+        } catch (const std::exception& e) {
+            // A record cut off by a crash is the usual cause, there is no way to resync
+            std::cerr << path << ": " << e.what() << " at offset " << offset << '\n';
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    bool json = false;
+    int first = 1;
+    if (argc > 1 && std::string_view(argv[1]) == "--json") {
+        json = true;
+        first = 2;
+    }
+    if (first >= argc) {
+        printUsage();
+        return 1;
+    }
+
+    int code = 0;
+    for (int i = first; i < argc; ++i) {
+        if (!decodeFile(argv[i], json))
+            code = 1;
+    }
+    return code;
+}
@@ -0,0 +1,224 @@
+#include "attachmentStore.h"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "definition.hpp"
+#include "mappedTable.h"
+#include "qls_error.h"
+
+namespace qls
+{
+
+/// Record of a blob in the index file
+struct BlobRecord
+{
+    char            hash[AttachmentStore::hash_size]; ///< Zeroed if the slot is free
+    std::uint64_t   offset;     ///< Position of the blob in its segment
+    std::uint64_t   size;
+    std::int64_t    ref_count;
+    std::uint32_t   segment;
+    std::uint32_t   reserved;
+};
+
+static_assert(sizeof(BlobRecord) == 96);
+
+struct AttachmentStoreImpl
+{
+    AttachmentStoreImpl(std::filesystem::path directory):
+        m_directory(std::move(directory)) {}
+
+    std::filesystem::path getSegmentPath(std::uint32_t segment) const
+    {
+        return m_directory / ("segment_" + std::to_string(segment));
+    }
+
+    /**
+     * @brief Finds a free slot of the index, the index grows if it is full.
+     *        The index mutex must be held.
+     */
+    std::size_t allocateSlot()
+    {
+        if (m_free_slots.empty()) {
+            std::size_t old_capacity = m_index->capacity();
+            m_index->grow();
+            for (std::size_t slot = m_index->capacity(); slot-- > old_capacity;)
+                m_free_slots.push_back(slot);
+        }
+        std::size_t slot = m_free_slots.back();
+        m_free_slots.pop_back();
+        return slot;
+    }
+
+    const std::filesystem::path m_directory;
+
+    std::unique_ptr<MappedTable>    m_index;
+    // Hash of every stored blob to its slot in the index
+    std::unordered_map<std::string, std::size_t, string_hash, std::equal_to<>>
+                                    m_slots;
+    std::vector<std::size_t>        m_free_slots;
+    mutable std::shared_mutex       m_index_mutex;
+
+    // Blobs are appended to the last segment one at a time
+    std::mutex                      m_segment_mutex;
+    std::uint32_t                   m_segment = 0;
+    std::uint64_t                   m_segment_size = 0;
+};
+
+AttachmentStore::AttachmentStore(std::filesystem::path directory):
+    m_impl(std::make_unique<AttachmentStoreImpl>(std::move(directory))) {}
+
+AttachmentStore::~AttachmentStore() noexcept = default;
+
+void AttachmentStore::init()
+{
+    std::filesystem::create_directories(m_impl->m_directory);
+
+    std::unique_lock<std::shared_mutex> lock(m_impl->m_index_mutex);
+    m_impl->m_index = std::make_unique<MappedTable>(
+        m_impl->m_directory / "index", sizeof(BlobRecord), 1024);
+    m_impl->m_slots.clear();
+    m_impl->m_free_slots.clear();
+    for (std::size_t slot = m_impl->m_index->capacity(); slot-- > 0;) {
+        BlobRecord record = m_impl->m_index->load<BlobRecord>(slot);
+        if (record.hash[0])
+            m_impl->m_slots.emplace(std::string(record.hash, hash_size), slot);
+        else
+            m_impl->m_free_slots.push_back(slot);
+    }
+
+    // Continue appending to the last segment
+    std::uint32_t last_segment = 0;
+    for (const auto& entry: std::filesystem::directory_iterator(m_impl->m_directory)) {
+        std::string name = entry.path().filename().string();
+        if (!name.starts_with("segment_"))
+            continue;
+        std::uint32_t segment = 0;
+        auto [ptr, ec] = std::from_chars(name.data() + 8, name.data() + name.size(), segment);
+        if (ec == std::errc{} && ptr == name.data() + name.size())
+            last_segment = std::max(last_segment, segment);
+    }
+    std::error_code ec;
+    std::uintmax_t segment_size = std::filesystem::file_size(m_impl->getSegmentPath(last_segment), ec);
+    m_impl->m_segment = last_segment;
+    m_impl->m_segment_size = ec ? 0 : segment_size;
+}
+
+bool AttachmentStore::isValidHash(std::string_view hash) noexcept
+{
+    return hash.size() == hash_size &&
+        std::all_of(hash.begin(), hash.end(), [](char c) {
+            return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+        });
+}
+
+bool AttachmentStore::addReference(std::string_view hash, std::uint64_t size)
+{
+    std::unique_lock<std::shared_mutex> lock(m_impl->m_index_mutex);
+    auto iter = m_impl->m_slots.find(hash);
+    if (iter == m_impl->m_slots.cend())
+        return false;
+    BlobRecord record = m_impl->m_index->load<BlobRecord>(iter->second);
+    if (record.size != size)
+        return false;
+    ++record.ref_count;
+    m_impl->m_index->store(iter->second, record);
+    return true;
+}
+
+void AttachmentStore::put(std::string_view hash, const std::filesystem::path& source)
+{
+    if (!isValidHash(hash))
+        throw std::system_error(qls_errc::invalid_file_hash);
+
+    // Holding the segment lock keeps the same blob from being appended twice
+    std::unique_lock<std::mutex> segment_lock(m_impl->m_segment_mutex);
+    std::uint64_t size = std::filesystem::file_size(source);
+    if (addReference(hash, size))
+        return;
+
+    if (m_impl->m_segment_size && m_impl->m_segment_size + size > max_segment_size) {
+        ++m_impl->m_segment;
+        m_impl->m_segment_size = 0;
+    }
+    const std::filesystem::path segment_path = m_impl->getSegmentPath(m_impl->m_segment);
+    bool appended = false;
+    {
+        std::ifstream in(source, std::ios::binary);
+        std::ofstream out(segment_path, std::ios::binary | std::ios::app);
+        if (!in || !out)
+            throw std::system_error(qls_errc::file_not_existed);
+        if (size)
+            out << in.rdbuf();
+        out.close();
+        appended = static_cast<bool>(out);
+    }
+    std::error_code ec;
+    if (!appended || std::filesystem::file_size(segment_path, ec) != m_impl->m_segment_size + size) {
+        // Cut off what a failed append wrote, the next blob is appended at the
+        // real end of the segment and its offset must match it
+        std::filesystem::resize_file(segment_path, m_impl->m_segment_size, ec);
+        if (ec) {
+            std::uintmax_t segment_size = std::filesystem::file_size(segment_path, ec);
+            if (!ec)
+                m_impl->m_segment_size = segment_size;
+        }
+        throw std::system_error(qls_errc::file_not_existed);
+    }
+
+    BlobRecord record{};
+    std::copy(hash.begin(), hash.end(), record.hash);
+    record.offset = m_impl->m_segment_size;
+    record.size = size;
+    record.ref_count = 1;
+    record.segment = m_impl->m_segment;
+    m_impl->m_segment_size += size;
+
+    // The blob is in its segment before the index refers to it
+    std::unique_lock<std::shared_mutex> lock(m_impl->m_index_mutex);
+    std::size_t slot = m_impl->allocateSlot();
+    m_impl->m_index->store(slot, record);
+    m_impl->m_slots.emplace(std::string(hash), slot);
+}
+
+void AttachmentStore::removeReference(std::string_view hash)
+{
+    std::unique_lock<std::shared_mutex> lock(m_impl->m_index_mutex);
+    auto iter = m_impl->m_slots.find(hash);
+    if (iter == m_impl->m_slots.cend())
+        throw std::system_error(qls_errc::file_not_existed);
+
+    std::size_t slot = iter->second;
+    BlobRecord record = m_impl->m_index->load<BlobRecord>(slot);
+    if (--record.ref_count > 0) {
+        m_impl->m_index->store(slot, record);
+        return;
+    }
+    // Free the slot, the content stays in its segment
+    m_impl->m_index->store(slot, BlobRecord{});
+    m_impl->m_slots.erase(iter);
+    m_impl->m_free_slots.push_back(slot);
+}
+
+std::shared_ptr<MappedFile> AttachmentStore::open(std::string_view hash) const
+{
+    BlobRecord record;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_impl->m_index_mutex);
+        auto iter = m_impl->m_slots.find(hash);
+        if (iter == m_impl->m_slots.cend())
+            throw std::system_error(qls_errc::file_not_existed);
+        record = m_impl->m_index->load<BlobRecord>(iter->second);
+    }
+    return std::make_shared<MappedFile>(m_impl->getSegmentPath(record.segment),
+        record.offset, static_cast<std::size_t>(record.size));
+}
+
+} // namespace qls
@@ -0,0 +1,87 @@
+#ifndef ATTACHMENT_STORE_H
+#define ATTACHMENT_STORE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+#include "mappedFile.h"
+
+namespace qls
+{
+
+struct AttachmentStoreImpl;
+
+/**
+ * @class AttachmentStore
+ * @brief Content-addressed storage of attachments.
+ *
+ * Blobs are stored once under their hash, however often they are uploaded.
+ * Their content is appended to segment files and the index of the blobs is a
+ * memory mapped table of fixed-size records, so reference counts are updated
+ * in place. Blobs whose count drops to zero leave a hole in their segment.
+ */
+class AttachmentStore final
+{
+public:
+    /// Digest of md_proxy the blobs are addressed by
+    static constexpr std::string_view hash_algorithm = "SHA3-256";
+    /// Length of a hash in hexadecimal
+    static constexpr std::size_t hash_size = 64;
+    /// A new segment is started once a segment reaches this size
+    static constexpr std::uint64_t max_segment_size = 256ull * 1024 * 1024;
+
+    AttachmentStore(std::filesystem::path directory);
+    AttachmentStore(const AttachmentStore&) = delete;
+    AttachmentStore(AttachmentStore&&) = delete;
+    ~AttachmentStore() noexcept;
+
+    AttachmentStore& operator=(const AttachmentStore&) = delete;
+    AttachmentStore& operator=(AttachmentStore&&) = delete;
+
+    /**
+     * @brief Opens the index and the segments, they are created if needed.
+     */
+    void init();
+
+    /**
+     * @brief Checks whether a string is a hash produced by hash_algorithm.
+     */
+    [[nodiscard]] static bool isValidHash(std::string_view hash) noexcept;
+
+    /**
+     * @brief Adds a reference to a stored blob.
+     * @param hash Hash of the blob
+     * @param size Size of the blob, a blob of another size doesn't match
+     * @return true if the blob is stored, false otherwise
+     */
+    bool addReference(std::string_view hash, std::uint64_t size);
+
+    /**
+     * @brief Stores a file as a blob with one reference.
+     *        If the blob is already stored, only a reference is added.
+     * @param hash Hash of the content, verified by the caller
+     * @param source File of the content
+     */
+    void put(std::string_view hash, const std::filesystem::path& source);
+
+    /**
+     * @brief Removes a reference to a blob, the blob is dropped with the last one.
+     * @throw std::system_error(qls_errc::file_not_existed)
+     */
+    void removeReference(std::string_view hash);
+
+    /**
+     * @brief Maps a blob for downloading.
+     * @throw std::system_error(qls_errc::file_not_existed)
+     */
+    [[nodiscard]] std::shared_ptr<MappedFile> open(std::string_view hash) const;
+
+private:
+    std::unique_ptr<AttachmentStoreImpl> m_impl;
+};
+
+} // namespace qls
+
+#endif // !ATTACHMENT_STORE_H
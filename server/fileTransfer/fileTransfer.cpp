@@ -0,0 +1,381 @@
+#include "fileTransfer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <openssl/rand.h>
+
+#include "md_proxy.hpp"
+#include "ossl_proxy.hpp"
+#include "mappedTable.h"
+#include "qls_error.h"
+#include "coarse_clock.hpp"
+
+namespace qls
+{
+
+/// Record of a file in the file table
+struct FileRecord
+{
+    enum State : std::int64_t
+    {
+        Free = 0,
+        Stored,
+        Removed     ///< Removed files keep their slot, so file IDs aren't reused
+    };
+
+    char            hash[AttachmentStore::hash_size];
+    std::int64_t    owner;
+    std::int64_t    size;
+    std::int64_t    state;
+    std::int64_t    id;     ///< Random ID of the file, see newFileID()
+};
+
+static_assert(sizeof(FileRecord) == 96);
+
+struct Upload
+{
+    Upload(ossl_proxy& ossl):
+        digest(ossl, AttachmentStore::hash_algorithm) {}
+
+    UserID          owner;
+    long long       file_size = 0;
+    long long       offset = 0;     ///< Bytes stored so far
+    bool            finished = false;
+    std::string     hash;           ///< Hash declared by the client
+    md_proxy        digest;         ///< Hash of the chunks stored so far
+    std::ofstream   stream;         ///< Partial file
+    std::chrono::steady_clock::time_point
+                    last_activity = CoarseClock::steadyNow();
+    std::mutex      mutex;
+};
+
+struct FileTransferManagerImpl
+{
+    FileTransferManagerImpl(std::filesystem::path directory):
+        m_directory(std::move(directory)),
+        m_store(m_directory / "blobs") {}
+
+    std::filesystem::path getPartialPath(long long upload_id) const
+    {
+        return m_directory / "uploads" / (std::to_string(upload_id) + ".part");
+    }
+
+    std::shared_ptr<Upload> getUpload(long long upload_id, UserID owner) const
+    {
+        std::shared_lock<std::shared_mutex> lock(m_uploads_mutex);
+        auto iter = m_uploads.find(upload_id);
+        // Uploads of other users look the same as missing ones
+        if (iter == m_uploads.cend() || iter->second->owner != owner)
+            throw std::system_error(qls_errc::upload_not_existed);
+        return iter->second;
+    }
+
+    /**
+     * @brief Gets the slot of a stored file, the files mutex must be held.
+     */
+    std::size_t getSlot(long long file_id) const
+    {
+        auto iter = m_file_slots.find(file_id);
+        if (iter == m_file_slots.cend())
+            throw std::system_error(qls_errc::file_not_existed);
+        return iter->second;
+    }
+
+    /**
+     * @brief Draws an unused file ID, the files mutex must be held.
+     *
+     * Anyone who knows a file ID can download the file, so the IDs are 62 random
+     * bits rather than a counter that a client could walk through.
+     */
+    long long newFileID() const
+    {
+        while (true) {
+            std::uint64_t value = 0;
+            if (RAND_bytes(reinterpret_cast<unsigned char*>(&value), sizeof(value)) != 1)
+                throw std::system_error(std::make_error_code(std::errc::resource_unavailable_try_again));
+            long long file_id = static_cast<long long>(value >> 2);
+            if (file_id > 0 && !m_file_slots.contains(file_id))
+                return file_id;
+        }
+    }
+
+    /**
+     * @brief Appends a file to the file table, the content must be referenced already.
+     * @return ID of the file
+     */
+    long long addFile(UserID owner, std::string_view hash, long long file_size)
+    {
+        FileRecord record{};
+        std::copy(hash.begin(), hash.end(), record.hash);
+        record.owner = owner.getOriginValue();
+        record.size = file_size;
+        record.state = FileRecord::Stored;
+
+        std::unique_lock<std::shared_mutex> lock(m_files_mutex);
+        record.id = newFileID();
+        if (m_file_count == m_files->capacity())
+            m_files->grow();
+        m_files->store(m_file_count, record);
+        m_file_slots.emplace(record.id, m_file_count++);
+        ++m_owned_blobs[{record.owner, std::string(hash)}];
+        return record.id;
+    }
+
+    /**
+     * @brief Counts a stored file of the table, the files mutex must be held.
+     */
+    void loadFile(const FileRecord& record, std::size_t slot)
+    {
+        m_file_slots.emplace(record.id, slot);
+        ++m_owned_blobs[{record.owner, std::string(record.hash, AttachmentStore::hash_size)}];
+    }
+
+    /**
+     * @brief Uncounts a removed file, the files mutex must be held.
+     */
+    void unloadFile(const FileRecord& record)
+    {
+        m_file_slots.erase(record.id);
+        auto iter = m_owned_blobs.find({record.owner, std::string(record.hash, AttachmentStore::hash_size)});
+        if (iter != m_owned_blobs.end() && --iter->second == 0)
+            m_owned_blobs.erase(iter);
+    }
+
+    const std::filesystem::path m_directory;
+
+    AttachmentStore             m_store;
+
+    std::unique_ptr<MappedTable> m_files;
+    std::size_t                 m_file_count = 0;   ///< Slots in use, stored and removed files
+    std::unordered_map<long long, std::size_t>
+                                m_file_slots;       ///< Slots of the stored files by ID
+    std::map<std::pair<std::int64_t, std::string>, std::size_t>
+                                m_owned_blobs;      ///< Stored files of each user by hash
+    mutable std::shared_mutex   m_files_mutex;
+
+    std::unordered_map<long long, std::shared_ptr<Upload>>
+                                m_uploads;
+    mutable std::shared_mutex   m_uploads_mutex;
+    std::atomic<long long>      m_newUploadId = 1;
+
+    static ossl_proxy           m_ossl_proxy;
+};
+
+ossl_proxy FileTransferManagerImpl::m_ossl_proxy;
+
+FileTransferManager::FileTransferManager(std::filesystem::path directory):
+    m_impl(std::make_unique<FileTransferManagerImpl>(std::move(directory))) {}
+
+FileTransferManager::~FileTransferManager() noexcept = default;
+
+void FileTransferManager::init()
+{
+    // The uploads of the last run can't be resumed
+    std::error_code ec;
+    std::filesystem::remove_all(m_impl->m_directory / "uploads", ec);
+    std::filesystem::create_directories(m_impl->m_directory / "uploads");
+    m_impl->m_store.init();
+
+    std::unique_lock<std::shared_mutex> lock(m_impl->m_files_mutex);
+    m_impl->m_files = std::make_unique<MappedTable>(
+        m_impl->m_directory / "files", sizeof(FileRecord), 1024);
+    std::size_t file_count = m_impl->m_files->capacity();
+    while (file_count > 0 &&
+        m_impl->m_files->load<FileRecord>(file_count - 1).state == FileRecord::Free)
+        --file_count;
+    m_impl->m_file_count = file_count;
+
+    m_impl->m_file_slots.clear();
+    m_impl->m_owned_blobs.clear();
+    for (std::size_t slot = 0; slot < file_count; ++slot) {
+        FileRecord record = m_impl->m_files->load<FileRecord>(slot);
+        if (record.state == FileRecord::Stored)
+            m_impl->loadFile(record, slot);
+    }
+}
+
+long long FileTransferManager::addFileReference(UserID owner, std::string_view hash, long long file_size)
+{
+    if (file_size < 0 || !AttachmentStore::isValidHash(hash))
+        return -1;
+    {
+        // Only a user who uploaded the content may skip the upload, a hash alone
+        // doesn't prove that the client has the content
+        std::shared_lock<std::shared_mutex> lock(m_impl->m_files_mutex);
+        if (!m_impl->m_owned_blobs.contains({owner.getOriginValue(), std::string(hash)}))
+            return -1;
+    }
+    if (!m_impl->m_store.addReference(hash, static_cast<std::uint64_t>(file_size)))
+        return -1;
+    return m_impl->addFile(owner, hash, file_size);
+}
+
+long long FileTransferManager::createUpload(UserID owner, long long file_size, std::string_view hash)
+{
+    if (file_size < 0 || file_size > max_file_size)
+        throw std::system_error(qls_errc::file_too_large);
+    if (!AttachmentStore::isValidHash(hash))
+        throw std::system_error(qls_errc::invalid_file_hash);
+
+    auto upload = std::make_shared<Upload>(m_impl->m_ossl_proxy);
+    upload->owner = owner;
+    upload->file_size = file_size;
+    upload->hash = hash;
+
+    std::unique_lock<std::shared_mutex> lock(m_impl->m_uploads_mutex);
+    std::size_t count = 0;
+    for (const auto& [id, other]: m_impl->m_uploads) {
+        if (other->owner == owner && ++count >= max_uploads_per_user)
+            throw std::system_error(qls_errc::too_many_uploads);
+    }
+
+    long long upload_id = m_impl->m_newUploadId++;
+    upload->stream.open(m_impl->getPartialPath(upload_id), std::ios::binary | std::ios::trunc);
+    if (!upload->stream)
+        throw std::system_error(qls_errc::file_not_existed);
+    m_impl->m_uploads.emplace(upload_id, std::move(upload));
+    return upload_id;
+}
+
+long long FileTransferManager::getUploadOffset(long long upload_id, UserID owner) const
+{
+    auto upload = m_impl->getUpload(upload_id, owner);
+    std::unique_lock<std::mutex> lock(upload->mutex);
+    // A client that asks where to resume is still there
+    upload->last_activity = CoarseClock::steadyNow();
+    return upload->offset;
+}
+
+bool FileTransferManager::writeUploadChunk(long long upload_id, UserID owner,
+    long long offset, std::string_view data)
+{
+    auto upload = m_impl->getUpload(upload_id, owner);
+    std::unique_lock<std::mutex> lock(upload->mutex);
+    if (upload->finished)
+        throw std::system_error(qls_errc::upload_not_existed);
+    if (offset != upload->offset)
+        throw std::system_error(qls_errc::upload_offset_mismatched);
+    if (static_cast<long long>(data.size()) > upload->file_size - upload->offset)
+        throw std::system_error(qls_errc::file_too_large);
+    upload->last_activity = CoarseClock::steadyNow();
+
+    // Stream the chunk to disk, nothing is kept in memory
+    upload->stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!upload->stream)
+        throw std::system_error(qls_errc::file_not_existed);
+    upload->digest.update(data);
+    upload->offset += static_cast<long long>(data.size());
+    return upload->offset == upload->file_size;
+}
+
+long long FileTransferManager::finishUpload(long long upload_id, UserID owner)
+{
+    auto upload = m_impl->getUpload(upload_id, owner);
+    bool matched = false;
+    std::exception_ptr exception;
+    {
+        std::unique_lock<std::mutex> lock(upload->mutex);
+        if (upload->finished)
+            throw std::system_error(qls_errc::upload_not_existed);
+        if (upload->offset < upload->file_size)
+            throw std::system_error(qls_errc::upload_offset_mismatched);
+
+        upload->finished = true;
+        upload->stream.close();
+        try {
+            matched = upload->digest() == upload->hash;
+            if (matched)
+                m_impl->m_store.put(upload->hash, m_impl->getPartialPath(upload_id));
+        } catch (...) {
+            exception = std::current_exception();
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::remove(m_impl->getPartialPath(upload_id), ec);
+    {
+        std::unique_lock<std::shared_mutex> lock(m_impl->m_uploads_mutex);
+        m_impl->m_uploads.erase(upload_id);
+    }
+    if (exception)
+        std::rethrow_exception(exception);
+    if (!matched)
+        throw std::system_error(qls_errc::file_hash_mismatched);
+    return m_impl->addFile(owner, upload->hash, upload->file_size);
+}
+
+void FileTransferManager::removeIdleUploads()
+{
+    const auto deadline = CoarseClock::steadyNow() - upload_idle_timeout;
+    std::vector<long long> removed;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_impl->m_uploads_mutex);
+        for (auto iter = m_impl->m_uploads.begin(); iter != m_impl->m_uploads.end();) {
+            Upload& upload = *iter->second;
+            // An upload that is writing a chunk isn't idle
+            std::unique_lock<std::mutex> upload_lock(upload.mutex, std::try_to_lock);
+            if (!upload_lock.owns_lock() || upload.finished || upload.last_activity > deadline) {
+                ++iter;
+                continue;
+            }
+            // A chunk that arrives later finds the upload finished
+            upload.finished = true;
+            upload.stream.close();
+            removed.push_back(iter->first);
+            upload_lock.unlock();
+            iter = m_impl->m_uploads.erase(iter);
+        }
+    }
+
+    for (long long upload_id: removed) {
+        std::error_code ec;
+        std::filesystem::remove(m_impl->getPartialPath(upload_id), ec);
+    }
+}
+
+void FileTransferManager::removeFile(long long file_id, UserID owner)
+{
+    std::string hash;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_impl->m_files_mutex);
+        std::size_t slot = m_impl->getSlot(file_id);
+        FileRecord record = m_impl->m_files->load<FileRecord>(slot);
+        // Files of other users look the same as missing ones
+        if (record.owner != owner.getOriginValue())
+            throw std::system_error(qls_errc::file_not_existed);
+        record.state = FileRecord::Removed;
+        m_impl->m_files->store(slot, record);
+        m_impl->unloadFile(record);
+        hash.assign(record.hash, AttachmentStore::hash_size);
+    }
+    m_impl->m_store.removeReference(hash);
+}
+
+bool FileTransferManager::hasFile(long long file_id) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_impl->m_files_mutex);
+    return m_impl->m_file_slots.contains(file_id);
+}
+
+std::shared_ptr<MappedFile> FileTransferManager::openFile(long long file_id) const
+{
+    std::string hash;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_impl->m_files_mutex);
+        FileRecord record = m_impl->m_files->load<FileRecord>(m_impl->getSlot(file_id));
+        hash.assign(record.hash, AttachmentStore::hash_size);
+    }
+    return m_impl->m_store.open(hash);
+}
+
+} // namespace qls
@@ -0,0 +1,143 @@
+#ifndef FILE_TRANSFER_H
+#define FILE_TRANSFER_H
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+#include "userid.hpp"
+#include "mappedFile.h"
+#include "attachmentStore.h"
+
+namespace qls
+{
+
+struct FileTransferManagerImpl;
+
+/**
+ * @class FileTransferManager
+ * @brief Receives attachment uploads and serves the stored attachments.
+ *
+ * An upload is created with its final size and hash, then its content arrives
+ * in FileStream data packages whose requestID is the upload ID. Chunks are
+ * appended to a partial file on disk as they arrive, so an interrupted
+ * upload can be resumed from getUploadOffset(), even on a new connection.
+ *
+ * The content is kept in an AttachmentStore, so an attachment that is sent
+ * again is stored once. A file ID is a reference of a user to a blob, the
+ * file IDs are kept in a memory mapped table as well. File IDs are random,
+ * they are handed to the users who may download the file.
+ */
+class FileTransferManager final
+{
+public:
+    /// Maximum size of an attachment
+    static constexpr long long max_file_size = 1024ll * 1024 * 1024;
+    /// Maximum number of unfinished uploads of a user
+    static constexpr std::size_t max_uploads_per_user = 8;
+    /// Uploads that receive nothing for this long are dropped
+    static constexpr std::chrono::minutes upload_idle_timeout{10};
+
+    FileTransferManager(std::filesystem::path directory = "files");
+    FileTransferManager(const FileTransferManager&) = delete;
+    FileTransferManager(FileTransferManager&&) = delete;
+    ~FileTransferManager() noexcept;
+
+    FileTransferManager& operator=(const FileTransferManager&) = delete;
+    FileTransferManager& operator=(FileTransferManager&&) = delete;
+
+    /**
+     * @brief Opens the attachment store and removes partial files
+     *        left by the last run.
+     */
+    void init();
+
+    /**
+     * @brief Adds a file of a user for an attachment that the user stored
+     *        before, so the upload can be skipped. Content that only other
+     *        users stored must be uploaded, it is still stored once.
+     * @param owner User who sends the file
+     * @param hash Hash of the content, see AttachmentStore::hash_algorithm
+     * @param file_size Size of the whole file
+     * @return ID of the new file, or -1 if the user has no file with the content
+     */
+    [[nodiscard]] long long addFileReference(UserID owner, std::string_view hash, long long file_size);
+
+    /**
+     * @brief Starts an upload.
+     * @param owner User who uploads the file
+     * @param file_size Size of the whole file
+     * @param hash Hash of the content, it is verified when the upload is complete
+     * @return ID of the upload
+     * @throw std::system_error(qls_errc::file_too_large) if the file is too large,
+     *        std::system_error(qls_errc::too_many_uploads) if the user has
+     *        max_uploads_per_user unfinished uploads,
+     *        std::system_error(qls_errc::invalid_file_hash)
+     */
+    [[nodiscard]] long long createUpload(UserID owner, long long file_size, std::string_view hash);
+
+    /**
+     * @brief Gets how many bytes of an upload have been stored.
+     * @throw std::system_error(qls_errc::upload_not_existed)
+     */
+    [[nodiscard]] long long getUploadOffset(long long upload_id, UserID owner) const;
+
+    /**
+     * @brief Appends a chunk to an upload.
+     * @param upload_id ID of the upload
+     * @param owner User who sent the chunk
+     * @param offset Position of the chunk in the file, must equal getUploadOffset()
+     * @param data Content of the chunk
+     * @return Whether the upload has all its bytes and can be finished
+     * @throw std::system_error(qls_errc::upload_not_existed),
+     *        std::system_error(qls_errc::upload_offset_mismatched),
+     *        std::system_error(qls_errc::file_too_large)
+     */
+    bool writeUploadChunk(long long upload_id, UserID owner,
+        long long offset, std::string_view data);
+
+    /**
+     * @brief Checks the hash of an upload that has all its bytes and stores it.
+     *        The content is copied into the attachment store, so it should be
+     *        called on the worker pool. The upload is dropped afterwards.
+     * @param upload_id ID of the upload
+     * @param owner User who sent the upload
+     * @return ID of the stored file
+     * @throw std::system_error(qls_errc::upload_not_existed),
+     *        std::system_error(qls_errc::upload_offset_mismatched) if bytes are missing,
+     *        std::system_error(qls_errc::file_hash_mismatched)
+     */
+    long long finishUpload(long long upload_id, UserID owner);
+
+    /**
+     * @brief Drops the uploads that received nothing for upload_idle_timeout,
+     *        with their partial files. Called periodically by the manager.
+     */
+    void removeIdleUploads();
+
+    /**
+     * @brief Removes a file of a user, its content is dropped with the last file.
+     * @throw std::system_error(qls_errc::file_not_existed)
+     */
+    void removeFile(long long file_id, UserID owner);
+
+    /**
+     * @brief Checks whether a file is stored.
+     */
+    [[nodiscard]] bool hasFile(long long file_id) const;
+
+    /**
+     * @brief Maps a stored file for downloading, knowing the file ID is the
+     *        permission to download it.
+     * @throw std::system_error(qls_errc::file_not_existed)
+     */
+    [[nodiscard]] std::shared_ptr<MappedFile> openFile(long long file_id) const;
+
+private:
+    std::unique_ptr<FileTransferManagerImpl> m_impl;
+};
+
+} // namespace qls
+
+#endif // !FILE_TRANSFER_H
@@ -0,0 +1,125 @@
+#include "mappedFile.h"
+
+#include <system_error>
+
+#ifdef _WIN32
+#   include <Windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+#include "qls_error.h"
+
+namespace qls
+{
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::filesystem::path& path, std::uint64_t offset, std::size_t size)
+{
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::system_error(qls_errc::file_not_existed);
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) ||
+        offset + size > static_cast<std::uint64_t>(file_size.QuadPart)) {
+        CloseHandle(file);
+        throw std::system_error(qls_errc::file_not_existed);
+    }
+    m_file = file;
+    m_size = size;
+    // Empty ranges can't be mapped
+    if (!m_size)
+        return;
+
+    // Views start at a multiple of the allocation granularity
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    std::uint64_t view_offset = offset - offset % system_info.dwAllocationGranularity;
+
+    m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping)
+        m_view = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ,
+            static_cast<DWORD>(view_offset >> 32), static_cast<DWORD>(view_offset),
+            static_cast<SIZE_T>(offset - view_offset + size)));
+    if (!m_view) {
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        CloseHandle(file);
+        throw std::system_error(qls_errc::file_not_existed);
+    }
+    m_data = m_view + (offset - view_offset);
+}
+
+MappedFile::~MappedFile() noexcept
+{
+    if (m_view)
+        UnmapViewOfFile(m_view);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path& path, std::uint64_t offset, std::size_t size)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::system_error(qls_errc::file_not_existed);
+
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) != 0 ||
+        offset + size > static_cast<std::uint64_t>(file_stat.st_size)) {
+        ::close(fd);
+        throw std::system_error(qls_errc::file_not_existed);
+    }
+    m_size = size;
+    // Empty ranges can't be mapped
+    if (!m_size) {
+        ::close(fd);
+        return;
+    }
+
+    // Mappings start at a page boundary
+    static const std::uint64_t page_size = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+    std::uint64_t view_offset = offset - offset % page_size;
+    std::size_t view_size = static_cast<std::size_t>(offset - view_offset) + size;
+
+    void* view = ::mmap(nullptr, view_size, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(view_offset));
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+    if (view == MAP_FAILED)
+        throw std::system_error(qls_errc::file_not_existed);
+    // Downloads read the file from the beginning to the end
+    ::madvise(view, view_size, MADV_SEQUENTIAL);
+    m_view = static_cast<const char*>(view);
+    m_data = m_view + (offset - view_offset);
+}
+
+MappedFile::~MappedFile() noexcept
+{
+    if (m_view)
+        ::munmap(const_cast<char*>(m_view), static_cast<std::size_t>(m_data - m_view) + m_size);
+}
+
+#endif
+
+std::string_view MappedFile::getData() const noexcept
+{
+    return m_data ? std::string_view(m_data, m_size) : std::string_view();
+}
+
+std::size_t MappedFile::size() const noexcept
+{
+    return m_size;
+}
+
+} // namespace qls
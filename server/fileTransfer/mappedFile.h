@@ -0,0 +1,59 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+namespace qls
+{
+
+/**
+ * @class MappedFile
+ * @brief Read-only memory mapping of a range of a file.
+ *
+ * Downloads are served from the page cache through the mapping, so no copy
+ * of the file is kept in user memory. The mapping stays valid as long as the
+ * object lives, even if the file is removed meanwhile.
+ */
+class MappedFile final
+{
+public:
+    /**
+     * @brief Maps a range of a file.
+     * @param path Path of the file
+     * @param offset Position of the range in the file
+     * @param size Size of the range
+     * @throw std::system_error(qls_errc::file_not_existed) if the range can't be mapped
+     */
+    MappedFile(const std::filesystem::path& path, std::uint64_t offset, std::size_t size);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    ~MappedFile() noexcept;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    /**
+     * @brief Gets the content of the file.
+     */
+    [[nodiscard]] std::string_view getData() const noexcept;
+
+    /**
+     * @brief Gets the size of the file.
+     */
+    [[nodiscard]] std::size_t size() const noexcept;
+
+private:
+    const char* m_view = nullptr;   ///< Start of the mapping, aligned down from the range
+    const char* m_data = nullptr;
+    std::size_t m_size = 0;
+#ifdef _WIN32
+    void*       m_file = nullptr;
+    void*       m_mapping = nullptr;
+#endif
+};
+
+} // namespace qls
+
+#endif // !MAPPED_FILE_H
@@ -0,0 +1,154 @@
+#include "mappedTable.h"
+
+#include <system_error>
+
+#ifdef _WIN32
+#   include <Windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+#include "qls_error.h"
+
+namespace qls
+{
+
+#ifdef _WIN32
+
+MappedTable::MappedTable(const std::filesystem::path& path, std::size_t record_size,
+    std::size_t initial_capacity):
+    m_record_size(record_size)
+{
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+        nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::system_error(qls_errc::file_not_existed);
+    m_file = file;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        throw std::system_error(qls_errc::file_not_existed);
+    }
+    std::size_t capacity = static_cast<std::size_t>(file_size.QuadPart) / record_size;
+    try {
+        map(capacity ? capacity : initial_capacity);
+    } catch (...) {
+        CloseHandle(file);
+        throw;
+    }
+}
+
+MappedTable::~MappedTable() noexcept
+{
+    unmap();
+    if (m_file)
+        CloseHandle(m_file);
+}
+
+void MappedTable::map(std::size_t capacity)
+{
+    // The mapping extends the file with zeros
+    unsigned long long size = static_cast<unsigned long long>(capacity) * m_record_size;
+    m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READWRITE,
+        static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+    if (m_mapping)
+        m_data = static_cast<char*>(MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, 0));
+    if (!m_data) {
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        m_mapping = nullptr;
+        throw std::system_error(qls_errc::file_not_existed);
+    }
+    m_capacity = capacity;
+}
+
+void MappedTable::unmap() noexcept
+{
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    m_data = nullptr;
+    m_mapping = nullptr;
+}
+
+#else
+
+MappedTable::MappedTable(const std::filesystem::path& path, std::size_t record_size,
+    std::size_t initial_capacity):
+    m_record_size(record_size)
+{
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (m_fd < 0)
+        throw std::system_error(qls_errc::file_not_existed);
+
+    struct stat file_stat;
+    if (::fstat(m_fd, &file_stat) != 0) {
+        ::close(m_fd);
+        throw std::system_error(qls_errc::file_not_existed);
+    }
+    std::size_t capacity = static_cast<std::size_t>(file_stat.st_size) / record_size;
+    try {
+        map(capacity ? capacity : initial_capacity);
+    } catch (...) {
+        ::close(m_fd);
+        throw;
+    }
+}
+
+MappedTable::~MappedTable() noexcept
+{
+    unmap();
+    if (m_fd >= 0)
+        ::close(m_fd);
+}
+
+void MappedTable::map(std::size_t capacity)
+{
+    // Extending the file fills it with zeros
+    off_t size = static_cast<off_t>(capacity * m_record_size);
+    struct stat file_stat;
+    if (::fstat(m_fd, &file_stat) != 0 ||
+        (file_stat.st_size < size && ::ftruncate(m_fd, size) != 0))
+        throw std::system_error(qls_errc::file_not_existed);
+
+    void* data = ::mmap(nullptr, static_cast<std::size_t>(size),
+        PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED)
+        throw std::system_error(qls_errc::file_not_existed);
+    m_data = static_cast<char*>(data);
+    m_capacity = capacity;
+}
+
+void MappedTable::unmap() noexcept
+{
+    if (m_data)
+        ::munmap(m_data, m_capacity * m_record_size);
+    m_data = nullptr;
+}
+
+#endif
+
+std::size_t MappedTable::capacity() const noexcept
+{
+    return m_capacity;
+}
+
+void MappedTable::grow()
+{
+    std::size_t capacity = m_capacity;
+    unmap();
+    try {
+        map(capacity * 2);
+    } catch (...) {
+        // Keep the table usable
+        map(capacity);
+        throw;
+    }
+}
+
+} // namespace qls
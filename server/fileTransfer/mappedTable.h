@@ -0,0 +1,84 @@
+#ifndef MAPPED_TABLE_H
+#define MAPPED_TABLE_H
+
+#include <cstring>
+#include <filesystem>
+#include <type_traits>
+
+namespace qls
+{
+
+/**
+ * @class MappedTable
+ * @brief Writable memory mapping of a file of fixed-size records.
+ *
+ * Records are read and written in place, so an update reaches the file
+ * without any explicit write. The table grows by doubling the file, which
+ * remaps it, so record pointers must not be kept across grow().
+ * The table isn't synchronized, the owner locks it.
+ */
+class MappedTable final
+{
+public:
+    /**
+     * @brief Opens a table, the file is created with initial_capacity records
+     *        if it doesn't exist.
+     * @param path Path of the file
+     * @param record_size Size of a record
+     * @param initial_capacity Number of records of a new file
+     * @throw std::system_error(qls_errc::file_not_existed) if the file can't be mapped
+     */
+    MappedTable(const std::filesystem::path& path, std::size_t record_size,
+        std::size_t initial_capacity);
+    MappedTable(const MappedTable&) = delete;
+    MappedTable(MappedTable&&) = delete;
+    ~MappedTable() noexcept;
+
+    MappedTable& operator=(const MappedTable&) = delete;
+    MappedTable& operator=(MappedTable&&) = delete;
+
+    /**
+     * @brief Gets how many records the file can hold.
+     */
+    [[nodiscard]] std::size_t capacity() const noexcept;
+
+    /**
+     * @brief Doubles the capacity, the new records are zeroed.
+     * @throw std::system_error(qls_errc::file_not_existed) if the file can't be remapped
+     */
+    void grow();
+
+    template<class Record>
+        requires std::is_trivially_copyable_v<Record>
+    [[nodiscard]] Record load(std::size_t index) const noexcept
+    {
+        Record record;
+        std::memcpy(&record, m_data + index * m_record_size, sizeof(Record));
+        return record;
+    }
+
+    template<class Record>
+        requires std::is_trivially_copyable_v<Record>
+    void store(std::size_t index, const Record& record) noexcept
+    {
+        std::memcpy(m_data + index * m_record_size, &record, sizeof(Record));
+    }
+
+private:
+    void map(std::size_t capacity);
+    void unmap() noexcept;
+
+    const std::size_t   m_record_size;
+    char*               m_data = nullptr;
+    std::size_t         m_capacity = 0;
+#ifdef _WIN32
+    void*               m_file = nullptr;
+    void*               m_mapping = nullptr;
+#else
+    int                 m_fd = -1;
+#endif
+};
+
+} // namespace qls
+
+#endif // !MAPPED_TABLE_H
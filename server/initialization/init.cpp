@@ -27,6 +27,7 @@ void Init::createConfig()
         qini::INIObject ini;
         ini["server"]["host"] = "0.0.0.0";
         ini["server"]["port"] = std::to_string(55555);
+        ini["server"]["max_frame_size"] = std::to_string(Package::default_max_frame_size);
 
         ini["mysql"]["host"] = "127.0.0.1";
         ini["mysql"]["port"] = std::to_string(3306);
@@ -82,6 +83,15 @@ int init()
         if (std::stoll(serverIni["mysql"]["port"]) < 0)
             throw std::logic_error("INI configuration file section: mysql, key: port, the port is too small!");
 
+        // Older configuration files don't have it, the default is kept
+        if (!serverIni["server"]["max_frame_size"].empty()) {
+            long long max_frame_size = std::stoll(serverIni["server"]["max_frame_size"]);
+            if (max_frame_size < static_cast<long long>(sizeof(DataPackage)))
+                throw std::logic_error("INI configuration file section: server, key: max_frame_size, the size is too small!");
+            serverNetwork.setMaxFrameSize(static_cast<std::size_t>(max_frame_size));
+        }
+        serverLogger.info("Maximum frame size: ", serverNetwork.getMaxFrameSize());
+
         // Read cert & key
         {
             {
@@ -41,6 +41,11 @@ public:
     {
         SET_A_COMMAND(stop);
         SET_A_COMMAND(show_user);
+        SET_A_COMMAND(show_workload);
+        SET_A_COMMAND(show_timers);
+        SET_A_COMMAND(show_locks);
+        SET_A_COMMAND(log_level);
+        SET_A_COMMAND(event_log);
     }
 
     ~InputImpl() = default;
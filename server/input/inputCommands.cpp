@@ -1,6 +1,11 @@
 #include "inputCommands.h"
 
+#include <algorithm>
 #include <format>
+#include <iostream>
+#include <iterator>
+#include <span>
+#include <utility>
 
 #include <option.hpp>
 
@@ -11,9 +16,16 @@
 #include "manager.h"
 #include "SQLProcess.hpp"
 #include "logger.hpp"
+#include "eventLog.h"
+#include "JsonMsgProcess.h"
+#include "JsonMsgProcessCommand.h"
+#include "adaptive_mutex.hpp"
+#include "profiled_shared_mutex.hpp"
 
 // 服务器log系统
 extern Log::Logger serverLogger;
+// server event log
+extern Log::EventLogger serverEventLogger;
 // ini配置
 extern qini::INIObject serverIni;
 // manager
@@ -50,4 +62,209 @@ CommandInfo show_user_command::registerCommand()
     return {{}, "show user's infomation"};
 }
 
+bool show_workload_command::execute()
+{
+    auto& pool = serverManager.getServerWorkerPool();
+    serverLogger.info(std::format("Worker pool: {} threads, {}/{} tasks queued\n",
+        pool.getThreadNum(), pool.getQueueSize(), pool.getCapacity()));
+
+    constexpr std::string_view cost_class_names[] = {"light", "heavy"};
+    for (int i = 0; i < JsonMessageCommand::CostClassCount; ++i) {
+        auto statistics = JsonMessageProcess::getCostStatistics(i);
+        serverLogger.info(std::format(
+            "{} commands: queue depth: {}, executed: {}, average wait: {}us, max wait: {}us\n",
+            cost_class_names[i], statistics.queue_depth, statistics.executed,
+            statistics.average_wait_us, statistics.max_wait_us));
+    }
+
+    return true;
+}
+
+CommandInfo show_workload_command::registerCommand()
+{
+    return {{}, "show queue depth and wait time of each command cost class"};
+}
+
+bool show_timers_command::execute()
+{
+    using namespace std::chrono;
+    auto list = serverManager.getServerTimers().getStatistics();
+    serverLogger.info(std::format("Periodic tasks: {}\n", list.size()));
+    for (const auto& statistics: list) {
+        auto average = statistics.run_count ?
+            statistics.total_run_time / statistics.run_count : steady_clock::duration::zero();
+        serverLogger.info(std::format(
+            "{}: every {}ms, runs: {}, coalesced: {}, average run: {}us, max run: {}us, max delay: {}us\n",
+            statistics.name, duration_cast<milliseconds>(statistics.interval).count(),
+            statistics.run_count, statistics.coalesced_count,
+            duration_cast<microseconds>(average).count(),
+            duration_cast<microseconds>(statistics.max_run_time).count(),
+            duration_cast<microseconds>(statistics.max_delay).count()));
+    }
+    return true;
+}
+
+CommandInfo show_timers_command::registerCommand()
+{
+    return {{}, "show run-time statistics of the periodic tasks"};
+}
+
+void show_locks_command::setArguments(const opt::Option& options)
+{
+    m_top = options.has_opt_with_value("top") ? options.get_int("top") : 10;
+    m_profiling = options.has_opt_with_value("profiling") ? options.get_string("profiling") : std::string();
+}
+
+/**
+ * @brief Formats the buckets of a lock histogram that counted something.
+ */
+static std::string formatLockHistogram(std::span<const std::uint64_t> histogram)
+{
+    std::string result;
+    for (std::size_t i = 0; i < histogram.size(); ++i) {
+        if (!histogram[i])
+            continue;
+        if (i + 1 == histogram.size())
+            result += std::format(" >={}ns: {}", 256ull << (i - 1), histogram[i]);
+        else
+            result += std::format(" <{}ns: {}", 256ull << i, histogram[i]);
+    }
+    return result;
+}
+
+bool show_locks_command::execute()
+{
+    if (m_profiling == "on" || m_profiling == "off") {
+        LockTelemetry::setEnabled(m_profiling == "on");
+        SharedLockProfile::setEnabled(m_profiling == "on");
+    } else if (!m_profiling.empty()) {
+        serverLogger.warning("Unknown lock profiling state: ", m_profiling);
+        return true;
+    }
+
+    auto list = qls::LockTelemetry::getAllStatistics();
+    serverLogger.info(std::format("Named locks: {}, telemetry: {}\n", list.size(),
+        LockTelemetry::isEnabled() ? "on" : "off"));
+    for (const auto& statistics: list) {
+        serverLogger.info(std::format(
+            "{}: acquisitions: {}, contended: {} ({:.2f}%), parked: {}, average wait: {}ns, max wait: {}ns\n",
+            statistics.name, statistics.acquisitions, statistics.contended,
+            statistics.acquisitions ? 100.0 * statistics.contended / statistics.acquisitions : 0.0,
+            statistics.parked,
+            statistics.contended ? statistics.total_wait_ns / statistics.contended : 0,
+            statistics.max_wait_ns));
+
+        if (std::string histogram = formatLockHistogram(statistics.wait_histogram); !histogram.empty())
+            serverLogger.info(std::format("    waits:{}\n", histogram));
+    }
+
+    // The shared mutexes that kept their users waiting the longest come first
+    auto shared_list = SharedLockProfile::getAllStatistics();
+    std::sort(shared_list.begin(), shared_list.end(), [](const auto& left, const auto& right) {
+        return left.shared.total_wait_ns + left.exclusive.total_wait_ns >
+            right.shared.total_wait_ns + right.exclusive.total_wait_ns;
+    });
+    shared_list.resize(std::min<std::size_t>(shared_list.size(),
+        static_cast<std::size_t>(std::max(m_top, 0ll))));
+    serverLogger.info(std::format("Shared lock profiling: {}, top {} sites by wait time\n",
+        SharedLockProfile::isEnabled() ? "on" : "off", shared_list.size()));
+    for (const auto& statistics: shared_list) {
+        serverLogger.info(std::format("{}\n", statistics.name));
+        for (const auto& [mode_name, mode]: {std::pair{"shared", &statistics.shared},
+                std::pair{"exclusive", &statistics.exclusive}}) {
+            if (!mode->acquisitions)
+                continue;
+            serverLogger.info(std::format(
+                "    {}: acquisitions: {}, contended: {}, total wait: {}us, max wait: {}us, "
+                "average hold: {}ns, max hold: {}us\n",
+                mode_name, mode->acquisitions, mode->contended,
+                mode->total_wait_ns / 1000, mode->max_wait_ns / 1000,
+                mode->total_hold_ns / mode->acquisitions, mode->max_hold_ns / 1000));
+            if (std::string histogram = formatLockHistogram(mode->wait_histogram); !histogram.empty())
+                serverLogger.info(std::format("        waits:{}\n", histogram));
+            if (std::string histogram = formatLockHistogram(mode->hold_histogram); !histogram.empty())
+                serverLogger.info(std::format("        holds:{}\n", histogram));
+        }
+    }
+    return true;
+}
+
+CommandInfo show_locks_command::registerCommand()
+{
+    opt::Option option;
+    option.add("top", opt::Option::OptionType::OPT_OPTIONAL);
+    option.add("profiling", opt::Option::OptionType::OPT_OPTIONAL);
+    return {option, "show contention statistics of the locks: --top N, --profiling on|off"};
+}
+
+void log_level_command::setArguments(const opt::Option& options)
+{
+    m_level = options.has_opt_with_value("level") ? options.get_string("level") : std::string();
+}
+
+bool log_level_command::execute()
+{
+    using LogMode = Log::Logger::LogMode;
+    constexpr std::pair<std::string_view, LogMode> level_names[] = {
+        {"debug", LogMode::LogDEBUG},
+        {"info", LogMode::LogINFO},
+        {"warning", LogMode::LogWARNING},
+        {"error", LogMode::LogERROR},
+        {"critical", LogMode::LogCRITICAL}};
+
+    if (!m_level.empty()) {
+        auto iter = std::find_if(std::begin(level_names), std::end(level_names),
+            [this](const auto& level) { return level.first == m_level; });
+        if (iter == std::end(level_names)) {
+            serverLogger.warning("Unknown log level: ", m_level);
+            return true;
+        }
+        serverLogger.setLevel(iter->second);
+    }
+
+    LogMode level = serverLogger.getLevel();
+    for (const auto& [name, mode]: level_names) {
+        if (mode == level)
+            // Not logged, so it is shown whatever the level is
+            std::cout << "Log level: " << name << std::endl;
+    }
+    return true;
+}
+
+CommandInfo log_level_command::registerCommand()
+{
+    opt::Option option;
+    option.add("level", opt::Option::OptionType::OPT_OPTIONAL);
+    return {option, "show or set the least severe log level: --level debug|info|warning|error|critical"};
+}
+
+void event_log_command::setArguments(const opt::Option& options)
+{
+    m_state = options.has_opt_with_value("state") ? options.get_string("state") : std::string();
+}
+
+bool event_log_command::execute()
+{
+    if (m_state == "on")
+        serverEventLogger.setEnabled(true);
+    else if (m_state == "off")
+        serverEventLogger.setEnabled(false);
+    else if (!m_state.empty()) {
+        serverLogger.warning("Unknown event log state: ", m_state);
+        return true;
+    }
+
+    // Not logged, so it is shown whatever the level is
+    std::cout << "Event log: " << (serverEventLogger.isEnabled() ? "on" : "off")
+        << ", dropped records: " << serverEventLogger.getDroppedCount() << std::endl;
+    return true;
+}
+
+CommandInfo event_log_command::registerCommand()
+{
+    opt::Option option;
+    option.add("state", opt::Option::OptionType::OPT_OPTIONAL);
+    return {option, "show or switch the binary event log: --state on|off"};
+}
+
 } // namespace qls
@@ -41,6 +41,59 @@ public:
     virtual CommandInfo registerCommand();
 };
 
+class show_workload_command: public Command
+{
+public:
+    show_workload_command() = default;
+    virtual bool execute();
+    virtual CommandInfo registerCommand();
+};
+
+class show_timers_command: public Command
+{
+public:
+    show_timers_command() = default;
+    virtual bool execute();
+    virtual CommandInfo registerCommand();
+};
+
+class show_locks_command: public Command
+{
+public:
+    show_locks_command() = default;
+    virtual void setArguments(const opt::Option& options);
+    virtual bool execute();
+    virtual CommandInfo registerCommand();
+
+private:
+    long long   m_top = 10;
+    std::string m_profiling;
+};
+
+class log_level_command: public Command
+{
+public:
+    log_level_command() = default;
+    virtual void setArguments(const opt::Option& options);
+    virtual bool execute();
+    virtual CommandInfo registerCommand();
+
+private:
+    std::string m_level;
+};
+
+class event_log_command: public Command
+{
+public:
+    event_log_command() = default;
+    virtual void setArguments(const opt::Option& options);
+    virtual bool execute();
+    virtual CommandInfo registerCommand();
+
+private:
+    std::string m_state;
+};
+
 } // namespace qls
 
 #endif // !INPUT_COMMANDS_H
@@ -1,10 +1,19 @@
 #include "JsonMsgProcess.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <format>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include <logger.hpp>
+#include <eventLog.h>
 #include "manager.h"
 #include "regexMatch.hpp"
 #include "returnStateMessage.hpp"
@@ -12,9 +21,15 @@
 #include "groupid.hpp"
 #include "userid.hpp"
 #include "JsonMsgProcessCommand.h"
+#include "JsonMsgProcessSchema.hpp"
+#include "lazyJson.h"
+#include "workerPool.h"
+#include "adaptive_mutex.hpp"
+#include "coarse_clock.hpp"
 
 extern qls::Manager serverManager;
 extern Log::Logger serverLogger;
+extern Log::EventLogger serverEventLogger;
 
 namespace qls
 {
@@ -54,6 +69,9 @@ public:
         init_command("remove_group", std::make_shared<RemoveGroupCommand>());
         init_command("leave_group", std::make_shared<LeaveGroupCommand>());
         init_command("remove_friend", std::make_shared<RemoveFriendCommand>());
+        init_command("create_file_upload", std::make_shared<CreateFileUploadCommand>());
+        init_command("get_file_upload_offset", std::make_shared<GetFileUploadOffsetCommand>());
+        init_command("remove_file", std::make_shared<RemoveFileCommand>());
     }
     ~JsonMessageProcessCommandList() = default;
 
@@ -106,6 +124,227 @@ bool JsonMessageProcessCommandList::removeCommand(std::string_view function_name
     return true;
 }
 
+// -----------------------------------------------------------------------------------------------
+// Request parameters
+// -----------------------------------------------------------------------------------------------
+
+/**
+ * @brief Envelope of every json request: {"function": "...", "parameters": {...}}
+ * @tparam View qjson::JObject or LazyJsonValue
+ */
+template<class View>
+struct RequestParameters
+{
+    using parameter_type = std::conditional_t<std::is_same_v<View, qjson::JObject>,
+        const qjson::JObject*, LazyJsonValue>;
+
+    std::string     function;
+    parameter_type  parameters{};
+
+    static const JsonParameterSchema<RequestParameters>& schema()
+    {
+        using Schema = JsonParameterSchema<RequestParameters>;
+        static const Schema s{
+            Schema::field<&RequestParameters::function>("function"),
+            Schema::field<&RequestParameters::parameters>("parameters")};
+        return s;
+    }
+};
+
+static const qjson::JObject& derefParameters(const qjson::JObject* parameters)
+{
+    return *parameters;
+}
+
+static const LazyJsonValue& derefParameters(const LazyJsonValue& parameters)
+{
+    return parameters;
+}
+
+struct LoginParameters
+{
+    UserID      user_id;
+    std::string password;
+    std::string device;
+
+    static const JsonParameterSchema<LoginParameters>& schema()
+    {
+        using Schema = JsonParameterSchema<LoginParameters>;
+        static const Schema s{
+            Schema::field<&LoginParameters::user_id>("user_id"),
+            Schema::field<&LoginParameters::password>("password"),
+            Schema::field<&LoginParameters::device>("device")};
+        return s;
+    }
+};
+
+struct PipelineParameters
+{
+    long long limit;
+
+    static const JsonParameterSchema<PipelineParameters>& schema()
+    {
+        using Schema = JsonParameterSchema<PipelineParameters>;
+        static const Schema s{
+            Schema::field<&PipelineParameters::limit>("limit")};
+        return s;
+    }
+};
+
+struct EncodingParameters
+{
+    std::string encoding;
+
+    static const JsonParameterSchema<EncodingParameters>& schema()
+    {
+        using Schema = JsonParameterSchema<EncodingParameters>;
+        static const Schema s{
+            Schema::field<&EncodingParameters::encoding>("encoding")};
+        return s;
+    }
+};
+
+struct CompressionParameters
+{
+    long long threshold;
+
+    static const JsonParameterSchema<CompressionParameters>& schema()
+    {
+        using Schema = JsonParameterSchema<CompressionParameters>;
+        static const Schema s{
+            Schema::field<&CompressionParameters::threshold>("threshold")};
+        return s;
+    }
+};
+
+struct FragmentationParameters
+{
+    bool enabled;
+
+    static const JsonParameterSchema<FragmentationParameters>& schema()
+    {
+        using Schema = JsonParameterSchema<FragmentationParameters>;
+        static const Schema s{
+            Schema::field<&FragmentationParameters::enabled>("enabled")};
+        return s;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// Cost class statistics
+// -----------------------------------------------------------------------------------------------
+
+struct alignas(64) CostClassCounter
+{
+    std::atomic<long long> queued = 0;
+    std::atomic<long long> executed = 0;
+    std::atomic<long long> total_wait_us = 0;
+    std::atomic<long long> max_wait_us = 0;
+
+    void recordStart(std::chrono::steady_clock::duration wait_time)
+    {
+        long long wait_us = std::chrono::duration_cast<std::chrono::microseconds>(wait_time).count();
+        --queued;
+        ++executed;
+        total_wait_us += wait_us;
+        long long max_us = max_wait_us.load(std::memory_order_relaxed);
+        while (wait_us > max_us &&
+            !max_wait_us.compare_exchange_weak(max_us, wait_us, std::memory_order_relaxed));
+    }
+};
+
+static std::array<CostClassCounter, JsonMessageCommand::CostClassCount> cost_class_counters;
+
+// -----------------------------------------------------------------------------------------------
+// User quotas
+// -----------------------------------------------------------------------------------------------
+
+static long long steadyNanoseconds() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        CoarseClock::steadyNow().time_since_epoch()).count();
+}
+
+/**
+ * @brief Token bucket of the requests of a user, shared by all the connections of the user.
+ *        Like the buckets of RateLimiter it's kept as the time at which it is full again.
+ */
+struct UserQuota
+{
+    /// Tokens a user earns per second
+    static constexpr long long token_rate = 20;
+    /// Tokens a user can save up for a burst
+    static constexpr long long burst_size = 100;
+    static constexpr long long token_time_ns = 1'000'000'000ll / token_rate;
+
+    std::atomic<long long> full_time = 0;
+
+    /**
+     * @brief Takes tokens of the bucket, nothing is taken if there aren't enough of them.
+     * @param cost Number of tokens
+     * @return 0 if the tokens were taken, otherwise the milliseconds until they are earned
+     */
+    long long take(int cost) noexcept
+    {
+        const long long now = steadyNanoseconds();
+        const long long cost_time = std::max(cost, 0) * token_time_ns;
+        long long old_full_time = full_time.load(std::memory_order_relaxed);
+        while (true) {
+            const long long new_full_time = std::max(old_full_time, now) + cost_time;
+            const long long excess = new_full_time - now - burst_size * token_time_ns;
+            if (excess > 0)
+                return excess / 1'000'000 + 1;
+            if (full_time.compare_exchange_weak(old_full_time, new_full_time,
+                    std::memory_order_relaxed))
+                return 0;
+        }
+    }
+};
+
+/**
+ * @brief Quotas of the logged in users, sharded by user ID.
+ */
+class UserQuotaTable
+{
+public:
+    /**
+     * @brief Gets the quota of a user, it's created full if the user has none.
+     */
+    std::shared_ptr<UserQuota> acquire(UserID user_id)
+    {
+        Shard& shard = m_shards[std::hash<UserID>{}(user_id) % shard_count];
+        std::lock_guard<adaptive_mutex> lock(shard.mutex);
+        // Quotas are kept after the user disconnects until they are full again,
+        // so logging in again doesn't refill them
+        if (shard.quotas.size() >= shard.clean_threshold) {
+            const long long now = steadyNanoseconds();
+            std::erase_if(shard.quotas, [now](const auto& i) {
+                return i.second.use_count() == 1 &&
+                    i.second->full_time.load(std::memory_order_relaxed) <= now;
+            });
+            shard.clean_threshold = std::max<std::size_t>(16, shard.quotas.size() * 2);
+        }
+        auto& quota = shard.quotas[user_id];
+        if (!quota)
+            quota = std::make_shared<UserQuota>();
+        return quota;
+    }
+
+private:
+    static constexpr std::size_t shard_count = 64;
+
+    struct alignas(64) Shard
+    {
+        adaptive_mutex                                          mutex{"user quotas"};
+        std::unordered_map<UserID, std::shared_ptr<UserQuota>>  quotas;
+        std::size_t                                             clean_threshold = 16;
+    };
+
+    Shard m_shards[shard_count];
+};
+
+static UserQuotaTable user_quota_table;
+
 // -----------------------------------------------------------------------------------------------
 // JsonMessageProcessImpl
 // -----------------------------------------------------------------------------------------------
@@ -114,7 +353,8 @@ class JsonMessageProcessImpl
 {
 public:
     JsonMessageProcessImpl(UserID user_id) :
-        m_user_id(user_id) {}
+        m_user_id(user_id),
+        m_quota(std::make_shared<UserQuota>()) {}
 
     static qjson::JObject getUserPublicInfo(UserID user_id);
 
@@ -123,7 +363,22 @@ public:
 
     UserID getLocalUserID() const;
 
-    asio::awaitable<qjson::JObject> processJsonMessage(const qjson::JObject& json, const SocketService& sf);
+    template<class View>
+    asio::awaitable<qjson::JObject> processJsonMessage(const View& json, SocketService& sf);
+
+    static int getOrderingType(const qjson::JObject& json);
+    static int getOrderingType(const LazyJsonValue& json);
+    static int getFunctionOrderingType(std::string_view function_name);
+    static int getFunctionQuotaCost(std::string_view function_name);
+
+    /**
+     * @brief Charges a request to the quota of the user,
+     *        requests before login are charged to the connection.
+     * @return 0 if the request may be dispatched, otherwise the milliseconds to wait
+     */
+    long long chargeQuota(std::string_view function_name) const;
+
+    asio::awaitable<qjson::JObject> finishUpload(long long upload_id, SocketService& sf);
 
     qjson::JObject login(
         UserID user_id,
@@ -136,8 +391,23 @@ public:
         std::string_view password,
         std::string_view device);
 
+    /**
+     * @brief Executes a function according to its cost class.
+     *        Light functions run on the strand of the connection, heavy functions
+     *        run on the worker pool and the coroutine resumes on the strand afterwards.
+     * @param sf Socket service of the connection
+     * @param cost_class JsonMessageCommand::CostClass
+     * @param function Function that returns the result json
+     */
+    template<class Function>
+    asio::awaitable<qjson::JObject> async_execute(
+        const SocketService& sf,
+        int cost_class,
+        Function function);
+
 private:
     UserID                      m_user_id;
+    std::shared_ptr<UserQuota>  m_quota; ///< Quota of the connection, the user's one after login
     mutable std::shared_mutex   m_user_id_mutex;
 
     static JsonMessageProcessCommandList m_jmpc_list;
@@ -175,25 +445,27 @@ UserID JsonMessageProcessImpl::getLocalUserID() const
     return this->m_user_id;
 }
 
+template<class View>
 asio::awaitable<qjson::JObject> JsonMessageProcessImpl::processJsonMessage(
-    const qjson::JObject& json,
-    const SocketService& sf)
+    const View& json,
+    SocketService& sf)
 {
     try {
         // Check whether the json pack is valid
-        serverLogger.debug("Json body: ", qjson::JWriter::fastWrite(json));
+        // The request is only serialized again if debug messages are enabled
+        if constexpr (std::is_same_v<View, LazyJsonValue>)
+            serverLogger.debug("Json body: ", [&json] { return json.getRaw(); });
+        else
+            serverLogger.debug("Json body: ", [&json] { return qjson::JWriter::fastWrite(json); });
         if (json.getType() != qjson::JDict)
             co_return makeErrorMessage("The data body must be json dictory type!");
-        else if (!json.hasMember("function"))
-            co_return makeErrorMessage("\"function\" must be included in json dictory!");
-        else if (!json.hasMember("parameters"))
-            co_return makeErrorMessage("\"function\" must be included in json dictory!");
-        else if (json["function"].getType() != qjson::JString)
-            co_return makeErrorMessage("\"function\" must be string type!");
-        else if (json["parameters"].getType() != qjson::JDict)
-            co_return makeErrorMessage("\"parameters\" must be dictory type!");
-        std::string function_name = json["function"].getString();
-        qjson::JObject param = json["parameters"];
+
+        RequestParameters<View> request;
+        if (std::string error = RequestParameters<View>::schema().extract(json, request);
+            !error.empty())
+            co_return makeErrorMessage(error);
+        const std::string& function_name = request.function;
+        const auto& param = derefParameters(request.parameters);
 
         // Check if user has logined
         {
@@ -201,31 +473,109 @@ asio::awaitable<qjson::JObject> JsonMessageProcessImpl::processJsonMessage(
             // Check if userid == -1
             if (m_user_id == UserID(-1) &&
                 function_name != "login" &&
+                function_name != "set_pipeline_limit" &&
+                function_name != "set_encoding" &&
+                function_name != "set_compression" &&
+                function_name != "set_fragmentation" &&
                 (!m_jmpc_list.hasCommand(function_name) ||
-                    m_jmpc_list.getCommand(function_name)->getCommandType() &
-                        JsonMessageCommand::NormalType)) {
+                    m_jmpc_list.getCommand(function_name)->getCommandType() ==
+                        JsonMessageCommand::LoginType)) {
                     co_return makeErrorMessage("You haven't logged in!");
             }
         }
 
-        if (function_name == "login")
-            co_return login(UserID(param["user_id"].getInt()),
-                param["password"].getString(), param["device"].getString(), sf);
+        // Requests are charged before anything is dispatched, so a flooding client
+        // is turned away without touching the parameters
+        if (long long retry_after_ms = chargeQuota(function_name); retry_after_ms > 0) {
+            auto returnJson = makeErrorMessage("Too many requests, please slow down!");
+            returnJson["retry_after_ms"] = retry_after_ms;
+            co_return returnJson;
+        }
+
+        if (function_name == "login") {
+            LoginParameters login_parameters;
+            if (std::string error = LoginParameters::schema().extract(param, login_parameters);
+                !error.empty())
+                co_return makeErrorMessage(error);
+            // Checking the password hash is expensive
+            co_return co_await async_execute(sf, JsonMessageCommand::HeavyCost,
+                [this, login_parameters = std::move(login_parameters), &sf]() {
+                    return login(login_parameters.user_id,
+                        login_parameters.password, login_parameters.device, sf);
+                });
+        }
+
+        if (function_name == "set_pipeline_limit") {
+            PipelineParameters pipeline_parameters;
+            if (std::string error = PipelineParameters::schema().extract(param, pipeline_parameters);
+                !error.empty())
+                co_return makeErrorMessage(error);
+            auto returnJson = makeSuccessMessage("Successfully setting pipeline limit!");
+            returnJson["limit"] = static_cast<long long>(sf.setPipelineLimit(
+                static_cast<std::size_t>(std::max(pipeline_parameters.limit, 1ll))));
+            co_return returnJson;
+        }
+
+        if (function_name == "set_encoding") {
+            EncodingParameters encoding_parameters;
+            if (std::string error = EncodingParameters::schema().extract(param, encoding_parameters);
+                !error.empty())
+                co_return makeErrorMessage(error);
+            if (encoding_parameters.encoding != "json" && encoding_parameters.encoding != "binary")
+                co_return makeErrorMessage("Unknown encoding!");
+            // Text requests are always accepted, so a client can switch back
+            sf.setBinaryEncoding(encoding_parameters.encoding == "binary");
+            auto returnJson = makeSuccessMessage("Successfully setting encoding!");
+            returnJson["encoding"] = encoding_parameters.encoding;
+            co_return returnJson;
+        }
+
+        if (function_name == "set_compression") {
+            CompressionParameters compression_parameters;
+            if (std::string error = CompressionParameters::schema().extract(param, compression_parameters);
+                !error.empty())
+                co_return makeErrorMessage(error);
+            auto returnJson = makeSuccessMessage("Successfully setting compression!");
+            returnJson["threshold"] = static_cast<long long>(sf.setCompressionThreshold(
+                static_cast<std::size_t>(std::max(compression_parameters.threshold, 0ll))));
+            co_return returnJson;
+        }
+
+        if (function_name == "set_fragmentation") {
+            FragmentationParameters fragmentation_parameters;
+            if (std::string error = FragmentationParameters::schema().extract(param, fragmentation_parameters);
+                !error.empty())
+                co_return makeErrorMessage(error);
+            sf.setFragmentation(fragmentation_parameters.enabled);
+            auto returnJson = makeSuccessMessage("Successfully setting fragmentation!");
+            returnJson["enabled"] = fragmentation_parameters.enabled;
+            co_return returnJson;
+        }
+
+        if (function_name == "download_file") {
+            FileIDParameters file_parameters;
+            if (std::string error = FileIDParameters::schema().extract(param, file_parameters);
+                !error.empty())
+                co_return makeErrorMessage(error);
+            std::shared_ptr<MappedFile> file;
+            try {
+                file = serverManager.getServerFileTransferManager().openFile(file_parameters.file_id);
+            } catch (const std::system_error& e) {
+                co_return makeErrorMessage(e.code().message());
+            }
+            // The content follows in FileStream data packages after this reply
+            auto returnJson = makeSuccessMessage("Successfully started a download!");
+            returnJson["file_id"] = file_parameters.file_id;
+            returnJson["file_size"] = static_cast<long long>(file->size());
+            sf.sendFile(std::move(file), file_parameters.file_id);
+            co_return returnJson;
+        }
 
         if (!m_jmpc_list.hasCommand(function_name))
             co_return makeErrorMessage("There isn't a function that matches the name!");
 
         // Find the command that matches the function name
         auto command_ptr = m_jmpc_list.getCommand(function_name);
-        const qjson::dict_t& param_dict = param.getDict();
-        // Check whether the type of json values match the options
-        for (const auto& [name, type]: command_ptr->getOption()) {
-            auto local_iter = param_dict.find(name);
-            if (local_iter == param_dict.cend())
-                co_return makeErrorMessage(std::format("Lost a parameter: {}.", name));
-            if (local_iter->second.getType() != type)
-                co_return makeErrorMessage(std::format("Wrong parameter type: {}.", name));
-        }
 
         UserID user_id;
         {
@@ -234,30 +584,17 @@ asio::awaitable<qjson::JObject> JsonMessageProcessImpl::processJsonMessage(
             user_id = m_user_id;
         }
         
-        // This function is used to execute the command asynchronously
-        auto async_invoke = [](auto executor, std::shared_ptr<JsonMessageCommand> command_ptr,
-                               UserID user_id, qjson::JObject param, auto&& token) {
-            return asio::async_initiate<decltype(token), void(std::error_code, qjson::JObject)>(
-                [](auto handler, auto executor, std::shared_ptr<JsonMessageCommand> command_ptr,
-                UserID user_id, qjson::JObject param) {
-                    asio::post(executor,
-                        [handler = std::move(handler),
-                        command_ptr = std::move(command_ptr),
-                        user_id,
-                        param = std::move(param)]() mutable {
-                            try {
-                                handler({}, command_ptr->execute(user_id, std::move(param)));
-                            } catch(const std::system_error& e) {
-                                handler(e.code(), qjson::JObject{});
-                            } catch(...) {
-                                handler(std::error_code(asio::error::fault), qjson::JObject{});
-                            }
-                        });
-                }, token, std::move(executor), std::move(command_ptr), user_id, std::move(param));
-            };
-
-        co_return co_await async_invoke(co_await asio::this_coro::executor,
-            std::move(command_ptr), user_id, std::move(param), asio::use_awaitable);
+        // The parameters are validated and extracted by the command's schema
+        // when it is invoked, so the json object is only referenced here
+        // (it outlives this coroutine's suspension).
+        co_return co_await async_execute(sf, command_ptr->getCostClass(),
+            [command_ptr = std::move(command_ptr), user_id, param = &param, &function_name]() {
+                auto start = std::chrono::steady_clock::now();
+                qjson::JObject result = command_ptr->invoke(user_id, *param);
+                serverEventLogger.log(Log::EventID::RequestProcessed, function_name,
+                    std::chrono::steady_clock::now() - start);
+                return result;
+            });
     } catch (const std::exception& e) {
 #ifndef _DEBUG
         co_return makeErrorMessage("Unknown error occured!");
@@ -267,14 +604,138 @@ asio::awaitable<qjson::JObject> JsonMessageProcessImpl::processJsonMessage(
     }
 }
 
+int JsonMessageProcessImpl::getOrderingType(const qjson::JObject& json)
+{
+    // Requests that can't be recognized are handled in order
+    if (json.getType() != qjson::JDict)
+        return JsonMessageCommand::SequentialOrder;
+    const qjson::dict_t& dict = json.getDict();
+    auto iter = dict.find("function");
+    if (iter == dict.cend() || iter->second.getType() != qjson::JString)
+        return JsonMessageCommand::SequentialOrder;
+    return getFunctionOrderingType(iter->second.getString());
+}
+
+int JsonMessageProcessImpl::getOrderingType(const LazyJsonValue& json)
+{
+    try {
+        if (json.getType() != qjson::JDict)
+            return JsonMessageCommand::SequentialOrder;
+        LazyJsonValue function = json.find("function");
+        if (!function.isValid() || function.getType() != qjson::JString)
+            return JsonMessageCommand::SequentialOrder;
+        return getFunctionOrderingType(function.getString());
+    } catch (const std::system_error&) {
+        // Malformed requests are reported when they are processed
+        return JsonMessageCommand::SequentialOrder;
+    }
+}
+
+int JsonMessageProcessImpl::getFunctionOrderingType(std::string_view function_name)
+{
+    // login and the set_* functions change the state of the connection
+    if (!m_jmpc_list.hasCommand(function_name))
+        return JsonMessageCommand::SequentialOrder;
+    return m_jmpc_list.getCommand(function_name)->getOrderingType();
+}
+
+int JsonMessageProcessImpl::getFunctionQuotaCost(std::string_view function_name)
+{
+    // login hashes the password and download_file streams a whole file
+    if (function_name == "login" || function_name == "download_file")
+        return 10;
+    if (!m_jmpc_list.hasCommand(function_name))
+        return 1;
+    return m_jmpc_list.getCommand(function_name)->getQuotaCost();
+}
+
+long long JsonMessageProcessImpl::chargeQuota(std::string_view function_name) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_user_id_mutex);
+    return m_quota->take(getFunctionQuotaCost(function_name));
+}
+
+template<class Function>
+asio::awaitable<qjson::JObject> JsonMessageProcessImpl::async_execute(
+    const SocketService& sf,
+    int cost_class,
+    Function function)
+{
+    if (cost_class < 0 || cost_class >= JsonMessageCommand::CostClassCount)
+        cost_class = JsonMessageCommand::LightCost;
+
+    WorkerPool& pool = serverManager.getServerWorkerPool();
+    if (cost_class == JsonMessageCommand::HeavyCost && pool.isFull())
+        co_return makeErrorMessage("The server is busy, please try again later!");
+
+    auto initiation = [&pool, cost_class](auto handler,
+        asio::strand<asio::any_io_executor> strand, Function function) {
+        auto work = asio::make_work_guard(asio::get_associated_executor(handler));
+        CostClassCounter& counter = cost_class_counters[cost_class];
+        ++counter.queued;
+
+        WorkerPool::Task task = [handler = std::move(handler),
+            work = std::move(work),
+            strand,
+            function = std::move(function),
+            &counter,
+            enqueue_time = std::chrono::steady_clock::now()]() mutable {
+                counter.recordStart(std::chrono::steady_clock::now() - enqueue_time);
+
+                std::error_code ec;
+                qjson::JObject result;
+                try {
+                    result = function();
+                } catch (const std::system_error& e) {
+                    ec = e.code();
+                } catch (...) {
+                    ec = asio::error::fault;
+                }
+
+                // Resume the coroutine on the strand of the connection
+                asio::dispatch(strand,
+                    [handler = std::move(handler), ec, result = std::move(result)]() mutable {
+                        handler(ec, std::move(result));
+                    });
+                work.reset();
+            };
+
+        // Light functions and heavy ones that lost the race
+        // for the last place in the pool run on the strand
+        if (cost_class != JsonMessageCommand::HeavyCost || !pool.tryPost(task))
+            asio::post(strand, std::move(task));
+    };
+
+    co_return co_await asio::async_initiate<decltype(asio::use_awaitable),
+        void(std::error_code, qjson::JObject)>(
+            std::move(initiation), asio::use_awaitable,
+            sf.get_connection_ptr()->strand, std::move(function));
+}
+
+asio::awaitable<qjson::JObject> JsonMessageProcessImpl::finishUpload(
+    long long upload_id, SocketService& sf)
+{
+    // Copying the content into the attachment store takes as long as the file is large
+    co_return co_await async_execute(sf, JsonMessageCommand::HeavyCost,
+        [upload_id, user_id = getLocalUserID()]() {
+            long long file_id = serverManager.getServerFileTransferManager()
+                .finishUpload(upload_id, user_id);
+            auto returnJson = makeSuccessMessage("Successfully uploaded a file!");
+            returnJson["file_id"] = file_id;
+            return returnJson;
+        });
+}
+
 qjson::JObject JsonMessageProcessImpl::login(
     UserID user_id,
     std::string_view password,
     std::string_view device,
     const SocketService& sf)
 {
-    if (!serverManager.hasUser(user_id))
+    if (!serverManager.hasUser(user_id)) {
+        serverEventLogger.log(Log::EventID::LoginFailed, user_id, device);
         return makeErrorMessage("The user ID or password is wrong!");
+    }
     
     auto user = serverManager.getUser(user_id);
     
@@ -294,15 +755,19 @@ qjson::JObject JsonMessageProcessImpl::login(
                 user_id, DeviceType::Unknown);
 
         auto returnJson = makeSuccessMessage("Successfully logged in!");
+        auto quota = user_quota_table.acquire(user_id);
         std::unique_lock<std::shared_mutex> lock(m_user_id_mutex);
         this->m_user_id = user_id;
+        this->m_quota = std::move(quota);
 
         
         serverLogger.debug("User ", user_id.getOriginValue(), " logged into the server");
+        serverEventLogger.log(Log::EventID::LoggedIn, user_id, device);
 
         return returnJson;
     }
-    else return makeErrorMessage("The user ID or password is wrong!");
+    serverEventLogger.log(Log::EventID::LoginFailed, user_id, device);
+    return makeErrorMessage("The user ID or password is wrong!");
 }
 
 qjson::JObject JsonMessageProcessImpl::login(
@@ -327,9 +792,51 @@ UserID JsonMessageProcess::getLocalUserID() const
 }
 
 asio::awaitable<qjson::JObject> JsonMessageProcess::processJsonMessage(
-    const qjson::JObject& json, const SocketService& sf)
+    const qjson::JObject& json, SocketService& sf)
+{
+    co_return co_await m_process->processJsonMessage(json, sf);
+}
+
+asio::awaitable<qjson::JObject> JsonMessageProcess::processJsonMessage(
+    const LazyJsonValue& json, SocketService& sf)
 {
     co_return co_await m_process->processJsonMessage(json, sf);
 }
 
+asio::awaitable<qjson::JObject> JsonMessageProcess::finishUpload(
+    long long upload_id, SocketService& sf)
+{
+    co_return co_await m_process->finishUpload(upload_id, sf);
+}
+
+int JsonMessageProcess::getOrderingType(const qjson::JObject& json)
+{
+    return JsonMessageProcessImpl::getOrderingType(json);
+}
+
+int JsonMessageProcess::getOrderingType(const LazyJsonValue& json)
+{
+    return JsonMessageProcessImpl::getOrderingType(json);
+}
+
+long long JsonMessageProcess::chargeQuota(UserID user_id, int cost)
+{
+    return user_quota_table.acquire(user_id)->take(cost);
+}
+
+CommandCostStatistics JsonMessageProcess::getCostStatistics(int cost_class)
+{
+    if (cost_class < 0 || cost_class >= JsonMessageCommand::CostClassCount)
+        throw std::system_error(make_error_code(qls_errc::invalid_data));
+
+    const CostClassCounter& counter = cost_class_counters[cost_class];
+    CommandCostStatistics statistics;
+    statistics.queue_depth = counter.queued;
+    statistics.executed = counter.executed;
+    statistics.average_wait_us = statistics.executed ?
+        counter.total_wait_us / statistics.executed : 0;
+    statistics.max_wait_us = counter.max_wait_us;
+    return statistics;
+}
+
 } // namespace qls
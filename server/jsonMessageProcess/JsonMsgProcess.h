@@ -8,12 +8,24 @@
 #include <memory>
 
 #include "socketFunctions.h"
+#include "lazyJson.h"
 
 namespace qls
 {
 
 class JsonMessageProcessImpl;
 
+/**
+ * @brief Snapshot of the workload of a command cost class.
+ */
+struct CommandCostStatistics
+{
+    long long queue_depth = 0;      ///< Commands waiting to be executed
+    long long executed = 0;         ///< Commands that have started executing
+    long long average_wait_us = 0;  ///< Average waiting time in microseconds
+    long long max_wait_us = 0;      ///< Maximum waiting time in microseconds
+};
+
 class JsonMessageProcess final
 {
 public:
@@ -21,7 +33,42 @@ public:
     ~JsonMessageProcess();
 
     UserID getLocalUserID() const;
-    asio::awaitable<qjson::JObject> processJsonMessage(const qjson::JObject& json, const SocketService& sf);
+    asio::awaitable<qjson::JObject> processJsonMessage(const qjson::JObject& json, SocketService& sf);
+
+    /**
+     * @brief Same as above, only the members the command needs are decoded.
+     *        The document of the json must outlive the coroutine.
+     */
+    asio::awaitable<qjson::JObject> processJsonMessage(const LazyJsonValue& json, SocketService& sf);
+
+    /**
+     * @brief Finishes an upload of the user that has all its bytes on the worker pool,
+     *        the strand of the connection is free while the content is stored.
+     * @param upload_id ID of the upload
+     * @return Result json with the ID of the stored file
+     */
+    asio::awaitable<qjson::JObject> finishUpload(long long upload_id, SocketService& sf);
+
+    /**
+     * @brief Gets the ordering constraint of a json request.
+     * @param json Json request
+     * @return JsonMessageCommand::OrderingType
+     */
+    static int getOrderingType(const qjson::JObject& json);
+    static int getOrderingType(const LazyJsonValue& json);
+
+    /**
+     * @brief Charges tokens to the request quota of a user,
+     *        used by commands whose cost depends on their parameters.
+     * @return 0 if the tokens were taken, otherwise the milliseconds to wait
+     */
+    static long long chargeQuota(UserID user_id, int cost);
+
+    /**
+     * @brief Gets the workload of a command cost class.
+     * @param cost_class JsonMessageCommand::CostClass
+     */
+    static CommandCostStatistics getCostStatistics(int cost_class);
     
 private:
     std::unique_ptr<JsonMessageProcessImpl> m_process;
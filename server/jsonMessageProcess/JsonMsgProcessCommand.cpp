@@ -1,10 +1,13 @@
 #include "JsonMsgProcessCommand.h"
 
 #include <format>
+#include <system_error>
 #include <unordered_set>
 #include <logger.hpp>
+#include <eventLog.h>
 
 #include "manager.h"
+#include "JsonMsgProcess.h"
 #include "regexMatch.hpp"
 #include "returnStateMessage.hpp"
 #include "definition.hpp"
@@ -13,22 +16,20 @@
 
 extern qls::Manager serverManager;
 extern Log::Logger serverLogger;
+extern Log::EventLogger serverEventLogger;
 
 namespace qls
 {
 
-qjson::JObject RegisterCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject RegisterCommand::execute(UserID executor, const RegisterParameters& parameters)
 {
-    std::string email = parameters["email"].getString();
-    std::string password = parameters["password"].getString();
-
-    if (!RegexMatch::emailMatch(email)) {
+    if (!RegexMatch::emailMatch(parameters.email)) {
         return makeErrorMessage("Email is invalid");
     }
 
     auto ptr = serverManager.addNewUser();
-    ptr->firstUpdateUserPassword(password);
-    ptr->updateUserEmail(email);
+    ptr->firstUpdateUserPassword(parameters.password);
+    ptr->updateUserEmail(parameters.email);
 
     qjson::JObject returnJson = makeSuccessMessage("Successfully created a new user!");
     UserID id = ptr->getUserID();
@@ -38,22 +39,22 @@ qjson::JObject RegisterCommand::execute(UserID executor, qjson::JObject paramete
     return returnJson;
 }
 
-qjson::JObject HasUserCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject HasUserCommand::execute(UserID executor, const UserIDParameters& parameters)
 {
-    bool has_user = serverManager.hasUser(UserID(parameters["user_id"].getInt()));
+    bool has_user = serverManager.hasUser(parameters.user_id);
     auto returnJson = makeSuccessMessage("Successfully get a result!");
     returnJson["has_user"] = has_user;
     return returnJson;
 }
 
-qjson::JObject SearchUserCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject SearchUserCommand::execute(UserID executor, const UserIDParameters& parameters)
 {
     return makeErrorMessage("This function is incomplete.");
 }
 
-qjson::JObject AddFriendCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject AddFriendCommand::execute(UserID executor, const UserIDParameters& parameters)
 {
-    UserID friend_id = UserID(parameters["user_id"].getInt());
+    UserID friend_id = parameters.user_id;
 
     if (!serverManager.hasUser(friend_id))
         return makeErrorMessage("UserID is invalid!");
@@ -66,9 +67,9 @@ qjson::JObject AddFriendCommand::execute(UserID executor, qjson::JObject paramet
     else return makeErrorMessage("Can't send application");
 }
 
-qjson::JObject AcceptFriendVerificationCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject AcceptFriendVerificationCommand::execute(UserID executor, const UserIDParameters& parameters)
 {
-    UserID user_id = UserID(parameters["user_id"].getInt());
+    UserID user_id = parameters.user_id;
 
     if (!serverManager.hasUser(user_id))
         return makeErrorMessage("UserID is invalid!");
@@ -78,9 +79,9 @@ qjson::JObject AcceptFriendVerificationCommand::execute(UserID executor, qjson::
     return makeSuccessMessage("Successfully added a friend!");
 }
 
-qjson::JObject RejectFriendVerificationCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject RejectFriendVerificationCommand::execute(UserID executor, const UserIDParameters& parameters)
 {
-    UserID user_id = UserID(parameters["user_id"].getInt());
+    UserID user_id = parameters.user_id;
 
     if (!serverManager.hasUser(user_id))
         return makeErrorMessage("UserID is invalid!");
@@ -93,7 +94,7 @@ qjson::JObject RejectFriendVerificationCommand::execute(UserID executor, qjson::
     return makeSuccessMessage("Successfully rejected a friend verification!");
 }
 
-qjson::JObject GetFriendListCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject GetFriendListCommand::execute(UserID executor, const EmptyParameters& parameters)
 {
     auto set = serverManager.getUser(executor)->getFriendList();
     qjson::JObject returnJson = makeSuccessMessage("Successfully obtained friend list!");
@@ -106,7 +107,7 @@ qjson::JObject GetFriendListCommand::execute(UserID executor, qjson::JObject par
     return returnJson;
 }
 
-qjson::JObject GetFriendVerificationListCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject GetFriendVerificationListCommand::execute(UserID executor, const EmptyParameters& parameters)
 {
     auto map = serverManager.getUser(executor)->getFriendVerificationList();
     qjson::JObject localVector;
@@ -127,9 +128,9 @@ qjson::JObject GetFriendVerificationListCommand::execute(UserID executor, qjson:
     return returnJson;
 }
 
-qjson::JObject RemoveFriendCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject RemoveFriendCommand::execute(UserID executor, const UserIDParameters& parameters)
 {
-    UserID user_id = UserID(parameters["user_id"].getInt());
+    UserID user_id = parameters.user_id;
 
     if (!serverManager.hasUser(user_id))
         return makeErrorMessage("UserID is invalid!");
@@ -141,9 +142,9 @@ qjson::JObject RemoveFriendCommand::execute(UserID executor, qjson::JObject para
     return makeSuccessMessage("Successfully removed a friend");
 }
 
-qjson::JObject AddGroupCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject AddGroupCommand::execute(UserID executor, const GroupIDParameters& parameters)
 {
-    GroupID group_id = GroupID(parameters["group_id"].getInt());
+    GroupID group_id = parameters.group_id;
 
     if (!serverManager.hasGroupRoom(group_id))
         return makeErrorMessage("GroupID is invalid!");
@@ -155,10 +156,10 @@ qjson::JObject AddGroupCommand::execute(UserID executor, qjson::JObject paramete
     else return makeErrorMessage("Failed to send a group application!");
 }
 
-qjson::JObject AcceptGroupVerificationCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject AcceptGroupVerificationCommand::execute(UserID executor, const GroupUserParameters& parameters)
 {
-    GroupID group_id = GroupID(parameters["group_id"].getInt());
-    UserID user_id = UserID(parameters["user_id"].getInt());
+    GroupID group_id = parameters.group_id;
+    UserID user_id = parameters.user_id;
 
     if (serverManager.getUser(executor)->acceptGroup(group_id, user_id)) {
         serverLogger.debug("User ", executor.getOriginValue(), " accept user \"", user_id.getOriginValue(), "\"'s group request");
@@ -167,10 +168,10 @@ qjson::JObject AcceptGroupVerificationCommand::execute(UserID executor, qjson::J
     else return makeErrorMessage("Failed to accept a group application!"); 
 }
 
-qjson::JObject RejectGroupVerificationCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject RejectGroupVerificationCommand::execute(UserID executor, const GroupUserParameters& parameters)
 {
-    GroupID group_id = GroupID(parameters["group_id"].getInt());
-    UserID user_id = UserID(parameters["user_id"].getInt());
+    GroupID group_id = parameters.group_id;
+    UserID user_id = parameters.user_id;
 
     if (serverManager.getUser(executor)->rejectGroup(group_id, user_id)) {
         serverLogger.debug("User ", executor.getOriginValue(), " reject user \"", user_id.getOriginValue(), "\"'s group request");
@@ -179,7 +180,7 @@ qjson::JObject RejectGroupVerificationCommand::execute(UserID executor, qjson::J
     else return makeErrorMessage("Failed to reject a group application!"); 
 }
 
-qjson::JObject GetGroupListCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject GetGroupListCommand::execute(UserID executor, const EmptyParameters& parameters)
 {
     auto set = std::move(serverManager.getUser(executor)->getGroupList());
     qjson::JObject returnJson = makeSuccessMessage("Successfully obtained group list!");
@@ -193,7 +194,7 @@ qjson::JObject GetGroupListCommand::execute(UserID executor, qjson::JObject para
     return returnJson;
 }
 
-qjson::JObject GetGroupVerificationListCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject GetGroupVerificationListCommand::execute(UserID executor, const EmptyParameters& parameters)
 {
     auto map = std::move(serverManager.getUser(executor)->getGroupVerificationList());
     auto returnJson = makeSuccessMessage("Successfully obtained verification list!");
@@ -209,10 +210,10 @@ qjson::JObject GetGroupVerificationListCommand::execute(UserID executor, qjson::
     return returnJson;
 }
 
-qjson::JObject SendFriendMessageCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject SendFriendMessageCommand::execute(UserID executor, const FriendMessageParameters& parameters)
 {
-    UserID friend_id = UserID(parameters["friend_id"].getInt());
-    std::string msg = parameters["message"].getString();
+    UserID friend_id = parameters.friend_id;
+    const std::string& msg = parameters.message;
 
     if (!serverManager.hasUser(friend_id))
         return makeErrorMessage("UserID is invalid!");
@@ -226,14 +227,15 @@ qjson::JObject SendFriendMessageCommand::execute(UserID executor, qjson::JObject
                 executor, friend_id))->sendMessage(msg, executor);
 
     serverLogger.debug("User ", executor.getOriginValue(), " sent a message to user ", friend_id.getOriginValue());
+    serverEventLogger.log(Log::EventID::FriendMessageSent, executor, friend_id, msg.size());
 
     return makeSuccessMessage("Successfully sent a message!");
 }
 
-qjson::JObject SendGroupMessageCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject SendGroupMessageCommand::execute(UserID executor, const GroupMessageParameters& parameters)
 {
-    GroupID group_id = GroupID(parameters["group_id"].getInt());
-    std::string msg = parameters["message"].getString();
+    GroupID group_id = parameters.group_id;
+    const std::string& msg = parameters.message;
 
     if (!serverManager.hasGroupRoom(group_id))
         return makeErrorMessage("GroupID is invalid!");
@@ -241,13 +243,25 @@ qjson::JObject SendGroupMessageCommand::execute(UserID executor, qjson::JObject
     if (!serverManager.getUser(executor)->userHasGroup(group_id))
         return makeErrorMessage("You don't have this group!");
 
-    serverManager.getGroupRoom(group_id)->sendMessage(executor, msg);
+    auto room = serverManager.getGroupRoom(group_id);
+    // The message is sent to every member, so a large group costs a token more per 1000 members
+    if (int fan_out_cost = static_cast<int>(room->getMemberCount() / 1000); fan_out_cost > 0) {
+        if (long long retry_after_ms = JsonMessageProcess::chargeQuota(executor, fan_out_cost);
+            retry_after_ms > 0) {
+            auto returnJson = makeErrorMessage("Too many requests, please slow down!");
+            returnJson["retry_after_ms"] = retry_after_ms;
+            return returnJson;
+        }
+    }
+
+    room->sendMessage(executor, msg);
     serverLogger.debug("User ", executor.getOriginValue(), " sent a message to group ", group_id.getOriginValue());
+    serverEventLogger.log(Log::EventID::GroupMessageSent, executor, group_id, msg.size());
 
     return makeSuccessMessage("Successfully sent a message!");
 }
 
-qjson::JObject CreateGroupCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject CreateGroupCommand::execute(UserID executor, const EmptyParameters& parameters)
 {
     try {
         GroupID group_id = serverManager.getUser(executor)->createGroup();
@@ -259,18 +273,64 @@ qjson::JObject CreateGroupCommand::execute(UserID executor, qjson::JObject param
     }
 }
 
-qjson::JObject RemoveGroupCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject RemoveGroupCommand::execute(UserID executor, const GroupIDParameters& parameters)
 {
-    GroupID group_id = GroupID(parameters["group_id"].getInt());
+    GroupID group_id = parameters.group_id;
     if (!serverManager.getUser(executor)->removeGroup(group_id))
         return makeErrorMessage("Failed to remove a group!");
     return makeSuccessMessage("Successfully removed a group!");
 }
 
-qjson::JObject LeaveGroupCommand::execute(UserID executor, qjson::JObject parameters)
+qjson::JObject LeaveGroupCommand::execute(UserID executor, const GroupIDParameters& parameters)
 {
-    GroupID group_id = GroupID(parameters["group_id"].getInt());
+    GroupID group_id = parameters.group_id;
     return makeErrorMessage("This function is incomplete.");
 }
 
+qjson::JObject CreateFileUploadCommand::execute(UserID executor, const FileUploadParameters& parameters)
+{
+    auto& file_transfer_manager = serverManager.getServerFileTransferManager();
+    try {
+        // The user stored the content before, so the upload is skipped
+        if (long long file_id = file_transfer_manager.addFileReference(
+                executor, parameters.hash, parameters.file_size);
+            file_id > 0) {
+            qjson::JObject json = makeSuccessMessage("The file is stored already!");
+            json["file_id"] = file_id;
+            return json;
+        }
+
+        long long upload_id = file_transfer_manager.createUpload(
+            executor, parameters.file_size, parameters.hash);
+        qjson::JObject json = makeSuccessMessage("Successfully created an upload!");
+        json["upload_id"] = upload_id;
+        return json;
+    } catch (const std::system_error& e) {
+        return makeErrorMessage(e.code().message());
+    }
+}
+
+qjson::JObject GetFileUploadOffsetCommand::execute(UserID executor, const UploadIDParameters& parameters)
+{
+    try {
+        long long offset = serverManager.getServerFileTransferManager()
+            .getUploadOffset(parameters.upload_id, executor);
+        qjson::JObject json = makeSuccessMessage("Successfully getting result!");
+        json["offset"] = offset;
+        return json;
+    } catch (const std::system_error& e) {
+        return makeErrorMessage(e.code().message());
+    }
+}
+
+qjson::JObject RemoveFileCommand::execute(UserID executor, const FileIDParameters& parameters)
+{
+    try {
+        serverManager.getServerFileTransferManager().removeFile(parameters.file_id, executor);
+        return makeSuccessMessage("Successfully removed a file!");
+    } catch (const std::system_error& e) {
+        return makeErrorMessage(e.code().message());
+    }
+}
+
 } // namespace qls
@@ -7,6 +7,9 @@
 
 #include "userid.hpp"
 #include "groupid.hpp"
+#include "returnStateMessage.hpp"
+#include "JsonMsgProcessSchema.hpp"
+#include "lazyJson.h"
 
 namespace qls
 {
@@ -20,417 +23,605 @@ public:
         LoginType = 1 // Use it if the function need to login.
     };
 
-    struct JsonOption
+    enum CostClass : int
     {
-        std::string name;
-        qjson::JValueType jsonValueType;
+        LightCost = 0, // Runs on the io threads.
+        HeavyCost = 1, // Runs on the worker pool, e.g. password hashing.
+        CostClassCount
+    };
+
+    enum OrderingType : int
+    {
+        SequentialOrder = 0, // Waits for the earlier requests and blocks the later ones.
+        ConcurrentOrder = 1 // Can run together with other concurrent requests of the connection.
     };
 
     JsonMessageCommand() = default;
     virtual ~JsonMessageCommand() = default;
 
-    virtual const std::vector<JsonOption>& getOption() const = 0;
     virtual int getCommandType() const = 0;
-    virtual qjson::JObject execute(UserID executor, qjson::JObject parameters) = 0;
+
+    /**
+     * @brief Gets the cost class which decides where the command is executed.
+     */
+    virtual int getCostClass() const
+    {
+        return LightCost;
+    }
+
+    /**
+     * @brief Gets the ordering constraint of the command when requests are pipelined.
+     */
+    virtual int getOrderingType() const
+    {
+        return SequentialOrder;
+    }
+
+    /**
+     * @brief Gets the number of tokens of the user's request quota the command takes.
+     *        Heavy commands take more, commands that fan out may override it.
+     */
+    virtual int getQuotaCost() const
+    {
+        return getCostClass() == HeavyCost ? 10 : 1;
+    }
+
+    /**
+     * @brief Validates and extracts the parameters, then executes the command.
+     * @param executor ID of the user who executes the command
+     * @param parameters Json dictionary of the parameters
+     * @return Result of the command
+     */
+    virtual qjson::JObject invoke(UserID executor, const qjson::JObject& parameters) = 0;
+
+    /**
+     * @brief Same as invoke(), the parameters are read from the request text lazily.
+     * @param executor ID of the user who executes the command
+     * @param parameters Lazy json dictionary of the parameters
+     * @return Result of the command
+     */
+    virtual qjson::JObject invoke(UserID executor, const LazyJsonValue& parameters) = 0;
 };
 
-class RegisterCommand: public JsonMessageCommand
+/**
+ * @brief Command whose parameters are described by a compiled schema.
+ * @tparam Parameters Typed structure of the parameters,
+ *         which must provide a static function schema()
+ */
+template<class Parameters>
+class JsonSchemaCommand: public JsonMessageCommand
 {
 public:
-    RegisterCommand() = default;
-    ~RegisterCommand() = default;
+    using ParameterType = Parameters;
+
+    JsonSchemaCommand() = default;
+    virtual ~JsonSchemaCommand() = default;
+
+    qjson::JObject invoke(UserID executor, const qjson::JObject& parameters) final
+    {
+        return invokeWith(executor, parameters);
+    }
+
+    qjson::JObject invoke(UserID executor, const LazyJsonValue& parameters) final
+    {
+        return invokeWith(executor, parameters);
+    }
 
-    const std::vector<JsonOption>& getOption() const
+    virtual qjson::JObject execute(UserID executor, const Parameters& parameters) = 0;
+
+private:
+    template<class View>
+    qjson::JObject invokeWith(UserID executor, const View& parameters)
+    {
+        Parameters local_parameters{};
+        if (std::string error = Parameters::schema().extract(parameters, local_parameters);
+            !error.empty())
+            return makeErrorMessage(error);
+        return execute(executor, local_parameters);
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// Parameters
+// -----------------------------------------------------------------------------------------------
+
+struct EmptyParameters
+{
+    static const JsonParameterSchema<EmptyParameters>& schema()
     {
-        static std::vector<JsonOption> v =
-            {{"email", qjson::JString},
-            {"password", qjson::JString}};
-        return v;
+        static const JsonParameterSchema<EmptyParameters> s;
+        return s;
     }
+};
+
+struct RegisterParameters
+{
+    std::string email;
+    std::string password;
+
+    static const JsonParameterSchema<RegisterParameters>& schema()
+    {
+        using Schema = JsonParameterSchema<RegisterParameters>;
+        static const Schema s{
+            Schema::field<&RegisterParameters::email>("email"),
+            Schema::field<&RegisterParameters::password>("password")};
+        return s;
+    }
+};
+
+struct UserIDParameters
+{
+    UserID user_id;
+
+    static const JsonParameterSchema<UserIDParameters>& schema()
+    {
+        using Schema = JsonParameterSchema<UserIDParameters>;
+        static const Schema s{
+            Schema::field<&UserIDParameters::user_id>("user_id")};
+        return s;
+    }
+};
+
+struct GroupIDParameters
+{
+    GroupID group_id;
+
+    static const JsonParameterSchema<GroupIDParameters>& schema()
+    {
+        using Schema = JsonParameterSchema<GroupIDParameters>;
+        static const Schema s{
+            Schema::field<&GroupIDParameters::group_id>("group_id")};
+        return s;
+    }
+};
+
+struct GroupUserParameters
+{
+    GroupID group_id;
+    UserID user_id;
+
+    static const JsonParameterSchema<GroupUserParameters>& schema()
+    {
+        using Schema = JsonParameterSchema<GroupUserParameters>;
+        static const Schema s{
+            Schema::field<&GroupUserParameters::group_id>("group_id"),
+            Schema::field<&GroupUserParameters::user_id>("user_id")};
+        return s;
+    }
+};
+
+struct FriendMessageParameters
+{
+    UserID friend_id;
+    std::string message;
+
+    static const JsonParameterSchema<FriendMessageParameters>& schema()
+    {
+        using Schema = JsonParameterSchema<FriendMessageParameters>;
+        static const Schema s{
+            Schema::field<&FriendMessageParameters::friend_id>("friend_id"),
+            Schema::field<&FriendMessageParameters::message>("message")};
+        return s;
+    }
+};
+
+struct GroupMessageParameters
+{
+    GroupID group_id;
+    std::string message;
+
+    static const JsonParameterSchema<GroupMessageParameters>& schema()
+    {
+        using Schema = JsonParameterSchema<GroupMessageParameters>;
+        static const Schema s{
+            Schema::field<&GroupMessageParameters::group_id>("group_id"),
+            Schema::field<&GroupMessageParameters::message>("message")};
+        return s;
+    }
+};
+
+struct FileUploadParameters
+{
+    long long file_size;
+    std::string hash;
+
+    static const JsonParameterSchema<FileUploadParameters>& schema()
+    {
+        using Schema = JsonParameterSchema<FileUploadParameters>;
+        static const Schema s{
+            Schema::field<&FileUploadParameters::file_size>("file_size"),
+            Schema::field<&FileUploadParameters::hash>("hash")};
+        return s;
+    }
+};
+
+struct FileIDParameters
+{
+    long long file_id;
+
+    static const JsonParameterSchema<FileIDParameters>& schema()
+    {
+        using Schema = JsonParameterSchema<FileIDParameters>;
+        static const Schema s{
+            Schema::field<&FileIDParameters::file_id>("file_id")};
+        return s;
+    }
+};
+
+struct UploadIDParameters
+{
+    long long upload_id;
+
+    static const JsonParameterSchema<UploadIDParameters>& schema()
+    {
+        using Schema = JsonParameterSchema<UploadIDParameters>;
+        static const Schema s{
+            Schema::field<&UploadIDParameters::upload_id>("upload_id")};
+        return s;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// Commands
+// -----------------------------------------------------------------------------------------------
+
+class RegisterCommand: public JsonSchemaCommand<RegisterParameters>
+{
+public:
+    RegisterCommand() = default;
+    ~RegisterCommand() = default;
 
     int getCommandType() const
     {
         return NormalType;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    int getCostClass() const
+    {
+        return HeavyCost;
+    }
+
+    int getOrderingType() const
+    {
+        return ConcurrentOrder;
+    }
+
+    qjson::JObject execute(UserID executor, const RegisterParameters& parameters);
 };
 
-class HasUserCommand: public JsonMessageCommand
+class HasUserCommand: public JsonSchemaCommand<UserIDParameters>
 {
 public:
     HasUserCommand() = default;
     ~HasUserCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
+    int getCommandType() const
     {
-        static std::vector<JsonOption> v =
-            {{"user_id", qjson::JInt}};
-        return v;
+        return NormalType;
     }
 
-    int getCommandType() const
+    int getOrderingType() const
     {
-        return NormalType;
+        return ConcurrentOrder;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const UserIDParameters& parameters);
 };
 
-class SearchUserCommand: public JsonMessageCommand
+class SearchUserCommand: public JsonSchemaCommand<UserIDParameters>
 {
 public:
     SearchUserCommand() = default;
     ~SearchUserCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
+    int getCommandType() const
     {
-        static std::vector<JsonOption> v =
-            {{"user_id", qjson::JInt}};
-        return v;
+        return NormalType;
     }
 
-    int getCommandType() const
+    int getOrderingType() const
     {
-        return NormalType;
+        return ConcurrentOrder;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const UserIDParameters& parameters);
 };
 
-class AddFriendCommand: public JsonMessageCommand
+class AddFriendCommand: public JsonSchemaCommand<UserIDParameters>
 {
 public:
     AddFriendCommand() = default;
     ~AddFriendCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
-    {
-        static std::vector<JsonOption> v =
-            {{"user_id", qjson::JInt}};
-        return v;
-    }
-
     int getCommandType() const
     {
         return LoginType;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const UserIDParameters& parameters);
 };
 
-class AcceptFriendVerificationCommand: public JsonMessageCommand
+class AcceptFriendVerificationCommand: public JsonSchemaCommand<UserIDParameters>
 {
 public:
     AcceptFriendVerificationCommand() = default;
     ~AcceptFriendVerificationCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
-    {
-        static std::vector<JsonOption> v =
-            {{"user_id", qjson::JInt}};
-        return v;
-    }
-
     int getCommandType() const
     {
         return LoginType;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const UserIDParameters& parameters);
 };
 
-class RejectFriendVerificationCommand: public JsonMessageCommand
+class RejectFriendVerificationCommand: public JsonSchemaCommand<UserIDParameters>
 {
 public:
     RejectFriendVerificationCommand() = default;
     ~RejectFriendVerificationCommand() = default;
-    
-    const std::vector<JsonOption>& getOption() const
-    {
-        static std::vector<JsonOption> v =
-            {{"user_id", qjson::JInt}};
-        return v;
-    }
 
     int getCommandType() const
     {
         return LoginType;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const UserIDParameters& parameters);
 };
 
-class GetFriendListCommand: public JsonMessageCommand
+class GetFriendListCommand: public JsonSchemaCommand<EmptyParameters>
 {
 public:
     GetFriendListCommand() = default;
     ~GetFriendListCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
+    int getCommandType() const
     {
-        static std::vector<JsonOption> v;
-        return v;
+        return LoginType;
     }
 
-    int getCommandType() const
+    int getOrderingType() const
     {
-        return LoginType;
+        return ConcurrentOrder;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const EmptyParameters& parameters);
 };
 
-class GetFriendVerificationListCommand: public JsonMessageCommand
+class GetFriendVerificationListCommand: public JsonSchemaCommand<EmptyParameters>
 {
 public:
     GetFriendVerificationListCommand() = default;
     ~GetFriendVerificationListCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
+    int getCommandType() const
     {
-        static std::vector<JsonOption> v;
-        return v;
+        return LoginType;
     }
 
-    int getCommandType() const
+    int getOrderingType() const
     {
-        return LoginType;
+        return ConcurrentOrder;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const EmptyParameters& parameters);
 };
 
-class RemoveFriendCommand: public JsonMessageCommand
+class RemoveFriendCommand: public JsonSchemaCommand<UserIDParameters>
 {
 public:
     RemoveFriendCommand() = default;
     ~RemoveFriendCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
-    {
-        static std::vector<JsonOption> v =
-            {{"user_id", qjson::JInt}};
-        return v;
-    }
-
     int getCommandType() const
     {
         return LoginType;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const UserIDParameters& parameters);
 };
 
-class AddGroupCommand: public JsonMessageCommand
+class AddGroupCommand: public JsonSchemaCommand<GroupIDParameters>
 {
 public:
     AddGroupCommand() = default;
     ~AddGroupCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
-    {
-        static std::vector<JsonOption> v =
-            {{"group_id", qjson::JInt}};
-        return v;
-    }
-
     int getCommandType() const
     {
         return LoginType;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const GroupIDParameters& parameters);
 };
 
-class AcceptGroupVerificationCommand: public JsonMessageCommand
+class AcceptGroupVerificationCommand: public JsonSchemaCommand<GroupUserParameters>
 {
 public:
     AcceptGroupVerificationCommand() = default;
     ~AcceptGroupVerificationCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
-    {
-        static std::vector<JsonOption> v =
-            {{"group_id", qjson::JInt},
-            {"user_id", qjson::JInt}};
-        return v;
-    }
-
     int getCommandType() const
     {
         return LoginType;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const GroupUserParameters& parameters);
 };
 
-class RejectGroupVerificationCommand: public JsonMessageCommand
+class RejectGroupVerificationCommand: public JsonSchemaCommand<GroupUserParameters>
 {
 public:
     RejectGroupVerificationCommand() = default;
     ~RejectGroupVerificationCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
-    {
-        static std::vector<JsonOption> v =
-            {{"group_id", qjson::JInt},
-            {"user_id", qjson::JInt}};
-        return v;
-    }
-
     int getCommandType() const
     {
         return LoginType;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const GroupUserParameters& parameters);
 };
 
-class GetGroupListCommand: public JsonMessageCommand
+class GetGroupListCommand: public JsonSchemaCommand<EmptyParameters>
 {
 public:
     GetGroupListCommand() = default;
     ~GetGroupListCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
+    int getCommandType() const
     {
-        static std::vector<JsonOption> v;
-        return v;
+        return LoginType;
     }
 
-    int getCommandType() const
+    int getOrderingType() const
     {
-        return LoginType;
+        return ConcurrentOrder;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const EmptyParameters& parameters);
 };
 
-class GetGroupVerificationListCommand: public JsonMessageCommand
+class GetGroupVerificationListCommand: public JsonSchemaCommand<EmptyParameters>
 {
 public:
     GetGroupVerificationListCommand() = default;
     ~GetGroupVerificationListCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
+    int getCommandType() const
     {
-        static std::vector<JsonOption> v;
-        return v;
+        return LoginType;
     }
 
-    int getCommandType() const
+    int getOrderingType() const
     {
-        return LoginType;
+        return ConcurrentOrder;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const EmptyParameters& parameters);
 };
 
-class CreateGroupCommand: public JsonMessageCommand
+class CreateGroupCommand: public JsonSchemaCommand<EmptyParameters>
 {
 public:
     CreateGroupCommand() = default;
     ~CreateGroupCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
-    {
-        static std::vector<JsonOption> v;
-        return v;
-    }
-
     int getCommandType() const
     {
         return LoginType;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const EmptyParameters& parameters);
 };
 
-class RemoveGroupCommand: public JsonMessageCommand
+class RemoveGroupCommand: public JsonSchemaCommand<GroupIDParameters>
 {
 public:
     RemoveGroupCommand() = default;
     ~RemoveGroupCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
-    {
-        static std::vector<JsonOption> v =
-            {{"group_id", qjson::JInt}};
-        return v;
-    }
-
     int getCommandType() const
     {
         return LoginType;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const GroupIDParameters& parameters);
 };
 
-class LeaveGroupCommand: public JsonMessageCommand
+class LeaveGroupCommand: public JsonSchemaCommand<GroupIDParameters>
 {
 public:
     LeaveGroupCommand() = default;
     ~LeaveGroupCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
+    int getCommandType() const
     {
-        static std::vector<JsonOption> v =
-            {{"group_id", qjson::JInt}};
-        return v;
+        return LoginType;
     }
 
+    qjson::JObject execute(UserID executor, const GroupIDParameters& parameters);
+};
+
+class SendFriendMessageCommand: public JsonSchemaCommand<FriendMessageParameters>
+{
+public:
+    SendFriendMessageCommand() = default;
+    ~SendFriendMessageCommand() = default;
+
     int getCommandType() const
     {
         return LoginType;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const FriendMessageParameters& parameters);
 };
 
-class SendFriendMessageCommand: public JsonMessageCommand
+class SendGroupMessageCommand: public JsonSchemaCommand<GroupMessageParameters>
 {
 public:
-    SendFriendMessageCommand() = default;
-    ~SendFriendMessageCommand() = default;
+    SendGroupMessageCommand() = default;
+    ~SendGroupMessageCommand() = default;
 
-    const std::vector<JsonOption>& getOption() const
+    int getCommandType() const
+    {
+        return LoginType;
+    }
+
+    int getQuotaCost() const
     {
-        static std::vector<JsonOption> v =
-            {{"friend_id", qjson::JInt},
-            {"message", qjson::JString}};
-        return v;
+        // The fan-out to the members is charged by execute(), it depends on the group
+        return 1;
     }
 
+    qjson::JObject execute(UserID executor, const GroupMessageParameters& parameters);
+};
+
+class CreateFileUploadCommand: public JsonSchemaCommand<FileUploadParameters>
+{
+public:
+    CreateFileUploadCommand() = default;
+    ~CreateFileUploadCommand() = default;
+
     int getCommandType() const
     {
         return LoginType;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const FileUploadParameters& parameters);
 };
 
-class SendGroupMessageCommand: public JsonMessageCommand
+class GetFileUploadOffsetCommand: public JsonSchemaCommand<UploadIDParameters>
 {
 public:
-    SendGroupMessageCommand() = default;
-    ~SendGroupMessageCommand() = default;
+    GetFileUploadOffsetCommand() = default;
+    ~GetFileUploadOffsetCommand() = default;
+
+    int getCommandType() const
+    {
+        return LoginType;
+    }
 
-    const std::vector<JsonOption>& getOption() const
+    int getOrderingType() const
     {
-        static std::vector<JsonOption> v =
-            {{"group_id", qjson::JInt},
-            {"message", qjson::JString}};
-        return v;
+        return ConcurrentOrder;
     }
 
+    qjson::JObject execute(UserID executor, const UploadIDParameters& parameters);
+};
+
+class RemoveFileCommand: public JsonSchemaCommand<FileIDParameters>
+{
+public:
+    RemoveFileCommand() = default;
+    ~RemoveFileCommand() = default;
+
     int getCommandType() const
     {
         return LoginType;
     }
 
-    qjson::JObject execute(UserID executor, qjson::JObject parameters);
+    qjson::JObject execute(UserID executor, const FileIDParameters& parameters);
 };
 
 } // namespace qls
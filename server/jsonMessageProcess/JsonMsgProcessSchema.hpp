@@ -0,0 +1,206 @@
+#ifndef JSON_MESSAGE_PROCESS_SCHEMA_HPP
+#define JSON_MESSAGE_PROCESS_SCHEMA_HPP
+
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <format>
+#include <Json.h>
+
+#include "userid.hpp"
+#include "groupid.hpp"
+#include "lazyJson.h"
+
+namespace qls
+{
+
+/**
+ * @brief Maps the type of a parameter member onto the json value type it is read from.
+ * @tparam T Type of the member in the parameter structure
+ */
+template<class T>
+struct JsonParameterTraits;
+
+template<>
+struct JsonParameterTraits<long long>
+{
+    static constexpr qjson::JValueType type = qjson::JInt;
+    static long long extract(const qjson::JObject& value) { return value.getInt(); }
+    static long long extract(const LazyJsonValue& value) { return value.getInt(); }
+};
+
+template<>
+struct JsonParameterTraits<bool>
+{
+    static constexpr qjson::JValueType type = qjson::JBool;
+    static bool extract(const qjson::JObject& value) { return value.getBool(); }
+    static bool extract(const LazyJsonValue& value) { return value.getBool(); }
+};
+
+template<>
+struct JsonParameterTraits<std::string>
+{
+    static constexpr qjson::JValueType type = qjson::JString;
+    static std::string extract(const qjson::JObject& value) { return value.getString(); }
+    static std::string extract(const LazyJsonValue& value) { return value.getString(); }
+};
+
+template<>
+struct JsonParameterTraits<UserID>
+{
+    static constexpr qjson::JValueType type = qjson::JInt;
+    static UserID extract(const qjson::JObject& value) { return UserID(value.getInt()); }
+    static UserID extract(const LazyJsonValue& value) { return UserID(value.getInt()); }
+};
+
+template<>
+struct JsonParameterTraits<GroupID>
+{
+    static constexpr qjson::JValueType type = qjson::JInt;
+    static GroupID extract(const qjson::JObject& value) { return GroupID(value.getInt()); }
+    static GroupID extract(const LazyJsonValue& value) { return GroupID(value.getInt()); }
+};
+
+/// Nested dictionaries are referenced instead of copied,
+/// so the json object must outlive the parameter structure
+template<>
+struct JsonParameterTraits<const qjson::JObject*>
+{
+    static constexpr qjson::JValueType type = qjson::JDict;
+    static const qjson::JObject* extract(const qjson::JObject& value) { return &value; }
+};
+
+/// Nested dictionaries of a lazy document stay unparsed,
+/// so the document must outlive the parameter structure
+template<>
+struct JsonParameterTraits<LazyJsonValue>
+{
+    static constexpr qjson::JValueType type = qjson::JDict;
+    static LazyJsonValue extract(const LazyJsonValue& value) { return value; }
+};
+
+/**
+ * @class JsonParameterSchema
+ * @brief Declarative description of the parameters of a command.
+ *
+ * The schema is compiled once into a list of fields, each of which knows its
+ * json name, the expected json type and how to store the value into the
+ * parameter structure. Validation and extraction happen in a single pass,
+ * either over a parsed qjson::JObject or over a LazyJsonValue whose members
+ * are decoded straight from the request text.
+ *
+ * @tparam Parameters Typed structure the parameters are extracted into
+ */
+template<class Parameters>
+class JsonParameterSchema final
+{
+public:
+    struct Field
+    {
+        std::string         name;   ///< Name of the parameter in json
+        qjson::JValueType   type;   ///< Expected json type
+        void              (*assign)(const qjson::JObject&, Parameters&); ///< Stores the value into the structure
+        void              (*assign_lazy)(const LazyJsonValue&, Parameters&); ///< Same as assign, from a lazy value
+    };
+
+    JsonParameterSchema() = default;
+    JsonParameterSchema(std::initializer_list<Field> fields):
+        m_fields(fields) {}
+    JsonParameterSchema(const JsonParameterSchema&) = delete;
+    JsonParameterSchema(JsonParameterSchema&&) = delete;
+    ~JsonParameterSchema() noexcept = default;
+
+    JsonParameterSchema& operator=(const JsonParameterSchema&) = delete;
+    JsonParameterSchema& operator=(JsonParameterSchema&&) = delete;
+
+    /**
+     * @brief Binds a json parameter to a member of the parameter structure.
+     *        The json type is deduced from the type of the member.
+     * @tparam Member Pointer to the member of the parameter structure
+     * @param name Name of the parameter in json
+     * @return Compiled field
+     */
+    template<auto Member>
+    [[nodiscard]] static Field field(std::string_view name)
+    {
+        using value_type = std::remove_cvref_t<decltype(std::declval<Parameters&>().*Member)>;
+        using traits = JsonParameterTraits<value_type>;
+
+        Field result{ std::string(name), traits::type, nullptr, nullptr };
+        if constexpr (requires (const qjson::JObject& value) { traits::extract(value); }) {
+            result.assign = [](const qjson::JObject& value, Parameters& parameters) {
+                parameters.*Member = traits::extract(value);
+            };
+        }
+        if constexpr (requires (const LazyJsonValue& value) { traits::extract(value); }) {
+            result.assign_lazy = [](const LazyJsonValue& value, Parameters& parameters) {
+                parameters.*Member = traits::extract(value);
+            };
+        }
+        return result;
+    }
+
+    /**
+     * @brief Validates the json dictionary and extracts it into the parameter structure.
+     * @param json Json dictionary of the parameters
+     * @param parameters Structure to store the parameters
+     * @return Empty string if succeeded, otherwise the error message
+     */
+    [[nodiscard]] std::string extract(const qjson::JObject& json, Parameters& parameters) const
+    {
+        if (json.getType() != qjson::JDict)
+            return "The parameters must be dictory type!";
+
+        const qjson::dict_t& dict = json.getDict();
+        for (const auto& field: m_fields) {
+            auto iter = dict.find(field.name);
+            if (iter == dict.cend())
+                return std::format("Lost a parameter: {}.", field.name);
+            if (iter->second.getType() != field.type || !field.assign)
+                return std::format("Wrong parameter type: {}.", field.name);
+            field.assign(iter->second, parameters);
+        }
+        return {};
+    }
+
+    /**
+     * @brief Same as extract(), the members are looked up in the request text
+     *        and only the ones in the schema are decoded.
+     * @param json Lazy json dictionary of the parameters
+     * @param parameters Structure to store the parameters
+     * @return Empty string if succeeded, otherwise the error message
+     */
+    [[nodiscard]] std::string extract(const LazyJsonValue& json, Parameters& parameters) const
+    {
+        if (json.getType() != qjson::JDict)
+            return "The parameters must be dictory type!";
+
+        for (const auto& field: m_fields) {
+            LazyJsonValue value = json.find(field.name);
+            if (!value.isValid())
+                return std::format("Lost a parameter: {}.", field.name);
+            if (value.getType() != field.type || !field.assign_lazy)
+                return std::format("Wrong parameter type: {}.", field.name);
+            field.assign_lazy(value, parameters);
+        }
+        return {};
+    }
+
+    /**
+     * @brief Gets the compiled fields of this schema
+     */
+    [[nodiscard]] const std::vector<Field>& getFields() const noexcept
+    {
+        return m_fields;
+    }
+
+private:
+    const std::vector<Field> m_fields;
+};
+
+} // namespace qls
+
+#endif // !JSON_MESSAGE_PROCESS_SCHEMA_HPP
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <logger.hpp>
+#include <eventLog.h>
 #include <thread>
 #include <chrono>
 
@@ -12,6 +13,8 @@
 
 // server log system
 Log::Logger serverLogger;
+// server event log
+Log::EventLogger serverEventLogger;
 // ini config
 qini::INIObject serverIni;
 // manager
@@ -7,6 +7,8 @@
 #include "user.h"
 #include "dataPackage.h"
 #include "qls_error.h"
+#include "profiled_shared_mutex.hpp"
+#include "coarse_clock.hpp"
 
 extern qini::INIObject serverIni;
 
@@ -15,38 +17,45 @@ namespace qls
 
 struct ManagerImpl
 {
+    // Cached time of the hot paths, declared first so it ticks until everything else is gone
+    CoarseClock             m_coarse_clock;
+
+    // Timeouts of connections and rooms, declared first
+    // so it outlives the timers of the rooms
+    TimingWheel             m_timingWheel;
+
     DataManager             m_dataManager; ///< Data manager instance.
     VerificationManager     m_verificationManager; ///< Verification manager instance.
 
     // Group room map
     std::unordered_map<GroupID, std::shared_ptr<GroupRoom>>
                             m_groupRoom_map; ///< Map of group room IDs to group rooms.
-    std::shared_mutex       m_groupRoom_map_mutex; ///< Mutex for group room map.
+    profiled_shared_mutex   m_groupRoom_map_mutex{"ManagerImpl::m_groupRoom_map_mutex"}; ///< Mutex for group room map.
     std::pmr::synchronized_pool_resource
                             m_groupRoom_sync_pool;
 
     // Private room map
     std::unordered_map<GroupID, std::shared_ptr<PrivateRoom>>
                             m_privateRoom_map; ///< Map of private room IDs to private rooms.
-    std::shared_mutex       m_privateRoom_map_mutex; ///< Mutex for private room map.
+    profiled_shared_mutex   m_privateRoom_map_mutex{"ManagerImpl::m_privateRoom_map_mutex"}; ///< Mutex for private room map.
     std::pmr::synchronized_pool_resource
                             m_privateRoom_sync_pool;
 
     // Map of user IDs to private room IDs
     std::unordered_map<PrivateRoomIDStruct, GroupID, PrivateRoomIDStructHasher>
                             m_userID_to_privateRoomID_map;
-    std::shared_mutex       m_userID_to_privateRoomID_map_mutex;
+    profiled_shared_mutex   m_userID_to_privateRoomID_map_mutex{"ManagerImpl::m_userID_to_privateRoomID_map_mutex"};
 
     // User map
     std::unordered_map<UserID, std::shared_ptr<User>>
                             m_user_map;
-    std::shared_mutex       m_user_map_mutex;
+    profiled_shared_mutex   m_user_map_mutex{"ManagerImpl::m_user_map_mutex"};
     std::pmr::synchronized_pool_resource
                             m_user_sync_pool;
 
     std::unordered_map<std::shared_ptr<Connection>, UserID>
                             m_connection_map;
-    std::shared_mutex       m_connection_map_mutex;
+    profiled_shared_mutex   m_connection_map_mutex{"ManagerImpl::m_connection_map_mutex"};
 
     // New user ID
     std::atomic<long long>  m_newUserId;
@@ -60,6 +69,15 @@ struct ManagerImpl
 
     // Network
     Network                 m_network;
+
+    // Periodic maintenance tasks, run on the threads of the network
+    Timers                  m_timers{m_network.get_io_context().get_executor()};
+
+    // Worker pool for CPU-heavy commands
+    WorkerPool              m_workerPool;
+
+    // Attachment uploads and downloads
+    FileTransferManager     m_fileTransferManager;
 };
 
 Manager::Manager():
@@ -70,6 +88,8 @@ Manager::~Manager() = default;
 
 void Manager::init()
 {
+    m_impl->m_coarse_clock.start();
+
     // initiate sql database connection
 
     // m_sqlProcess.setSQLServerInfo(serverIni["mysql"]["username"],
@@ -92,11 +112,23 @@ void Manager::init()
 
     m_impl->m_dataManager.init();
     m_impl->m_verificationManager.init();
+    m_impl->m_workerPool.start();
+    m_impl->m_fileTransferManager.init();
+    m_impl->m_timers.addTask("idle upload cleaning", std::chrono::minutes(1), [this]() {
+        m_impl->m_fileTransferManager.removeIdleUploads();
+    });
+
+    // One sweep for every private room, instead of a timer in each of them
+    m_impl->m_timers.addTask("private message cleaning", std::chrono::minutes(10), [this]() {
+        std::shared_lock<profiled_shared_mutex> lock(m_impl->m_privateRoom_map_mutex);
+        for (const auto& [private_room_id, private_room]: m_impl->m_privateRoom_map)
+            private_room->auto_clean();
+    });
 }
 
 GroupID Manager::addPrivateRoom(UserID user1_id, UserID user2_id)
 {
-    std::unique_lock<std::shared_mutex> lock1(m_impl->m_privateRoom_map_mutex, std::defer_lock),
+    std::unique_lock<profiled_shared_mutex> lock1(m_impl->m_privateRoom_map_mutex, std::defer_lock),
         lock2(m_impl->m_userID_to_privateRoomID_map_mutex, std::defer_lock);
     std::lock(lock1, lock2);
 
@@ -118,7 +150,7 @@ GroupID Manager::addPrivateRoom(UserID user1_id, UserID user2_id)
 
 GroupID Manager::getPrivateRoomId(UserID user1_id, UserID user2_id) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_userID_to_privateRoomID_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_userID_to_privateRoomID_map_mutex);
     if (m_impl->m_userID_to_privateRoomID_map.find(
         { user1_id , user2_id }) != m_impl->m_userID_to_privateRoomID_map.cend())
         return GroupID(m_impl->m_userID_to_privateRoomID_map.find({ user1_id , user2_id })->second);
@@ -130,14 +162,14 @@ GroupID Manager::getPrivateRoomId(UserID user1_id, UserID user2_id) const
 
 bool Manager::hasPrivateRoom(GroupID private_room_id) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_privateRoom_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_privateRoom_map_mutex);
     return m_impl->m_privateRoom_map.find(
         private_room_id) != m_impl->m_privateRoom_map.cend();
 }
 
 bool Manager::hasPrivateRoom(UserID user1_id, UserID user2_id) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_userID_to_privateRoomID_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_userID_to_privateRoomID_map_mutex);
     if (m_impl->m_userID_to_privateRoomID_map.find(
         { user1_id , user2_id }) != m_impl->m_userID_to_privateRoomID_map.cend())
         return true;
@@ -149,7 +181,7 @@ bool Manager::hasPrivateRoom(UserID user1_id, UserID user2_id) const
 
 std::shared_ptr<PrivateRoom> Manager::getPrivateRoom(GroupID private_room_id) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_privateRoom_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_privateRoom_map_mutex);
     auto itor = m_impl->m_privateRoom_map.find(private_room_id);
     if (itor == m_impl->m_privateRoom_map.cend())
         throw std::system_error(make_error_code(qls_errc::private_room_not_existed));
@@ -158,7 +190,7 @@ std::shared_ptr<PrivateRoom> Manager::getPrivateRoom(GroupID private_room_id) co
 
 void Manager::removePrivateRoom(GroupID private_room_id)
 {
-    std::unique_lock<std::shared_mutex> lock1(m_impl->m_privateRoom_map_mutex, std::defer_lock),
+    std::unique_lock<profiled_shared_mutex> lock1(m_impl->m_privateRoom_map_mutex, std::defer_lock),
         lock2(m_impl->m_userID_to_privateRoomID_map_mutex, std::defer_lock);
     std::lock(lock1, lock2);
 
@@ -185,7 +217,7 @@ void Manager::removePrivateRoom(GroupID private_room_id)
 
 GroupID Manager::addGroupRoom(UserID opreator_user_id)
 {
-    std::unique_lock<std::shared_mutex> lock(m_impl->m_groupRoom_map_mutex);
+    std::unique_lock<profiled_shared_mutex> lock(m_impl->m_groupRoom_map_mutex);
     // 新群聊id
     GroupID group_room_id(m_impl->m_newPrivateRoomId++);
     {
@@ -203,14 +235,14 @@ GroupID Manager::addGroupRoom(UserID opreator_user_id)
 
 bool Manager::hasGroupRoom(GroupID group_room_id) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_groupRoom_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_groupRoom_map_mutex);
     return m_impl->m_groupRoom_map.find(group_room_id) !=
         m_impl->m_groupRoom_map.cend();
 }
 
 std::shared_ptr<GroupRoom> Manager::getGroupRoom(GroupID group_room_id) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_groupRoom_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_groupRoom_map_mutex);
     auto itor = m_impl->m_groupRoom_map.find(group_room_id);
     if (itor == m_impl->m_groupRoom_map.cend())
         throw std::system_error(make_error_code(qls_errc::group_room_not_existed));
@@ -219,7 +251,7 @@ std::shared_ptr<GroupRoom> Manager::getGroupRoom(GroupID group_room_id) const
 
 void Manager::removeGroupRoom(GroupID group_room_id)
 {
-    std::unique_lock<std::shared_mutex> lock(m_impl->m_groupRoom_map_mutex);
+    std::unique_lock<profiled_shared_mutex> lock(m_impl->m_groupRoom_map_mutex);
     auto itor = m_impl->m_groupRoom_map.find(group_room_id);
     if (itor == m_impl->m_groupRoom_map.cend())
         throw std::system_error(make_error_code(qls_errc::group_room_not_existed));
@@ -236,7 +268,7 @@ void Manager::removeGroupRoom(GroupID group_room_id)
 
 std::shared_ptr<User> Manager::addNewUser()
 {
-    std::unique_lock<std::shared_mutex> lock(m_impl->m_user_map_mutex);
+    std::unique_lock<profiled_shared_mutex> lock(m_impl->m_user_map_mutex);
     UserID newUserId(m_impl->m_newUserId++);
     {
         // Update data from database
@@ -250,13 +282,13 @@ std::shared_ptr<User> Manager::addNewUser()
 
 bool Manager::hasUser(UserID user_id) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_user_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_user_map_mutex);
     return m_impl->m_user_map.find(user_id) != m_impl->m_user_map.cend();
 }
 
 std::shared_ptr<User> Manager::getUser(UserID user_id) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_user_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_user_map_mutex);
     auto itor = m_impl->m_user_map.find(user_id);
     if (itor == m_impl->m_user_map.cend())
         throw std::system_error(make_error_code(qls_errc::user_not_existed));
@@ -272,7 +304,7 @@ std::unordered_map<UserID, std::shared_ptr<User>> Manager::getUserList() const
 
 void Manager::registerConnection(const std::shared_ptr<Connection> &connection_ptr)
 {
-    std::unique_lock<std::shared_mutex> lock(m_impl->m_connection_map_mutex);
+    std::unique_lock<profiled_shared_mutex> lock(m_impl->m_connection_map_mutex);
     if (m_impl->m_connection_map.find(connection_ptr) != m_impl->m_connection_map.cend())
         throw std::system_error(make_error_code(qls_errc::socket_pointer_existed));
     m_impl->m_connection_map.emplace(connection_ptr, -1ll);
@@ -280,13 +312,13 @@ void Manager::registerConnection(const std::shared_ptr<Connection> &connection_p
 
 bool Manager::hasConnection(const std::shared_ptr<Connection> &connection_ptr) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_connection_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_connection_map_mutex);
     return m_impl->m_connection_map.find(connection_ptr) != m_impl->m_connection_map.cend();
 }
 
 bool Manager::matchUserOfConnection(const std::shared_ptr<Connection> &connection_ptr, UserID user_id) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_connection_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_connection_map_mutex);
     auto iter = m_impl->m_connection_map.find(connection_ptr);
     if (iter == m_impl->m_connection_map.cend()) return false;
     return iter->second == user_id;
@@ -294,7 +326,7 @@ bool Manager::matchUserOfConnection(const std::shared_ptr<Connection> &connectio
 
 UserID Manager::getUserIDOfConnection(const std::shared_ptr<Connection> &connection_ptr) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_connection_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_connection_map_mutex);
     auto iter = m_impl->m_connection_map.find(connection_ptr);
     if (iter == m_impl->m_connection_map.cend())
         throw std::system_error(make_error_code(qls_errc::socket_pointer_not_existed));
@@ -303,8 +335,8 @@ UserID Manager::getUserIDOfConnection(const std::shared_ptr<Connection> &connect
 
 void Manager::modifyUserOfConnection(const std::shared_ptr<Connection> &connection_ptr, UserID user_id, DeviceType type)
 {
-    std::unique_lock<std::shared_mutex> lock1(m_impl->m_connection_map_mutex, std::defer_lock);
-    std::shared_lock<std::shared_mutex> lock2(m_impl->m_user_map_mutex, std::defer_lock);
+    std::unique_lock<profiled_shared_mutex> lock1(m_impl->m_connection_map_mutex, std::defer_lock);
+    std::shared_lock<profiled_shared_mutex> lock2(m_impl->m_user_map_mutex, std::defer_lock);
     std::lock(lock1, lock2);
 
     if (m_impl->m_user_map.find(user_id) == m_impl->m_user_map.cend())
@@ -322,8 +354,8 @@ void Manager::modifyUserOfConnection(const std::shared_ptr<Connection> &connecti
 
 void Manager::removeConnection(const std::shared_ptr<Connection> &connection_ptr)
 {
-    std::unique_lock<std::shared_mutex> lock1(m_impl->m_connection_map_mutex, std::defer_lock);
-    std::shared_lock<std::shared_mutex> lock2(m_impl->m_user_map_mutex, std::defer_lock);
+    std::unique_lock<profiled_shared_mutex> lock1(m_impl->m_connection_map_mutex, std::defer_lock);
+    std::shared_lock<profiled_shared_mutex> lock2(m_impl->m_user_map_mutex, std::defer_lock);
     std::lock(lock1, lock2);
 
     auto iter = m_impl->m_connection_map.find(connection_ptr);
@@ -356,4 +388,24 @@ qls::Network &Manager::getServerNetwork()
     return m_impl->m_network;
 }
 
+qls::WorkerPool &Manager::getServerWorkerPool()
+{
+    return m_impl->m_workerPool;
+}
+
+qls::FileTransferManager &Manager::getServerFileTransferManager()
+{
+    return m_impl->m_fileTransferManager;
+}
+
+qls::TimingWheel &Manager::getServerTimingWheel()
+{
+    return m_impl->m_timingWheel;
+}
+
+qls::Timers &Manager::getServerTimers()
+{
+    return m_impl->m_timers;
+}
+
 } // namespace qls
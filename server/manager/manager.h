@@ -20,6 +20,10 @@
 #include "dataManager.h"
 #include "connection.hpp"
 #include "network.h"
+#include "workerPool.h"
+#include "fileTransfer.h"
+#include "timingWheel.h"
+#include "timer.hpp"
 
 namespace qls
 {
@@ -222,6 +226,30 @@ public:
      */
     [[nodiscard]] qls::Network& getServerNetwork();
 
+    /**
+     * @brief Retrieves the worker pool which runs CPU-heavy commands.
+     * @return Reference to the WorkerPool.
+     */
+    [[nodiscard]] qls::WorkerPool& getServerWorkerPool();
+
+    /**
+     * @brief Retrieves the file transfer manager which stores attachments.
+     * @return Reference to the FileTransferManager.
+     */
+    [[nodiscard]] qls::FileTransferManager& getServerFileTransferManager();
+
+    /**
+     * @brief Retrieves the timing wheel which runs the timeouts of connections and rooms.
+     * @return Reference to the TimingWheel.
+     */
+    [[nodiscard]] qls::TimingWheel& getServerTimingWheel();
+
+    /**
+     * @brief Retrieves the scheduler of periodic maintenance tasks.
+     * @return Reference to the Timers.
+     */
+    [[nodiscard]] qls::Timers& getServerTimers();
+
 private:
     std::unique_ptr<ManagerImpl> m_impl;
 };
@@ -10,6 +10,7 @@
 #include "friendRoomVerification.h"
 #include "groupRoomVerification.h"
 #include "definition.hpp"
+#include "profiled_shared_mutex.hpp"
 
 namespace qls
 {
@@ -110,7 +111,7 @@ private:
     std::unordered_map<PrivateRoomIDStruct,
         qls::FriendRoomVerification,
         PrivateRoomIDStructHasher>          m_FriendRoomVerification_map;
-    mutable std::shared_mutex               m_FriendRoomVerification_map_mutex; ///< Mutex for friend room verification map.
+    mutable profiled_shared_mutex           m_FriendRoomVerification_map_mutex{"VerificationManager::m_FriendRoomVerification_map_mutex"}; ///< Mutex for friend room verification map.
 
     /**
      * @brief Map of group room verification requests.
@@ -118,7 +119,7 @@ private:
     std::unordered_map<GroupVerificationStruct,
         qls::GroupRoomVerification,
         GroupVerificationStructHasher>      m_GroupVerification_map;
-    mutable std::shared_mutex               m_GroupVerification_map_mutex; ///< Mutex for group room verification map.
+    mutable profiled_shared_mutex           m_GroupVerification_map_mutex{"VerificationManager::m_GroupVerification_map_mutex"}; ///< Mutex for group room verification map.
 };
 
 } // namespace qls
@@ -1,7 +1,9 @@
 #include "network.h"
 
-#include <asio/experimental/awaitable_operators.hpp>
+#include <atomic>
 #include <logger.hpp>
+#include <eventLog.h>
+#include <optional>
 #include <system_error>
 #include <Json.h>
 #include <Ini.h>
@@ -12,8 +14,11 @@
 #include "manager.h"
 #include "qls_error.h"
 #include "connection.hpp"
+#include "fragmentAssembler.h"
+#include "coarse_clock.hpp"
 
 extern Log::Logger serverLogger;
+extern Log::EventLogger serverEventLogger;
 extern qls::Manager serverManager;
 extern qini::INIObject serverIni;
 
@@ -24,7 +29,6 @@ using asio::detached;
 using asio::use_awaitable;
 namespace this_coro = asio::this_coro;
 using namespace asio;
-using namespace experimental::awaitable_operators;
 using namespace std::chrono_literals;
 
 qls::Network::Network() :
@@ -68,7 +72,10 @@ void qls::Network::run(std::string_view host, unsigned short port)
         signals.async_wait([&](auto, auto) { m_io_context.stop(); });
 
         co_spawn(m_io_context, listener(), detached);
-        co_spawn(m_io_context, m_rateLimiter.auto_clean(), detached);
+        // One shard per run, so every bucket is looked at about every 30 seconds
+        serverManager.getServerTimers().addTask("rate limiter cleaning",
+            30s / RateLimiter::shard_count, [this]() { m_rateLimiter.clean(); });
+        co_spawn(m_io_context, serverManager.getServerTimingWheel().auto_tick(), detached);
         for (int i = 0; i < m_thread_num; i++) {
             m_threads[i] = std::thread([&]() {
                 m_io_context.run();
@@ -88,6 +95,16 @@ asio::io_context &qls::Network::get_io_context() noexcept
     return this->m_io_context;
 }
 
+void qls::Network::setMaxFrameSize(std::size_t size)
+{
+    m_max_frame_size = size;
+}
+
+std::size_t qls::Network::getMaxFrameSize() const noexcept
+{
+    return m_max_frame_size;
+}
+
 void qls::Network::stop()
 {
     m_io_context.stop();
@@ -113,32 +130,59 @@ awaitable<void> qls::Network::echo(ip::tcp::socket origin_socket)
     std::string addr = socket2ip(connection_ptr->socket);
     // Socket package receiver
     Package packageReceiver;
+    packageReceiver.setMaxFrameSize(m_max_frame_size);
+    // Reassembles messages sent in several packages
+    FragmentAssembler fragmentAssembler;
     // Register the socket
     serverManager.registerConnection(connection_ptr);
 
     try {
-        serverLogger.info(std::format("[{}] connected to the server", addr));
+        serverLogger.info("[", addr, "] connected to the server");
+        serverEventLogger.log(Log::EventID::Connected, addr);
 
-        // timeout function
-        auto timeout = [](const std::chrono::steady_clock::duration& duration) -> awaitable<void> {
-            steady_timer timer(co_await this_coro::executor);
-            timer.expires_after(duration);
-            co_await timer.async_wait(asio::use_awaitable);
-            throw std::system_error(make_error_code(std::errc::timed_out));
+        // The handshake and every read have a deadline in the timing wheel,
+        // an expired deadline cancels the pending operation on the strand.
+        // It is disarmed once the operation completes, so processing a request
+        // and writing its reply are never cut off by it
+        std::atomic<bool> deadline_expired = false;
+        WheelTimer deadline(serverManager.getServerTimingWheel());
+        auto expire = [&deadline_expired, connection_ptr]() {
+            deadline_expired = true;
+            post(connection_ptr->strand, [connection_ptr]() {
+                std::error_code ec;
+                connection_ptr->socket.lowest_layer().cancel(ec);
+            });
+        };
+        auto check = [&deadline_expired](const std::error_code& ec) {
+            if (deadline_expired)
+                throw std::system_error(make_error_code(std::errc::timed_out));
+            if (ec)
+                throw std::system_error(ec);
         };
 
         // SSL handshake
-        co_await (connection_ptr->socket.async_handshake(ssl::stream_base::server, use_awaitable) || timeout(10s));
+        std::error_code handshake_ec;
+        deadline.expires_after(10s, expire);
+        co_await connection_ptr->socket.async_handshake(ssl::stream_base::server,
+            redirect_error(use_awaitable, handshake_ec));
+        deadline.cancel();
+        check(handshake_ec);
 
         char data[8192] {0};
-        SocketService socketService(connection_ptr);
+        auto socketService = std::make_shared<SocketService>(connection_ptr);
         long long heart_beat_times = 0;
-        auto heart_beat_time_point = std::chrono::steady_clock::now();
+        auto heart_beat_time_point = CoarseClock::steadyNow();
         while (true) {
             try {
                 do {
-                    std::size_t n = std::get<0>(co_await (connection_ptr->socket.async_read_some(buffer(data),
-                        bind_executor(connection_ptr->strand, use_awaitable)) || timeout(60s)));
+                    // Rescheduling only relinks the timer in the wheel
+                    std::error_code ec;
+                    deadline.expires_after(60s);
+                    std::size_t n = co_await connection_ptr->socket.async_read_some(buffer(data),
+                        bind_executor(connection_ptr->strand, redirect_error(use_awaitable, ec)));
+                    // A deadline that expired before this reports the timeout below
+                    deadline.cancel();
+                    check(ec);
                     // serverLogger.info((std::format("[{}] received message: {}", addr, showBinaryData({data, n}))));
                     packageReceiver.write({ data, n });
                 } while (!packageReceiver.canRead());
@@ -147,10 +191,10 @@ awaitable<void> qls::Network::echo(ip::tcp::socket origin_socket)
                 if (pack->type == DataPackage::HeartBeat) {
                     // Heartbeat package
                     heart_beat_times++;
-                    if ((std::chrono::steady_clock::now() - heart_beat_time_point) >=
+                    if ((CoarseClock::steadyNow() - heart_beat_time_point) >=
                         std::chrono::seconds(10)) {
                         // Update time point
-                        heart_beat_time_point = std::chrono::steady_clock::now();
+                        heart_beat_time_point = CoarseClock::steadyNow();
                         if (heart_beat_times > 10) {
                             // Remove socket pointer from manager
                             // if there were too many heartbeats
@@ -162,12 +206,20 @@ awaitable<void> qls::Network::echo(ip::tcp::socket origin_socket)
                     }
                     continue;
                 }
-                co_await socketService.process(pack->getData(), pack);
+                if (pack->sequenceSize > 1) {
+                    // A fragment of a larger message
+                    std::optional<std::string> message = fragmentAssembler.feed(*pack);
+                    if (message)
+                        co_await socketService->process(*message, pack);
+                    continue;
+                }
+                co_await socketService->process(pack->getData(), pack);
                 continue;
             } catch (const std::system_error& e) {
                 const auto& errc = e.code();
+                serverEventLogger.log(Log::EventID::Disconnected, addr, errc);
                 if (errc.message() == "End of file")
-                    serverLogger.info(std::format("[{}] disconnected from the server", addr));
+                    serverLogger.info("[", addr, "] disconnected from the server");
                 else
                     serverLogger.error('[', errc.category().name(), ']', errc.message());
             } catch (const std::exception& e) {
@@ -180,8 +232,9 @@ awaitable<void> qls::Network::echo(ip::tcp::socket origin_socket)
         }
     } catch (const std::system_error& e) {
         const auto& errc = e.code();
+        serverEventLogger.log(Log::EventID::Disconnected, addr, errc);
         if (errc.message() == "End of file")
-            serverLogger.info(std::format("[{}] disconnected from the server", addr));
+            serverLogger.info("[", addr, "] disconnected from the server");
         else
             serverLogger.error('[', errc.category().name(), ']', errc.message());
     } catch (const asio::multiple_exceptions& e) {
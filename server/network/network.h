@@ -12,6 +12,7 @@
 #include <string>
 #include <memory>
 #include <memory_resource>
+#include <atomic>
 
 #include "definition.hpp"
 #include "package.h"
@@ -72,6 +73,19 @@ public:
      */
     [[nodiscard]] asio::io_context& get_io_context() noexcept;
 
+    /**
+     * @brief Sets the maximum size of a data package received from a client,
+     *        connections that send a larger one are closed.
+     *        Only connections made afterwards use the new size.
+     * @param size Maximum size in bytes, including the header
+     */
+    void setMaxFrameSize(std::size_t size);
+
+    /**
+     * @brief Gets the maximum size of a data package received from a client.
+     */
+    [[nodiscard]] std::size_t getMaxFrameSize() const noexcept;
+
 private:
     /**
      * @brief Handles echo functionality for a socket.
@@ -93,6 +107,7 @@ private:
     asio::io_context                    m_io_context; ///< IO context for ASIO.
     std::shared_ptr<asio::ssl::context> m_ssl_context_ptr; ///< Shared pointer to the SSL context.
     RateLimiter                         m_rateLimiter;
+    std::atomic<std::size_t>            m_max_frame_size = Package::default_max_frame_size; ///< Maximum size of a received data package.
 
     inline static std::pmr::synchronized_pool_resource socket_sync_pool;
 };
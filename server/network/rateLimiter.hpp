@@ -5,47 +5,64 @@
 #include <mutex>
 #include <unordered_map>
 #include <chrono>
+#include <cstdint>
+#include <algorithm>
 #include <asio.hpp>
 
-#include "spinlock_mutex.hpp"
+#include "adaptive_mutex.hpp"
+#include "coarse_clock.hpp"
 
 namespace qls
 {
 
+/**
+ * @class RateLimiter
+ * @brief Limits accepted connections per address and for the whole server.
+ *
+ * Both limits are token buckets kept as the time at which the bucket will be full
+ * again (the generic cell rate algorithm), so taking a token is one comparison and
+ * one store. The buckets of the addresses are spread over padded shards with their
+ * own lock, and the global bucket is a single atomic updated with CAS, so no
+ * token is lost when connections are accepted on several threads.
+ */
 class RateLimiter final
 {
 public:
+    /// Number of shards of the address buckets, clean() sweeps one at a time
+    static constexpr std::size_t shard_count = 64;
+
     RateLimiter(double global_capacity = 500.0, double single_capacity = 5.0):
         m_global_capacity(global_capacity),
-        m_single_capacity(single_capacity) {}
+        m_single_capacity(single_capacity),
+        m_global_full_time(0) {}
     ~RateLimiter() noexcept = default;
 
     bool allow_connection(const asio::ip::address& addr) {
         // Present timestamp
-        auto now = std::chrono::steady_clock::now();
-        // Get lock to keep thread-safe
-        std::unique_lock<spinlock_mutex> lock(m_token_buckets_mutex);
-        // Get bucket
-        auto& bucket = m_token_buckets[addr];
-        // Update tokens of bucket to check
-        // if the host associated with address sent too much connections in a short time
-        bucket.tokens = std::min(m_single_capacity.load(), 
-            bucket.tokens + (now - bucket.last_update).count() * 1e-9 * m_single_capacity);
-        bucket.last_update = now;
-        bool allow = bucket.tokens-- > 0;
-        // Unlock the lock to keep speedy of the process
-        lock.unlock();
-
-        // Get global token
-        double local_global_token = m_global_token.load();
-        // Update global tokens of bucket
-        local_global_token = std::min(m_global_capacity.load(),
-            local_global_token + (now - m_last_update.load()).count() * 1e-9 * m_global_capacity);
-        if (local_global_token <= 0)
-            allow = false;
-        m_global_token = local_global_token - 1;
-        m_last_update.store(now);
-        return allow;
+        const std::int64_t now = nowNanoseconds();
+
+        // Check if the host associated with address sent too much connections in a short time
+        {
+            const double single_capacity = m_single_capacity.load(std::memory_order_relaxed);
+            Shard& shard = m_shards[std::hash<asio::ip::address>{}(addr) % shard_count];
+            std::lock_guard<adaptive_mutex> lock(shard.mutex);
+            // A missing bucket is a full one
+            auto [iter, inserted] = shard.buckets.try_emplace(addr, now);
+            if (!takeToken(iter->second, now, single_capacity))
+                return false;
+        }
+
+        // Take a token of the global bucket, an address that is refused doesn't spend one
+        const double global_capacity = m_global_capacity.load(std::memory_order_relaxed);
+        std::int64_t full_time = m_global_full_time.load(std::memory_order_relaxed);
+        while (true) {
+            std::int64_t new_full_time = full_time;
+            if (!takeToken(new_full_time, now, global_capacity))
+                return false;
+            if (m_global_full_time.compare_exchange_weak(full_time, new_full_time,
+                    std::memory_order_relaxed))
+                return true;
+        }
     }
 
     void set_single_capacity(double single_capacity)
@@ -69,34 +86,59 @@ public:
     }
 
     /**
-     * @brief clean the buckets out of date automatically
-    */
-    asio::awaitable<void> auto_clean()
+     * @brief Drops the full buckets of the next shard, called periodically by the server timers.
+     *        A full bucket is the same as a missing one, so nothing is forgotten.
+     * @return Number of dropped buckets
+     */
+    std::size_t clean()
     {
-        using namespace std::chrono_literals;
-        asio::steady_timer timer(co_await asio::this_coro::executor);
-        while(true) {
-            timer.expires_after(30s);
-            co_await timer.async_wait(asio::use_awaitable);
-            std::lock_guard<spinlock_mutex> lock(m_token_buckets_mutex);
-            std::erase_if(m_token_buckets,
-                [](const auto& i){return std::chrono::steady_clock::now() - i.second.last_update >= 1min;});
-        }
+        Shard& shard = m_shards[m_next_clean_shard.fetch_add(1, std::memory_order_relaxed) % shard_count];
+        const std::int64_t now = nowNanoseconds();
+        std::lock_guard<adaptive_mutex> lock(shard.mutex);
+        return std::erase_if(shard.buckets,
+            [now](const auto& i){ return i.second <= now; });
     }
 
 private:
-    struct TokenBucket
+    /// Time at which the bucket of an address is full again, in nanoseconds of steady_clock
+    using TokenBucket = std::int64_t;
+
+    struct alignas(64) Shard
     {
-        double tokens = 0.0;
-        std::chrono::steady_clock::time_point last_update;
+        adaptive_mutex                                      mutex{"rate limiter"};
+        std::unordered_map<asio::ip::address, TokenBucket>  buckets;
     };
+
+    static std::int64_t nowNanoseconds() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            CoarseClock::steadyNow().time_since_epoch()).count();
+    }
+
+    /**
+     * @brief Takes a token of a bucket that refills capacity tokens per second up to capacity.
+     * @param full_time Time at which the bucket is full, updated if a token is taken
+     * @return Whether a token was left
+     */
+    static bool takeToken(std::int64_t& full_time, std::int64_t now, double capacity) noexcept
+    {
+        if (capacity <= 0)
+            return false;
+        // Each token is worth this much time, the bucket holds capacity of them
+        const auto token_time = static_cast<std::int64_t>(1e9 / capacity);
+        const std::int64_t new_full_time = std::max(full_time, now) + token_time;
+        if (new_full_time - now > static_cast<std::int64_t>(std::max(capacity, 1.0) * token_time))
+            return false;
+        full_time = new_full_time;
+        return true;
+    }
+
     std::atomic<double>             m_global_capacity;
-    std::atomic<double>             m_global_token;
     std::atomic<double>             m_single_capacity;
-    std::atomic<std::chrono::steady_clock::time_point> m_last_update;
-    std::unordered_map<asio::ip::address, TokenBucket>
-                                    m_token_buckets;
-    mutable spinlock_mutex          m_token_buckets_mutex;
+    alignas(64) std::atomic<std::int64_t>
+                                    m_global_full_time; ///< Time at which the global bucket is full
+    std::atomic<std::size_t>        m_next_clean_shard = 0;
+    Shard                           m_shards[shard_count];
 };
 
 } // namespace qls
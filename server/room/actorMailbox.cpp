@@ -0,0 +1,133 @@
+#include "actorMailbox.h"
+
+#include <thread>
+
+namespace qls
+{
+
+struct ActorMailboxNode
+{
+    std::atomic<ActorMailboxNode*>  next = nullptr;
+    ActorMailbox::Task              task;
+};
+
+struct ActorMailboxState: std::enable_shared_from_this<ActorMailboxState>
+{
+    ActorMailboxState(asio::any_io_executor mailbox_executor):
+        executor(std::move(mailbox_executor)),
+        head(&stub),
+        tail(&stub) {}
+
+    ~ActorMailboxState() noexcept
+    {
+        while (ActorMailboxNode* node = pop())
+            delete node;
+    }
+
+    /**
+     * @brief Appends a node, may be called by any thread.
+     */
+    void push(ActorMailboxNode* node) noexcept
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        ActorMailboxNode* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    /**
+     * @brief Takes the oldest node, only called by the drain.
+     * @return The node, nullptr if the queue is empty or a push isn't linked yet
+     */
+    ActorMailboxNode* pop() noexcept
+    {
+        ActorMailboxNode* node = tail;
+        ActorMailboxNode* next = node->next.load(std::memory_order_acquire);
+        if (node == &stub) {
+            if (!next)
+                return nullptr;
+            tail = next;
+            node = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail = next;
+            return node;
+        }
+        if (node != head.load(std::memory_order_acquire))
+            return nullptr;
+        // The last node can only be taken once the stub is behind it
+        push(&stub);
+        next = node->next.load(std::memory_order_acquire);
+        if (next) {
+            tail = next;
+            return node;
+        }
+        return nullptr;
+    }
+
+    void drain()
+    {
+        const ActorMailboxState* outer = tl_running;
+        tl_running = this;
+        for (std::size_t count = 0; count < ActorMailbox::drain_budget; ++count) {
+            // Every pending task has been pushed, a null node is a push that isn't linked yet
+            ActorMailboxNode* node = pop();
+            while (!node) {
+                std::this_thread::yield();
+                node = pop();
+            }
+            if (!closed.load(std::memory_order_acquire)) {
+                try {
+                    node->task();
+                } catch (...) {}
+            }
+            delete node;
+            if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                tl_running = outer;
+                return;
+            }
+        }
+        tl_running = outer;
+        asio::post(executor, [self = shared_from_this()]() { self->drain(); });
+    }
+
+    asio::any_io_executor                       executor;
+    alignas(64) std::atomic<ActorMailboxNode*>  head;   ///< Last pushed node
+    alignas(64) ActorMailboxNode*               tail;   ///< Next node to take, only used by the drain
+    ActorMailboxNode                            stub;
+    std::atomic<std::size_t>                    pending = 0;
+    std::atomic<bool>                           closed = false;
+
+    inline static thread_local const ActorMailboxState* tl_running = nullptr;
+};
+
+ActorMailbox::ActorMailbox(asio::any_io_executor executor):
+    m_state(std::make_shared<ActorMailboxState>(std::move(executor))) {}
+
+ActorMailbox::~ActorMailbox() noexcept
+{
+    // A drain that is queued or running keeps the state, it drops the rest of the tasks
+    m_state->closed.store(true, std::memory_order_release);
+}
+
+void ActorMailbox::post(Task task)
+{
+    auto* node = new ActorMailboxNode;
+    node->task = std::move(task);
+    m_state->push(node);
+    // The poster that finds the mailbox idle starts a drain
+    if (m_state->pending.fetch_add(1, std::memory_order_acq_rel) == 0)
+        asio::post(m_state->executor, [state = m_state]() { state->drain(); });
+}
+
+bool ActorMailbox::isRunningInThisThread() const noexcept
+{
+    return ActorMailboxState::tl_running == m_state.get();
+}
+
+std::size_t ActorMailbox::getPendingCount() const noexcept
+{
+    return m_state->pending.load(std::memory_order_acquire);
+}
+
+} // namespace qls
@@ -0,0 +1,66 @@
+#ifndef ACTOR_MAILBOX_H
+#define ACTOR_MAILBOX_H
+
+#include <asio.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace qls
+{
+
+struct ActorMailboxState;
+
+/**
+ * @class ActorMailbox
+ * @brief Runs the tasks posted to it one at a time, in the order they were posted.
+ *
+ * Tasks are pushed onto a lock-free intrusive queue. The poster that finds the
+ * mailbox idle posts a drain to the executor, which runs up to drain_budget tasks
+ * and posts itself again if more are left, so a busy mailbox doesn't keep an io
+ * thread to itself. Only one drain runs at a time, so the tasks of a mailbox never
+ * overlap and the state they share needs no lock.
+ */
+class ActorMailbox final
+{
+public:
+    using Task = std::move_only_function<void()>;
+
+    /// Tasks run by one drain before it yields the thread
+    static constexpr std::size_t drain_budget = 64;
+
+    ActorMailbox(asio::any_io_executor executor);
+    ActorMailbox(const ActorMailbox&) = delete;
+    ActorMailbox(ActorMailbox&&) = delete;
+
+    /**
+     * @brief Drops the tasks that haven't run, a task that is running finishes.
+     */
+    ~ActorMailbox() noexcept;
+
+    ActorMailbox& operator=(const ActorMailbox&) = delete;
+    ActorMailbox& operator=(ActorMailbox&&) = delete;
+
+    /**
+     * @brief Queues a task, it runs after the tasks posted before it.
+     *        An exception thrown by the task is dropped.
+     */
+    void post(Task task);
+
+    /**
+     * @brief Checks whether the calling thread is running a task of this mailbox.
+     */
+    [[nodiscard]] bool isRunningInThisThread() const noexcept;
+
+    /**
+     * @brief Gets the number of tasks that haven't finished yet.
+     */
+    [[nodiscard]] std::size_t getPendingCount() const noexcept;
+
+private:
+    std::shared_ptr<ActorMailboxState> m_state;
+};
+
+} // namespace qls
+
+#endif // !ACTOR_MAILBOX_H
@@ -0,0 +1,238 @@
+#include "groupMemberTable.h"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <stdexcept>
+
+namespace qls
+{
+
+// NicknamePool
+NicknamePool::~NicknamePool() noexcept
+{
+    for (auto& chunk: m_chunks)
+        delete[] chunk.load(std::memory_order_relaxed);
+}
+
+NicknamePool::Ref NicknamePool::intern(std::string_view nickname)
+{
+    nickname = nickname.substr(0, chunk_size);
+    auto itor = m_index.find(nickname);
+    if (itor != m_index.cend())
+        return itor->second;
+
+    // A nickname never spans two chunks
+    std::size_t offset = m_used;
+    if (offset % chunk_size + nickname.size() > chunk_size)
+        offset = (offset / chunk_size + 1) * chunk_size;
+    std::size_t chunk_index = offset / chunk_size;
+    if (chunk_index >= max_chunks)
+        throw std::length_error("the nickname pool is full");
+
+    char* chunk = m_chunks[chunk_index].load(std::memory_order_relaxed);
+    if (!chunk) {
+        chunk = new char[chunk_size];
+        m_chunks[chunk_index].store(chunk, std::memory_order_release);
+    }
+    char* data = chunk + offset % chunk_size;
+    std::copy(nickname.cbegin(), nickname.cend(), data);
+    m_used = offset + nickname.size();
+
+    Ref ref{static_cast<std::uint32_t>(offset), static_cast<std::uint32_t>(nickname.size())};
+    m_index.emplace(std::string_view(data, nickname.size()), ref);
+    return ref;
+}
+
+std::string_view NicknamePool::get(Ref ref) const noexcept
+{
+    if (ref.length == 0)
+        return {};
+    const char* chunk = m_chunks[ref.offset / chunk_size].load(std::memory_order_acquire);
+    return {chunk + ref.offset % chunk_size, ref.length};
+}
+
+std::size_t NicknamePool::getUsedBytes() const noexcept
+{
+    return m_used;
+}
+
+// GroupMemberTable
+/**
+ * @brief Spreads the user ids, which are mostly consecutive, over the index.
+ */
+static std::size_t hashUserID(UserID user_id) noexcept
+{
+    return static_cast<std::size_t>(
+        (static_cast<std::uint64_t>(user_id.getOriginValue()) * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+GroupMemberTable::GroupMemberTable():
+    GroupMemberTable(min_capacity, std::make_shared<NicknamePool>()) {}
+
+GroupMemberTable::GroupMemberTable(std::span<const Member> members):
+    GroupMemberTable(std::max(min_capacity, members.size() * 2), std::make_shared<NicknamePool>())
+{
+    for (const Member& member: members) {
+        std::size_t entry = probe(member.user_id);
+        if (m_index[entry].load(std::memory_order_relaxed) != 0)
+            continue;
+        append(entry, member.user_id, m_pool->intern(member.nickname),
+            member.level, member.permission, member.mute_deadline);
+    }
+}
+
+GroupMemberTable::GroupMemberTable(std::size_t capacity, std::shared_ptr<NicknamePool> pool):
+    m_capacity(capacity),
+    m_user_ids(std::make_unique<UserID[]>(capacity)),
+    m_nicknames(std::make_unique<NicknamePool::Ref[]>(capacity)),
+    m_levels(std::make_unique<std::atomic<std::uint8_t>[]>(capacity)),
+    m_permissions(std::make_unique<std::atomic<std::uint8_t>[]>(capacity)),
+    m_mute_deadlines(std::make_unique<std::atomic<long long>[]>(capacity)),
+    m_present(std::make_unique<std::atomic<bool>[]>(capacity)),
+    // At most half of the index is used, so a probe ends soon at an empty entry
+    m_index_mask(std::bit_ceil(capacity * 2) - 1),
+    m_index(std::make_unique<std::atomic<std::uint32_t>[]>(m_index_mask + 1)),
+    m_pool(std::move(pool))
+{
+    if (capacity >= std::numeric_limits<std::uint32_t>::max())
+        throw std::length_error("too many members");
+}
+
+bool GroupMemberTable::add(UserID user_id, std::string_view nickname, PermissionType permission)
+{
+    std::size_t entry = probe(user_id);
+    std::uint32_t slot = m_index[entry].load(std::memory_order_relaxed);
+    if (slot != 0 && m_present[slot - 1].load(std::memory_order_relaxed))
+        return false;
+    if (isFull())
+        throw std::length_error("the member table is full");
+
+    append(entry, user_id, m_pool->intern(nickname), 1, permission, 0);
+    return true;
+}
+
+bool GroupMemberTable::remove(UserID user_id) noexcept
+{
+    std::size_t index = find(user_id);
+    if (index == npos)
+        return false;
+
+    m_present[index].store(false, std::memory_order_release);
+    m_size.store(m_size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    m_nickname_bytes -= m_nicknames[index].length;
+    return true;
+}
+
+bool GroupMemberTable::isFull() const noexcept
+{
+    return m_slot_count.load(std::memory_order_relaxed) == m_capacity;
+}
+
+std::shared_ptr<GroupMemberTable> GroupMemberTable::grow() const
+{
+    // Start a new pool once most of the old one belongs to members that left,
+    // the tables that still use the old one keep it alive
+    bool compact = m_pool->getUsedBytes() > 2 * m_nickname_bytes + NicknamePool::chunk_size;
+    std::shared_ptr<GroupMemberTable> table(new GroupMemberTable(
+        std::max(min_capacity, size() * 2), compact ? std::make_shared<NicknamePool>() : m_pool));
+
+    forEach([this, &table, compact](std::size_t index, UserID user_id) {
+        table->append(table->probe(user_id), user_id,
+            compact ? table->m_pool->intern(getNickname(index)) : m_nicknames[index],
+            getLevel(index), getPermission(index), getMuteDeadline(index));
+    });
+    return table;
+}
+
+std::size_t GroupMemberTable::probe(UserID user_id) const noexcept
+{
+    for (std::size_t entry = hashUserID(user_id) & m_index_mask;; entry = (entry + 1) & m_index_mask) {
+        std::uint32_t slot = m_index[entry].load(std::memory_order_acquire);
+        if (slot == 0 || m_user_ids[slot - 1] == user_id)
+            return entry;
+    }
+}
+
+void GroupMemberTable::append(std::size_t entry, UserID user_id, NicknamePool::Ref nickname,
+    int level, PermissionType permission, long long mute_deadline)
+{
+    std::size_t slot = m_slot_count.load(std::memory_order_relaxed);
+    m_user_ids[slot] = user_id;
+    m_nicknames[slot] = nickname;
+    m_levels[slot].store(static_cast<std::uint8_t>(level), std::memory_order_relaxed);
+    m_permissions[slot].store(static_cast<std::uint8_t>(permission), std::memory_order_relaxed);
+    m_mute_deadlines[slot].store(mute_deadline, std::memory_order_relaxed);
+    m_present[slot].store(true, std::memory_order_relaxed);
+    m_nickname_bytes += nickname.length;
+    m_size.store(m_size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    // The slot is filled before readers can reach it
+    m_slot_count.store(slot + 1, std::memory_order_release);
+    m_index[entry].store(static_cast<std::uint32_t>(slot + 1), std::memory_order_release);
+}
+
+std::size_t GroupMemberTable::size() const noexcept
+{
+    return m_size.load(std::memory_order_relaxed);
+}
+
+bool GroupMemberTable::contains(UserID user_id) const noexcept
+{
+    return find(user_id) != npos;
+}
+
+std::size_t GroupMemberTable::find(UserID user_id) const noexcept
+{
+    std::uint32_t slot = m_index[probe(user_id)].load(std::memory_order_acquire);
+    if (slot == 0 || !m_present[slot - 1].load(std::memory_order_acquire))
+        return npos;
+    return slot - 1;
+}
+
+std::string_view GroupMemberTable::getNickname(std::size_t index) const noexcept
+{
+    return m_pool->get(m_nicknames[index]);
+}
+
+int GroupMemberTable::getLevel(std::size_t index) const noexcept
+{
+    return m_levels[index].load(std::memory_order_relaxed);
+}
+
+void GroupMemberTable::setLevel(std::size_t index, int level) const noexcept
+{
+    m_levels[index].store(static_cast<std::uint8_t>(level), std::memory_order_relaxed);
+}
+
+PermissionType GroupMemberTable::getPermission(std::size_t index) const noexcept
+{
+    return static_cast<PermissionType>(m_permissions[index].load(std::memory_order_relaxed));
+}
+
+void GroupMemberTable::setPermission(std::size_t index, PermissionType permission) const noexcept
+{
+    m_permissions[index].store(static_cast<std::uint8_t>(permission), std::memory_order_relaxed);
+}
+
+long long GroupMemberTable::getMuteDeadline(std::size_t index) const noexcept
+{
+    return m_mute_deadlines[index].load(std::memory_order_relaxed);
+}
+
+void GroupMemberTable::setMuteDeadline(std::size_t index, long long deadline) const noexcept
+{
+    m_mute_deadlines[index].store(deadline, std::memory_order_relaxed);
+}
+
+std::vector<UserID> GroupMemberTable::getUserIDsWith(PermissionType permission) const
+{
+    std::vector<UserID> user_ids;
+    forEach([this, permission, &user_ids](std::size_t index, UserID user_id) {
+        if (getPermission(index) == permission)
+            user_ids.push_back(user_id);
+    });
+    return user_ids;
+}
+
+} // namespace qls
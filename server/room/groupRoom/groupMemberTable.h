@@ -0,0 +1,212 @@
+#ifndef GROUP_MEMBER_TABLE_H
+#define GROUP_MEMBER_TABLE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "userid.hpp"
+#include "groupPermission.h"
+
+namespace qls
+{
+
+/**
+ * @class NicknamePool
+ * @brief Append-only storage of interned nicknames.
+ *
+ * The nicknames are copied into chunks that never move, so a reference taken
+ * from the pool stays valid for its life. Only one thread may intern at a time,
+ * any thread may read the nicknames it got a reference to.
+ */
+class NicknamePool final
+{
+public:
+    /// Position of an interned nickname, 8 bytes instead of a std::string
+    struct Ref
+    {
+        std::uint32_t offset = 0;
+        std::uint32_t length = 0;
+    };
+
+    static constexpr std::size_t chunk_size = 64 * 1024;
+    static constexpr std::size_t max_chunks = 1024;
+
+    NicknamePool() = default;
+    ~NicknamePool() noexcept;
+
+    NicknamePool(const NicknamePool&) = delete;
+    NicknamePool(NicknamePool&&) = delete;
+
+    NicknamePool& operator=(const NicknamePool&) = delete;
+    NicknamePool& operator=(NicknamePool&&) = delete;
+
+    /**
+     * @brief Interns a nickname, an equal one that is already stored is reused.
+     *        Nicknames longer than a chunk are cut.
+     */
+    Ref intern(std::string_view nickname);
+
+    [[nodiscard]] std::string_view get(Ref ref) const noexcept;
+
+    /**
+     * @brief Gets the bytes used by the stored nicknames.
+     */
+    [[nodiscard]] std::size_t getUsedBytes() const noexcept;
+
+private:
+    std::array<std::atomic<char*>, max_chunks>  m_chunks{};
+    std::size_t                                 m_used = 0;     ///< Only used by the interning thread
+    std::unordered_map<std::string_view, Ref>   m_index;        ///< Only used by the interning thread
+};
+
+/**
+ * @class GroupMemberTable
+ * @brief Members of a group stored column by column.
+ *
+ * Every member takes a slot of each column, 27 bytes plus its nickname, which is
+ * interned in a NicknamePool shared with the tables grown from this one, and a hash
+ * index of the user ids finds its slot. The columns have spare slots, so the owner of
+ * the table adds a member by filling the next slot and removes one by clearing its
+ * flag, while others read the table without a lock. Only a full table is replaced,
+ * grow() copies the members into one with room for as many again and drops the slots
+ * of the removed members, so a table that was published is never resized under its
+ * readers. Only one thread may change a table at a time.
+ */
+class GroupMemberTable final
+{
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+    static constexpr std::size_t min_capacity = 8;
+
+    /// Member of a group that is loaded
+    struct Member
+    {
+        UserID              user_id;
+        std::string_view    nickname;
+        PermissionType      permission = PermissionType::Default;
+        int                 level = 1;
+        long long           mute_deadline = 0;
+    };
+
+    GroupMemberTable();
+
+    /**
+     * @brief Makes the table of a group that is loaded, a user listed twice is added once.
+     */
+    explicit GroupMemberTable(std::span<const Member> members);
+
+    ~GroupMemberTable() noexcept = default;
+
+    GroupMemberTable(const GroupMemberTable&) = delete;
+    GroupMemberTable(GroupMemberTable&&) = delete;
+
+    GroupMemberTable& operator=(const GroupMemberTable&) = delete;
+    GroupMemberTable& operator=(GroupMemberTable&&) = delete;
+
+    /**
+     * @brief Adds a member in the next free slot, the table must not be full.
+     * @return false if the user is already a member
+     */
+    bool add(UserID user_id, std::string_view nickname,
+        PermissionType permission = PermissionType::Default);
+
+    /**
+     * @brief Removes a member, its slot is dropped when the table grows.
+     * @return false if the user isn't a member
+     */
+    bool remove(UserID user_id) noexcept;
+
+    /**
+     * @brief Checks whether every slot is used, a full table has to grow to add a member.
+     */
+    [[nodiscard]] bool isFull() const noexcept;
+
+    /**
+     * @brief Makes a copy of the members with room for as many again.
+     */
+    [[nodiscard]] std::shared_ptr<GroupMemberTable> grow() const;
+
+    [[nodiscard]] std::size_t size() const noexcept;
+    [[nodiscard]] bool contains(UserID user_id) const noexcept;
+
+    /**
+     * @brief Gets the index of a member in the columns.
+     * @return The index, npos if the user isn't a member
+     */
+    [[nodiscard]] std::size_t find(UserID user_id) const noexcept;
+
+    /**
+     * @brief Calls function(index, user_id) for every member, in the order they joined.
+     */
+    template<class Function>
+    void forEach(Function&& function) const
+    {
+        std::size_t slot_count = m_slot_count.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < slot_count; ++i) {
+            if (m_present[i].load(std::memory_order_acquire))
+                function(i, m_user_ids[i]);
+        }
+    }
+
+    [[nodiscard]] std::string_view getNickname(std::size_t index) const noexcept;
+
+    [[nodiscard]] int getLevel(std::size_t index) const noexcept;
+    void setLevel(std::size_t index, int level) const noexcept;
+
+    [[nodiscard]] PermissionType getPermission(std::size_t index) const noexcept;
+    void setPermission(std::size_t index, PermissionType permission) const noexcept;
+
+    /**
+     * @brief Gets the end of the mute of a member.
+     * @return Milliseconds since the epoch of utc_clock, 0 if the member was never muted
+     */
+    [[nodiscard]] long long getMuteDeadline(std::size_t index) const noexcept;
+    void setMuteDeadline(std::size_t index, long long deadline) const noexcept;
+
+    /**
+     * @brief Gets the members that have a permission.
+     */
+    [[nodiscard]] std::vector<UserID> getUserIDsWith(PermissionType permission) const;
+
+private:
+    GroupMemberTable(std::size_t capacity, std::shared_ptr<NicknamePool> pool);
+
+    /**
+     * @brief Gets the entry of the index that holds the slot of a user,
+     *        or the empty entry the slot would be put in.
+     */
+    [[nodiscard]] std::size_t probe(UserID user_id) const noexcept;
+
+    /**
+     * @brief Fills the next slot and publishes it at an entry of the index.
+     */
+    void append(std::size_t entry, UserID user_id, NicknamePool::Ref nickname,
+        int level, PermissionType permission, long long mute_deadline);
+
+    const std::size_t                               m_capacity;
+    std::atomic<std::size_t>                        m_slot_count = 0;   ///< Filled slots, removed members keep theirs
+    std::atomic<std::size_t>                        m_size = 0;
+    std::unique_ptr<UserID[]>                       m_user_ids;
+    std::unique_ptr<NicknamePool::Ref[]>            m_nicknames;
+    std::unique_ptr<std::atomic<std::uint8_t>[]>    m_levels;
+    std::unique_ptr<std::atomic<std::uint8_t>[]>    m_permissions;
+    std::unique_ptr<std::atomic<long long>[]>       m_mute_deadlines;
+    std::unique_ptr<std::atomic<bool>[]>            m_present;          ///< Cleared when the member leaves
+    const std::size_t                               m_index_mask;
+    /// Open addressing by user id, each entry is the slot + 1 of a user and 0 if it's empty.
+    /// Entries are never cleared, a user who joins again gets its entry pointed to the new slot
+    std::unique_ptr<std::atomic<std::uint32_t>[]>   m_index;
+    std::shared_ptr<NicknamePool>                   m_pool;
+    std::size_t                                     m_nickname_bytes = 0;   ///< Bytes of the nicknames of the members
+};
+
+} // namespace qls
+
+#endif // !GROUP_MEMBER_TABLE_H
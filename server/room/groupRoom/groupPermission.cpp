@@ -1,8 +1,6 @@
 #include "groupPermission.h"
 
-#include <algorithm>
 #include <stdexcept>
-#include <mutex>
 #include <system_error>
 
 #include "definition.hpp"
@@ -10,141 +8,128 @@
 
 namespace qls
 {
-    
-void GroupPermission::modifyPermission(std::string_view permissionName, PermissionType type)
+
+static constexpr std::array<std::string_view, static_cast<std::size_t>(Permission::Count)>
+    permission_names = {
+        "send_message",
+        "send_tip_message",
+        "mute_user",
+        "unmute_user",
+        "kick_user",
+        "add_operator",
+        "remove_operator"
+    };
+
+GroupPermission::GroupPermission()
 {
-    std::lock_guard<std::shared_mutex> lg(m_permission_map_mutex);
-    m_permission_map[std::string(permissionName)] = type;
+    // 默认权限
+    const Mask default_mask = getBit(Permission::SendMessage);
+    const Mask operator_mask = default_mask |
+        getBit(Permission::SendTipMessage) |
+        getBit(Permission::MuteUser) |
+        getBit(Permission::UnmuteUser) |
+        getBit(Permission::KickUser);
+    const Mask administrator_mask = operator_mask |
+        getBit(Permission::AddOperator) |
+        getBit(Permission::RemoveOperator);
+
+    m_masks[static_cast<std::size_t>(PermissionType::Default)] = default_mask;
+    m_masks[static_cast<std::size_t>(PermissionType::Operator)] = operator_mask;
+    m_masks[static_cast<std::size_t>(PermissionType::Administrator)] = administrator_mask;
 }
 
-void GroupPermission::removePermission(std::string_view permissionName)
+void GroupPermission::modifyPermission(Permission permission, PermissionType type)
 {
-    std::lock_guard<std::shared_mutex> lg(m_permission_map_mutex);
-
-    // 是否有此权限
-    auto itor = m_permission_map.find(permissionName);
-    if (itor == m_permission_map.cend())
-        throw std::system_error(make_error_code(qls_errc::no_permission), "no permission: " + std::string(permissionName));
-
-    m_permission_map.erase(itor);
+    std::lock_guard<std::mutex> lg(m_modify_mutex);
+    for (std::size_t i = 0; i < permission_type_count; ++i) {
+        if (i >= static_cast<std::size_t>(type))
+            m_masks[i].fetch_or(getBit(permission), std::memory_order_relaxed);
+        else
+            m_masks[i].fetch_and(~getBit(permission), std::memory_order_relaxed);
+    }
 }
 
-PermissionType GroupPermission::getPermissionType(std::string_view permissionName) const
+void GroupPermission::removePermission(Permission permission)
 {
-    std::shared_lock<std::shared_mutex> lock(m_permission_map_mutex);
-
-    // 是否有此权限
-    auto itor = m_permission_map.find(permissionName);
-    if (itor == m_permission_map.cend())
-        throw std::system_error(make_error_code(qls_errc::no_permission), "no permission: " + std::string(permissionName));
-
-    return itor->second;
+    std::lock_guard<std::mutex> lg(m_modify_mutex);
+    for (auto& mask: m_masks)
+        mask.fetch_and(~getBit(permission), std::memory_order_relaxed);
 }
 
-std::unordered_map<std::string, PermissionType, string_hash, std::equal_to<>>
-    GroupPermission::getPermissionList() const
+std::optional<PermissionType> GroupPermission::getPermissionType(Permission permission) const noexcept
 {
-    std::shared_lock<std::shared_mutex> lock(m_permission_map_mutex);
-    return m_permission_map;
+    for (std::size_t i = 0; i < permission_type_count; ++i) {
+        if (m_masks[i].load(std::memory_order_relaxed) & getBit(permission))
+            return static_cast<PermissionType>(i);
+    }
+    return std::nullopt;
 }
 
-void GroupPermission::modifyUserPermission(UserID user_id, PermissionType type)
+void GroupPermission::modifyPermission(std::string_view permissionName, PermissionType type)
 {
-    std::lock_guard<std::shared_mutex> lg(m_user_permission_map_mutex);
-    m_user_permission_map[user_id] = type;
+    modifyPermission(getKnownPermission(permissionName), type);
 }
 
-void GroupPermission::removeUser(UserID user_id)
+void GroupPermission::removePermission(std::string_view permissionName)
 {
-    std::lock_guard<std::shared_mutex> lg(m_user_permission_map_mutex);
+    Permission permission = getKnownPermission(permissionName);
 
-    // 是否有此user
-    auto itor = m_user_permission_map.find(user_id);
-    if (itor == m_user_permission_map.cend())
-        throw std::system_error(make_error_code(qls_errc::user_not_existed), "no user: " + std::to_string(user_id));
+    // 是否有此权限
+    if (!getPermissionType(permission))
+        throw std::system_error(make_error_code(qls_errc::no_permission), "no permission: " + std::string(permissionName));
 
-    m_user_permission_map.erase(itor);
+    removePermission(permission);
 }
 
-bool GroupPermission::userHasPermission(UserID user_id, std::string_view permissionName) const
+PermissionType GroupPermission::getPermissionType(std::string_view permissionName) const
 {
-    std::shared_lock<std::shared_mutex> lock1(m_permission_map_mutex, std::defer_lock);
-    std::shared_lock<std::shared_mutex> lock2(m_user_permission_map_mutex, std::defer_lock);
-    std::lock(lock1, lock2);
-
-    // 是否有此user
-    auto itor = m_user_permission_map.find(user_id);
-    if (itor == m_user_permission_map.cend())
-        throw std::system_error(make_error_code(qls_errc::user_not_existed), "no user: " + std::to_string(user_id));
-
     // 是否有此权限
-    auto itor2 = m_permission_map.find(permissionName);
-    if (itor2 == m_permission_map.cend())
+    auto type = getPermissionType(getKnownPermission(permissionName));
+    if (!type)
         throw std::system_error(make_error_code(qls_errc::no_permission), "no permission: " + std::string(permissionName));
 
-    // 返回权限
-    return itor->second >= itor2->second;
+    return *type;
 }
 
-PermissionType GroupPermission::getUserPermissionType(UserID user_id) const
+std::unordered_map<std::string, PermissionType, string_hash, std::equal_to<>>
+    GroupPermission::getPermissionList() const
 {
-    std::shared_lock<std::shared_mutex> lock(m_user_permission_map_mutex);
-
-    // 是否有此user
-    auto itor = m_user_permission_map.find(user_id);
-    if (itor == m_user_permission_map.cend())
-        throw std::system_error(make_error_code(qls_errc::user_not_existed), "no user: " + std::to_string(user_id));
-
-    return itor->second;
+    std::unordered_map<std::string, PermissionType, string_hash, std::equal_to<>> permission_list;
+    for (std::size_t i = 0; i < permission_names.size(); ++i) {
+        auto type = getPermissionType(static_cast<Permission>(i));
+        if (type)
+            permission_list.emplace(permission_names[i], *type);
+    }
+    return permission_list;
 }
 
-std::unordered_map<UserID, PermissionType>
-    GroupPermission::getUserPermissionList() const
+bool GroupPermission::typeHasPermission(PermissionType type, std::string_view permissionName) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_user_permission_map_mutex);
-    return m_user_permission_map;
+    return hasPermission(type, getKnownPermission(permissionName));
 }
 
-std::vector<UserID> GroupPermission::getDefaultUserList() const
+std::string_view GroupPermission::getPermissionName(Permission permission) noexcept
 {
-    std::shared_lock<std::shared_mutex> lock(m_user_permission_map_mutex);
-
-    std::vector<UserID> return_vector;
-    std::for_each(m_user_permission_map.cbegin(), m_user_permission_map.cend(),
-        [&return_vector](const std::pair<UserID, PermissionType>& p) {
-            if (p.second == PermissionType::Default)
-                return_vector.push_back(p.first);
-        });
-
-    return return_vector;
+    if (permission >= Permission::Count)
+        return {};
+    return permission_names[static_cast<std::size_t>(permission)];
 }
 
-std::vector<UserID> GroupPermission::getOperatorList() const
+std::optional<Permission> GroupPermission::getPermission(std::string_view permissionName) noexcept
 {
-    std::shared_lock<std::shared_mutex> lock(m_user_permission_map_mutex);
-
-    std::vector<UserID> return_vector;
-    std::for_each(m_user_permission_map.cbegin(), m_user_permission_map.cend(),
-        [&return_vector](const std::pair<UserID, PermissionType>& p) {
-            if (p.second == PermissionType::Operator)
-                return_vector.push_back(p.first);
-        });
-
-    return return_vector;
+    for (std::size_t i = 0; i < permission_names.size(); ++i) {
+        if (permission_names[i] == permissionName)
+            return static_cast<Permission>(i);
+    }
+    return std::nullopt;
 }
 
-std::vector<UserID> GroupPermission::getAdministratorList() const
+Permission GroupPermission::getKnownPermission(std::string_view permissionName)
 {
-    std::shared_lock<std::shared_mutex> lock(m_user_permission_map_mutex);
-
-    std::vector<UserID> return_vector;
-    std::for_each(m_user_permission_map.cbegin(), m_user_permission_map.cend(),
-        [&return_vector](const std::pair<UserID, PermissionType>& p) {
-            if (p.second == PermissionType::Administrator)
-                return_vector.push_back(p.first);
-        });
-
-    return return_vector;
+    auto permission = getPermission(permissionName);
+    if (!permission)
+        throw std::system_error(make_error_code(qls_errc::no_permission), "no permission: " + std::string(permissionName));
+    return *permission;
 }
 
 } // namespace qls
@@ -1,13 +1,16 @@
 #ifndef GROUP_PERMISSION_H
 #define GROUP_PERMISSION_H
 
-#include <unordered_map>
-#include <shared_mutex>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
 #include <string>
-#include <vector>
+#include <string_view>
+#include <unordered_map>
 
 #include "definition.hpp"
-#include "userid.hpp"
 
 namespace qls
 {
@@ -22,15 +25,78 @@ enum class PermissionType
     Administrator ///< Administrator permission level
 };
 
+/**
+ * @brief Actions of a group that need a permission.
+ */
+enum class Permission: std::uint8_t
+{
+    SendMessage = 0,    ///< Send a message to the group
+    SendTipMessage,     ///< Send a tip to the group or to a member
+    MuteUser,           ///< Mute a member with a lower permission type
+    UnmuteUser,         ///< Unmute a member with a lower permission type
+    KickUser,           ///< Kick a member with a lower permission type
+    AddOperator,        ///< Turn a default member into an operator
+    RemoveOperator,     ///< Turn an operator into a default member
+    Count               ///< Number of permissions, not a permission
+};
+
 /**
  * @brief Class representing group permissions.
+ *
+ * Each permission type holds a bitset of the permissions it's granted, so a check
+ * is one relaxed load and a mask. The names of the permissions only map to the
+ * Permission enum, for tools that change them by name.
  */
 class GroupPermission final
 {
 public:
-    GroupPermission() = default;
+    using Mask = std::uint64_t;
+
+    static constexpr std::size_t permission_type_count = 3;
+    static_assert(static_cast<std::size_t>(Permission::Count) <= sizeof(Mask) * 8);
+
+    GroupPermission();
     ~GroupPermission() noexcept = default;
 
+    GroupPermission(const GroupPermission&) = delete;
+    GroupPermission(GroupPermission&&) = delete;
+
+    GroupPermission& operator=(const GroupPermission&) = delete;
+    GroupPermission& operator=(GroupPermission&&) = delete;
+
+    /**
+     * @brief Checks if a permission type is granted a permission.
+     * @param type Permission type of the user.
+     * @param permission Permission to check.
+     * @return true if the type has the permission, false otherwise.
+     */
+    bool hasPermission(PermissionType type, Permission permission) const noexcept
+    {
+        return (m_masks[static_cast<std::size_t>(type)].load(std::memory_order_relaxed) &
+            getBit(permission)) != 0;
+    }
+
+    /**
+     * @brief Grants a permission to a permission type and the ones above it,
+     *        and takes it from the ones below.
+     * @param permission Permission to modify.
+     * @param type Lowest permission type that is granted the permission.
+     */
+    void modifyPermission(Permission permission, PermissionType type = PermissionType::Default);
+
+    /**
+     * @brief Takes a permission from every permission type.
+     * @param permission Permission to remove.
+     */
+    void removePermission(Permission permission);
+
+    /**
+     * @brief Retrieves the lowest permission type that is granted a permission.
+     * @param permission Permission to look up.
+     * @return The permission type, std::nullopt if no type has the permission.
+     */
+    std::optional<PermissionType> getPermissionType(Permission permission) const noexcept;
+
     /**
      * @brief Modifies the permission type for a specific permission.
      * @param permissionName Name of the permission to modify.
@@ -58,65 +124,38 @@ public:
     std::unordered_map<std::string, PermissionType, string_hash, std::equal_to<>> getPermissionList() const;
 
     /**
-     * @brief Modifies the permission type for a specific user.
-     * @param user_id ID of the user.
-     * @param type New permission type.
-     */
-    void modifyUserPermission(UserID user_id, PermissionType type = PermissionType::Default);
-
-    /**
-     * @brief Removes a user from the user permission list.
-     * @param user_id ID of the user to remove.
-     */
-    void removeUser(UserID user_id);
-
-    /**
-     * @brief Checks if a user has a specific permission.
-     * @param user_id ID of the user.
+     * @brief Checks if a permission type is granted a permission.
+     * @param type Permission type of the user.
      * @param permissionName Name of the permission.
-     * @return true if user has the permission, false otherwise.
+     * @return true if the type has the permission, false otherwise.
      */
-    bool userHasPermission(UserID user_id, std::string_view permissionName) const;
+    bool typeHasPermission(PermissionType type, std::string_view permissionName) const;
 
     /**
-     * @brief Retrieves the permission type for a specific user.
-     * @param user_id ID of the user.
-     * @return PermissionType Type of permission for the user.
+     * @brief Gets the name of a permission.
      */
-    PermissionType getUserPermissionType(UserID user_id) const;
+    static std::string_view getPermissionName(Permission permission) noexcept;
 
     /**
-     * @brief Retrieves the entire user permission list.
-     * @return std::unordered_map<UserID, PermissionType> Map of users and their permission types.
+     * @brief Gets the permission of a name.
+     * @return The permission, std::nullopt if no permission has the name.
      */
-    std::unordered_map<UserID, PermissionType> getUserPermissionList() const;
+    static std::optional<Permission> getPermission(std::string_view permissionName) noexcept;
 
-    /**
-     * @brief Retrieves a list of users with default permissions.
-     * @return std::vector<UserID> List of user IDs.
-     */
-    std::vector<UserID> getDefaultUserList() const;
-
-    /**
-     * @brief Retrieves a list of users with operator permissions.
-     * @return std::vector<UserID> List of user IDs.
-     */
-    std::vector<UserID> getOperatorList() const;
+private:
+    static constexpr Mask getBit(Permission permission) noexcept
+    {
+        return Mask(1) << static_cast<std::size_t>(permission);
+    }
 
     /**
-     * @brief Retrieves a list of users with administrator permissions.
-     * @return std::vector<UserID> List of user IDs.
+     * @brief Gets the permission of a name, it throws if no permission has the name.
      */
-    std::vector<UserID> getAdministratorList() const;
-
-private:
-    std::unordered_map<std::string, PermissionType, string_hash, std::equal_to<>>
-                                m_permission_map; ///< Map of permissions and their types
-    mutable std::shared_mutex   m_permission_map_mutex; ///< Mutex for thread-safe access to permission map
+    static Permission getKnownPermission(std::string_view permissionName);
 
-    std::unordered_map<UserID, PermissionType>
-                                m_user_permission_map; ///< Map of users and their permission types
-    mutable std::shared_mutex   m_user_permission_map_mutex; ///< Mutex for thread-safe access to user permission map
+    std::array<std::atomic<Mask>, permission_type_count>
+                                m_masks; ///< Permissions granted to each permission type
+    std::mutex                  m_modify_mutex; ///< Keeps the masks consistent while a permission is modified
 };
 
 } // namespace qls
@@ -10,12 +10,19 @@
 #include <map>
 #include <shared_mutex>
 #include <atomic>
+#include <optional>
 
 #include <Json.h>
 
 #include "manager.h"
 #include "qls_error.h"
 #include "returnStateMessage.hpp"
+#include "jsonStreamWriter.h"
+#include "profiled_shared_mutex.hpp"
+#include "adaptive_mutex.hpp"
+#include "actorMailbox.h"
+#include "groupMemberTable.h"
+#include "coarse_clock.hpp"
 
 extern qls::Manager serverManager;
 
@@ -24,34 +31,201 @@ namespace qls
 
 static std::pmr::synchronized_pool_resource local_sync_group_room_pool;
 
+/**
+ * @brief Makes the data package of a group message, shared by all the receivers.
+ */
+static std::shared_ptr<const std::string> makeGroupMessageFrame(std::string_view type,
+    UserID sender_user_id, GroupID group_id, std::string_view message)
+{
+    JsonStreamWriter writer;
+    writer.startObject()
+        .member("type", type)
+        .key("data").startObject()
+            .member("user_id", sender_user_id.getOriginValue())
+            .member("group_id", group_id.getOriginValue())
+            .member("message", message)
+        .endObject()
+    .endObject();
+    return writer.finishShared(DataPackage::Text);
+}
+
 struct GroupRoomImpl
 {
     GroupID                 m_group_id;
-    UserID                  m_administrator_user_id;
-    std::shared_mutex       m_administrator_user_id_mutex;
+    std::atomic<long long>  m_administrator_user_id = 0;
     std::atomic<bool>       m_can_be_used;
+    /// Permissions granted to each permission type, the types of the members are in the member table
     GroupPermission         m_permission;
 
-    std::unordered_map<UserID, GroupRoom::UserDataStructure>
-                            m_user_id_map;
-    std::shared_mutex       m_user_id_map_mutex;
-
-    std::unordered_map<UserID,
-        std::pair<std::chrono::utc_clock::time_point,
-        std::chrono::minutes>>
-                            m_muted_user_map;
-    std::shared_mutex       m_muted_user_map_mutex;
+    /// Changed in place under m_member_mutex, replaced by a grown copy when it's full
+    std::shared_ptr<GroupMemberTable>
+                            m_members = std::make_shared<GroupMemberTable>();
+    /// The same table as m_members, read by anyone
+    std::atomic<std::shared_ptr<const GroupMemberTable>>
+                            m_member_table{m_members};
+    /// Held to change the members, so a join made by addMember() isn't lost to a change of the room
+    adaptive_mutex          m_member_mutex{"group members"};
 
     std::map<std::chrono::utc_clock::time_point,
         MessageStructure>
                             m_message_map;
-    std::shared_mutex       m_message_map_mutex;
+    /// Written by the room and the cleaning, read by getMessage()
+    profiled_shared_mutex   m_message_map_mutex{"GroupRoomImpl::m_message_map_mutex"};
+
+    ActorMailbox            m_mailbox{serverManager.getServerNetwork().get_io_context().get_executor()};
+    WheelTimer              m_clear_timer{serverManager.getServerTimingWheel()};
+
+    std::shared_ptr<const GroupMemberTable> getMembers() const noexcept
+    {
+        return m_member_table.load(std::memory_order_acquire);
+    }
 
-    asio::steady_timer      m_clear_timer{serverManager.getServerNetwork().get_io_context()};
+    /**
+     * @brief Publishes a new member table, m_member_mutex must be held.
+     */
+    void publishMembers(std::shared_ptr<GroupMemberTable> members)
+    {
+        m_members = members;
+        m_member_table.store(std::move(members), std::memory_order_release);
+    }
+
+    /**
+     * @brief Adds a member, m_member_mutex must be held.
+     *        The table only has to be replaced when it's full.
+     * @return false if the user is already a member
+     */
+    bool addMember(UserID user_id, std::string_view nickname)
+    {
+        if (m_members->contains(user_id))
+            return false;
+        if (!m_members->isFull())
+            return m_members->add(user_id, nickname);
+
+        auto members = m_members->grow();
+        members->add(user_id, nickname);
+        publishMembers(std::move(members));
+        return true;
+    }
+
+    static long long toMilliseconds(std::chrono::utc_clock::time_point time_point) noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            time_point.time_since_epoch()).count();
+    }
+
+    /**
+     * @brief Checks whether a member is muted, a mute that ended needs no cleaning.
+     */
+    static bool isMuted(const GroupMemberTable& members, UserID user_id,
+        std::chrono::utc_clock::time_point now) noexcept
+    {
+        std::size_t index = members.find(user_id);
+        return index != GroupMemberTable::npos &&
+            members.getMuteDeadline(index) > toMilliseconds(now);
+    }
+
+    /**
+     * @brief Checks whether both users are members, the executor ranks above the user
+     *        and is granted the permission of the action.
+     * @param user_permission Permission type the user must have, any if it's std::nullopt
+     */
+    bool canManage(UserID executor_id, UserID user_id, Permission action,
+        std::optional<PermissionType> user_permission = std::nullopt) const
+    {
+        if (executor_id == user_id)
+            return false;
+        auto members = getMembers();
+        std::size_t executor = members->find(executor_id);
+        std::size_t user = members->find(user_id);
+        if (executor == GroupMemberTable::npos || user == GroupMemberTable::npos)
+            return false;
+        PermissionType executor_permission = members->getPermission(executor);
+        PermissionType target_permission = members->getPermission(user);
+        return target_permission < executor_permission &&
+            (!user_permission || target_permission == *user_permission) &&
+            m_permission.hasPermission(executor_permission, action);
+    }
+
+    /**
+     * @brief Sets the permission of a member, m_member_mutex must be held.
+     */
+    void setPermission(UserID user_id, PermissionType permission)
+    {
+        std::size_t index = m_members->find(user_id);
+        if (index != GroupMemberTable::npos)
+            m_members->setPermission(index, permission);
+    }
+
+    /**
+     * @brief Sets the end of the mute of a member, m_member_mutex must be held.
+     */
+    void setMuteDeadline(UserID user_id, std::chrono::utc_clock::time_point deadline)
+    {
+        std::size_t index = m_members->find(user_id);
+        if (index != GroupMemberTable::npos)
+            m_members->setMuteDeadline(index, toMilliseconds(deadline));
+    }
+
+    std::string getNickname(UserID user_id) const
+    {
+        auto members = getMembers();
+        std::size_t index = members->find(user_id);
+        return index == GroupMemberTable::npos ? std::string() : std::string(members->getNickname(index));
+    }
+
+    /**
+     * @brief Stores a message and sends it, called by the room.
+     * @param member_id User who must be in the room
+     * @param message Message, it's only sent to its receiver if it has one
+     * @param frame Data package of the message
+     * @param permission Permission the sender must be granted if it's a member
+     */
+    void deliver(GroupRoom& room, UserID member_id, MessageStructure message,
+        const std::shared_ptr<const std::string>& frame, Permission permission)
+    {
+        // 是否有此user_id, 发送者是否被禁言
+        auto members = getMembers();
+        auto now = CoarseClock::utcNow();
+        if (!members->contains(member_id) || isMuted(*members, message.sender, now))
+            return;
+
+        // 发送者是否有权限
+        std::size_t sender = members->find(message.sender);
+        if (sender != GroupMemberTable::npos &&
+            !m_permission.hasPermission(members->getPermission(sender), permission))
+            return;
+
+        UserID receiver = message.receiver;
+        {
+            std::unique_lock<profiled_shared_mutex> lock(m_message_map_mutex);
+            auto time_point = now;
+            while (m_message_map.find(time_point) != m_message_map.cend()) {
+                ++time_point;
+            }
+            m_message_map.emplace(time_point, std::move(message));
+        }
+
+        if (receiver == UserID(-1ll))
+            room.sendFrame(frame);
+        else
+            room.sendFrame(frame, receiver);
+    }
+
+    /**
+     * @brief Sends a tip of a management action to the room, called by the room.
+     * @param action Permission of the action, the executor was already checked for it
+     */
+    void sendTip(GroupRoom& room, UserID sender_user_id, std::string message, Permission action)
+    {
+        auto frame = makeGroupMessageFrame("group_tip_message", sender_user_id, m_group_id, message);
+        deliver(room, sender_user_id,
+            {sender_user_id, std::move(message), MessageType::TIP_MESSAGE}, frame, action);
+    }
 };
 
 void GroupRoomImplDeleter::operator()(GroupRoomImpl *gri)
 {
+    gri->~GroupRoomImpl();
     local_sync_group_room_pool.deallocate(gri, sizeof(GroupRoomImpl));
 }
 
@@ -65,7 +239,13 @@ GroupRoom::GroupRoom(GroupID group_id, UserID administrator, bool is_create):
                 local_sync_group_room_pool.allocate(sizeof(GroupRoomImpl)))))
 {
     m_impl->m_group_id = group_id;
-    m_impl->m_administrator_user_id = administrator;
+    m_impl->m_administrator_user_id = administrator.getOriginValue();
+
+    // The members of a loaded group are put in the table at once
+    std::string administrator_nickname = serverManager.getUser(administrator)->getUserName();
+    const GroupMemberTable::Member members[] = {
+        {administrator, administrator_nickname, PermissionType::Administrator} };
+    m_impl->publishMembers(std::make_shared<GroupMemberTable>(std::span(members)));
 
     if (is_create) {
         // 创建群聊 sql
@@ -76,8 +256,17 @@ GroupRoom::GroupRoom(GroupID group_id, UserID administrator, bool is_create):
     }
 
     TextDataRoom::joinRoom(administrator);
-    asio::co_spawn(serverManager.getServerNetwork().get_io_context(),
-        auto_clean(), asio::detached);
+    m_impl->m_clear_timer.expires_after(std::chrono::minutes(10), [this]() {
+        // The sweep runs on the room, the thread that turns the wheel only posts it.
+        // A room that is being destroyed has cancelled the timer or has no owner left
+        auto self = weak_from_this().lock();
+        if (!self)
+            return;
+        m_impl->m_mailbox.post([self = std::move(self)]() {
+            self->auto_clean();
+            self->m_impl->m_clear_timer.expires_after(std::chrono::minutes(10));
+        });
+    });
 }
 
 GroupRoom::~GroupRoom() noexcept
@@ -89,13 +278,13 @@ bool GroupRoom::addMember(UserID user_id)
 {
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
-    {
-        std::lock_guard<std::shared_mutex> lg(m_impl->m_user_id_map_mutex);
-        if (m_impl->m_user_id_map.find(user_id) == m_impl->m_user_id_map.cend())
-            m_impl->m_user_id_map.emplace(user_id, serverManager.getUser(user_id)->getUserName());
-    }
-    TextDataRoom::joinRoom(user_id);
 
+    // Published right away, so the caller can tell the user about the group
+    std::string nickname = serverManager.getUser(user_id)->getUserName();
+    std::lock_guard<adaptive_mutex> lock(m_impl->m_member_mutex);
+    if (!m_impl->addMember(user_id, nickname))
+        return false;
+    TextDataRoom::joinRoom(user_id);
     return true;
 }
 
@@ -103,21 +292,19 @@ bool GroupRoom::hasMember(UserID user_id) const
 {
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
-    std::lock_guard<std::shared_mutex> lg(m_impl->m_user_id_map_mutex);
-    return m_impl->m_user_id_map.find(user_id) != m_impl->m_user_id_map.cend();
+    return m_impl->getMembers()->contains(user_id);
 }
 
 bool GroupRoom::removeMember(UserID user_id)
 {
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
-    {
-        std::lock_guard<std::shared_mutex> lg(m_impl->m_user_id_map_mutex);
-        if (m_impl->m_user_id_map.find(user_id) != m_impl->m_user_id_map.cend())
-            m_impl->m_user_id_map.erase(user_id);
-    }
-    TextDataRoom::leaveRoom(user_id);
 
+    // Published right away like a join, so a later addMember() can't be undone by it
+    std::lock_guard<adaptive_mutex> lock(m_impl->m_member_mutex);
+    if (!m_impl->m_members->remove(user_id))
+        return false;
+    TextDataRoom::leaveRoom(user_id);
     return true;
 }
 
@@ -125,45 +312,18 @@ void GroupRoom::sendMessage(UserID sender_user_id, std::string_view message)
 {
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
-    // 是否有此user_id
-    if (!hasUser(sender_user_id))
+    // A muted sender is dropped before the room sees the message
+    if (GroupRoomImpl::isMuted(*m_impl->getMembers(), sender_user_id, CoarseClock::utcNow()))
         return;
 
-    // 发送者是否被禁言
-    {
-        std::shared_lock<std::shared_mutex> lock(m_impl->m_muted_user_map_mutex);
-        auto itor = m_impl->m_muted_user_map.find(sender_user_id);
-        if (itor != m_impl->m_muted_user_map.cend()) {
-            if (itor->second.first + itor->second.second >= std::chrono::utc_clock::now())
-                return;
-            else {
-                lock.unlock();
-                std::unique_lock<std::shared_mutex> lock(m_impl->m_muted_user_map_mutex);
-                m_impl->m_muted_user_map.erase(sender_user_id);
-            }
-        }
-    }
-
-    // store the message
-    {
-        std::unique_lock<std::shared_mutex> lock(m_impl->m_message_map_mutex);
-        auto time_point = std::chrono::utc_clock::now();
-        while (m_impl->m_message_map.find(time_point) != m_impl->m_message_map.cend()) {
-            ++time_point;
-        }
-        m_impl->m_message_map.insert({
-            time_point,
-            {sender_user_id, std::string(message),
-            MessageType::NOMAL_MESSAGE} });
-    }
-
-    qjson::JObject json;
-    json["type"] = "group_message";
-    json["data"]["user_id"] = sender_user_id.getOriginValue();
-    json["data"]["group_id"] = m_impl->m_group_id.getOriginValue();
-    json["data"]["message"] = message;
-
-    sendData(qjson::JWriter::fastWrite(json));
+    // The package is made by the caller, so the room only stores and sends it
+    m_impl->m_mailbox.post([self = shared_from_this(), sender_user_id,
+        frame = makeGroupMessageFrame("group_message", sender_user_id, m_impl->m_group_id, message),
+        message = std::string(message)]() mutable {
+        self->m_impl->deliver(*self, sender_user_id,
+            {sender_user_id, std::move(message), MessageType::NOMAL_MESSAGE}, frame,
+            Permission::SendMessage);
+    });
 }
 
 void GroupRoom::sendTipMessage(UserID sender_user_id,
@@ -171,45 +331,17 @@ void GroupRoom::sendTipMessage(UserID sender_user_id,
 {
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
-    // 是否有此user_id
-    if (!hasUser(sender_user_id))
+    // A muted sender is dropped before the room sees the message
+    if (GroupRoomImpl::isMuted(*m_impl->getMembers(), sender_user_id, CoarseClock::utcNow()))
         return;
 
-    // 发送者是否被禁言
-    {
-        std::shared_lock<std::shared_mutex> lock(m_impl->m_muted_user_map_mutex);
-        auto itor = m_impl->m_muted_user_map.find(sender_user_id);
-        if (itor != m_impl->m_muted_user_map.cend()) {
-            if (itor->second.first + itor->second.second >= std::chrono::utc_clock::now())
-                return;
-            else {
-                lock.unlock();
-                std::unique_lock<std::shared_mutex> lock(m_impl->m_muted_user_map_mutex);
-                m_impl->m_muted_user_map.erase(sender_user_id);
-            }
-        }
-    }
-
-    // store the message
-    {
-        std::unique_lock<std::shared_mutex> lock(m_impl->m_message_map_mutex);
-        auto time_point = std::chrono::utc_clock::now();
-        while (m_impl->m_message_map.find(time_point) != m_impl->m_message_map.cend()) {
-            ++time_point;
-        }
-        m_impl->m_message_map.insert({
-            time_point,
-            {sender_user_id, std::string(message),
-            MessageType::TIP_MESSAGE} });
-    }
-
-    qjson::JObject json;
-    json["type"] = "group_tip_message";
-    json["data"]["user_id"] = sender_user_id.getOriginValue();
-    json["data"]["group_id"] = m_impl->m_group_id.getOriginValue();
-    json["data"]["message"] = message;
-
-    sendData(qjson::JWriter::fastWrite(json));
+    m_impl->m_mailbox.post([self = shared_from_this(), sender_user_id,
+        frame = makeGroupMessageFrame("group_tip_message", sender_user_id, m_impl->m_group_id, message),
+        message = std::string(message)]() mutable {
+        self->m_impl->deliver(*self, sender_user_id,
+            {sender_user_id, std::move(message), MessageType::TIP_MESSAGE}, frame,
+            Permission::SendTipMessage);
+    });
 }
 
 void GroupRoom::sendUserTipMessage(UserID sender_user_id,
@@ -217,48 +349,17 @@ void GroupRoom::sendUserTipMessage(UserID sender_user_id,
 {
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
-    // 是否有此user_id
-    if (!hasUser(receiver_user_id))
+    // A muted sender is dropped before the room sees the message
+    if (GroupRoomImpl::isMuted(*m_impl->getMembers(), sender_user_id, CoarseClock::utcNow()))
         return;
 
-    // 发送者是否被禁言
-    {
-        std::shared_lock<std::shared_mutex> lock(m_impl->m_muted_user_map_mutex);
-        auto itor = m_impl->m_muted_user_map.find(sender_user_id);
-        if (itor != m_impl->m_muted_user_map.cend()) {
-            if (itor->second.first + itor->second.second >= std::chrono::utc_clock::now())
-                return;
-            else {
-                lock.unlock();
-                std::unique_lock<std::shared_mutex> lock(m_impl->m_muted_user_map_mutex);
-                m_impl->m_muted_user_map.erase(sender_user_id);
-            }
-        }
-    }
-
-    // store the message
-    {
-        std::unique_lock<std::shared_mutex> lock(m_impl->m_message_map_mutex);
-        auto time_point = std::chrono::utc_clock::now();
-        while (m_impl->m_message_map.find(time_point) != m_impl->m_message_map.cend()) {
-            ++time_point;
-        }
-        m_impl->m_message_map.insert({
-            time_point,
-            {
-                sender_user_id, std::string(message),
-                MessageType::TIP_MESSAGE,
-                receiver_user_id
-            }});
-    }
-
-    qjson::JObject json;
-    json["type"] = "group_tip_message";
-    json["data"]["user_id"] = sender_user_id.getOriginValue();
-    json["data"]["group_id"] = m_impl->m_group_id.getOriginValue();
-    json["data"]["message"] = message;
-
-    sendData(qjson::JWriter::fastWrite(json), receiver_user_id);
+    m_impl->m_mailbox.post([self = shared_from_this(), sender_user_id, receiver_user_id,
+        frame = makeGroupMessageFrame("group_tip_message", sender_user_id, m_impl->m_group_id, message),
+        message = std::string(message)]() mutable {
+        self->m_impl->deliver(*self, receiver_user_id,
+            {sender_user_id, std::move(message), MessageType::TIP_MESSAGE, receiver_user_id}, frame,
+            Permission::SendTipMessage);
+    });
 }
 
 std::vector<MessageResult> GroupRoom::getMessage(
@@ -270,7 +371,7 @@ std::vector<MessageResult> GroupRoom::getMessage(
     if (from > to)
         return {};
 
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_message_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_message_map_mutex);
     const auto& message_map = std::as_const(m_impl->m_message_map);
     if (message_map.empty())
         return {};
@@ -288,8 +389,15 @@ bool GroupRoom::hasUser(UserID user_id) const
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
 
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_user_id_map_mutex);
-    return m_impl->m_user_id_map.find(user_id) != m_impl->m_user_id_map.cend();
+    return m_impl->getMembers()->contains(user_id);
+}
+
+std::size_t GroupRoom::getMemberCount() const
+{
+    if (!m_impl->m_can_be_used)
+        throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
+
+    return m_impl->getMembers()->size();
 }
 
 std::unordered_map<UserID, GroupRoom::UserDataStructure> GroupRoom::getUserList() const
@@ -297,8 +405,15 @@ std::unordered_map<UserID, GroupRoom::UserDataStructure> GroupRoom::getUserList(
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
 
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_user_id_map_mutex);
-    return m_impl->m_user_id_map;
+    auto members = m_impl->getMembers();
+    std::unordered_map<UserID, UserDataStructure> user_list;
+    user_list.reserve(members->size());
+    members->forEach([&members, &user_list](std::size_t index, UserID user_id) {
+        UserDataStructure& data = user_list[user_id];
+        data.nickname = members->getNickname(index);
+        data.level.increase(members->getLevel(index) - 1);
+    });
+    return user_list;
 }
 
 std::string GroupRoom::getUserNickname(UserID user_id) const
@@ -306,12 +421,12 @@ std::string GroupRoom::getUserNickname(UserID user_id) const
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
 
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_user_id_map_mutex);
-    auto itor = m_impl->m_user_id_map.find(user_id);
-    if (itor == m_impl->m_user_id_map.cend())
+    auto members = m_impl->getMembers();
+    std::size_t index = members->find(user_id);
+    if (index == GroupMemberTable::npos)
         throw std::system_error(make_error_code(qls_errc::user_not_existed), "user isn't in the room");
 
-    return itor->second.nickname;
+    return std::string(members->getNickname(index));
 }
 
 long long GroupRoom::getUserGroupLevel(UserID user_id) const
@@ -319,12 +434,12 @@ long long GroupRoom::getUserGroupLevel(UserID user_id) const
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
 
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_user_id_map_mutex);
-    auto itor = m_impl->m_user_id_map.find(user_id);
-    if (itor == m_impl->m_user_id_map.cend())
+    auto members = m_impl->getMembers();
+    std::size_t index = members->find(user_id);
+    if (index == GroupMemberTable::npos)
         throw std::system_error(make_error_code(qls_errc::user_not_existed), "user isn't in the room");
 
-    return itor->second.level.getValue();
+    return members->getLevel(index);
 }
 
 std::unordered_map<UserID, PermissionType>
@@ -333,7 +448,13 @@ std::unordered_map<UserID, PermissionType>
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
 
-    return std::move(m_impl->m_permission.getUserPermissionList());
+    auto members = m_impl->getMembers();
+    std::unordered_map<UserID, PermissionType> permission_list;
+    permission_list.reserve(members->size());
+    members->forEach([&members, &permission_list](std::size_t index, UserID user_id) {
+        permission_list.emplace(user_id, members->getPermission(index));
+    });
+    return permission_list;
 }
 
 UserID GroupRoom::getAdministrator() const
@@ -341,8 +462,7 @@ UserID GroupRoom::getAdministrator() const
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
 
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_administrator_user_id_mutex);
-    return m_impl->m_administrator_user_id;
+    return UserID(m_impl->m_administrator_user_id.load(std::memory_order_relaxed));
 }
 
 void GroupRoom::setAdministrator(UserID user_id)
@@ -350,29 +470,16 @@ void GroupRoom::setAdministrator(UserID user_id)
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
 
-    std::unique_lock<std::shared_mutex> lock1(m_impl->m_user_id_map_mutex, std::defer_lock);
-    std::unique_lock<std::shared_mutex> lock2(m_impl->m_administrator_user_id_mutex, std::defer_lock);
-    std::lock(lock1, lock2);
+    std::string nickname = serverManager.getUser(user_id)->getUserName();
+    std::lock_guard<adaptive_mutex> lock(m_impl->m_member_mutex);
+    if (m_impl->addMember(user_id, nickname))
+        TextDataRoom::joinRoom(user_id);
 
-    if (m_impl->m_administrator_user_id == 0) {
-        auto itor = m_impl->m_user_id_map.find(user_id);
-        if (itor == m_impl->m_user_id_map.cend()) {
-            m_impl->m_user_id_map.emplace(user_id, serverManager.getUser(user_id)->getUserName());
-            m_impl->m_permission.modifyUserPermission(user_id,
-                PermissionType::Administrator);
-        }
-        else
-            m_impl->m_permission.modifyUserPermission(user_id,
-                PermissionType::Administrator);
-    }
-    else
-    {
-        m_impl->m_permission.modifyUserPermission(m_impl->m_administrator_user_id,
-            PermissionType::Default);
-        m_impl->m_permission.modifyUserPermission(user_id,
-            PermissionType::Administrator);
-        m_impl->m_administrator_user_id = user_id;
-    }
+    UserID old_administrator(m_impl->m_administrator_user_id.load(std::memory_order_relaxed));
+    if (old_administrator != user_id)
+        m_impl->setPermission(old_administrator, PermissionType::Default);
+    m_impl->setPermission(user_id, PermissionType::Administrator);
+    m_impl->m_administrator_user_id.store(user_id.getOriginValue(), std::memory_order_relaxed);
 }
 
 GroupID GroupRoom::getGroupID() const
@@ -384,37 +491,34 @@ std::vector<UserID> GroupRoom::getDefaultUserList() const
 {
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
-    return std::move(m_impl->m_permission.getDefaultUserList());
+    return m_impl->getMembers()->getUserIDsWith(PermissionType::Default);
 }
 
 std::vector<UserID> GroupRoom::getOperatorList() const
 {
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
-    return std::move(m_impl->m_permission.getOperatorList());
+    return m_impl->getMembers()->getUserIDsWith(PermissionType::Operator);
 }
 
 bool GroupRoom::muteUser(UserID executor_id, UserID user_id, const std::chrono::minutes& mins)
 {
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
-    if (executor_id == user_id || !hasUser(user_id) || !hasUser(executor_id))
-        return false;
-
-    auto executor_idType = m_impl->m_permission.getUserPermissionType(executor_id);
-    auto userIdType = m_impl->m_permission.getUserPermissionType(user_id);
-    if (userIdType >= executor_idType)
+    if (!m_impl->canManage(executor_id, user_id, Permission::MuteUser))
         return false;
 
-    std::unique_lock<std::shared_mutex> lock1(m_impl->m_muted_user_map_mutex, std::defer_lock);
-    std::shared_lock<std::shared_mutex> lock2(m_impl->m_user_id_map_mutex, std::defer_lock);
-    std::lock(lock1, lock2);
-
-    m_impl->m_muted_user_map[user_id] = std::pair<std::chrono::utc_clock::time_point,
-        std::chrono::minutes>(std::chrono::utc_clock::now(), mins);
-    sendTipMessage(executor_id, std::format("{} was muted by {}",
-        m_impl->m_user_id_map[user_id].nickname, m_impl->m_user_id_map[executor_id].nickname));
-
+    m_impl->m_mailbox.post([self = shared_from_this(), executor_id, user_id, mins]() {
+        GroupRoomImpl& impl = *self->m_impl;
+        if (!impl.canManage(executor_id, user_id, Permission::MuteUser))
+            return;
+        {
+            std::lock_guard<adaptive_mutex> lock(impl.m_member_mutex);
+            impl.setMuteDeadline(user_id, CoarseClock::utcNow() + mins);
+        }
+        impl.sendTip(*self, executor_id, std::format("{} was muted by {}",
+            impl.getNickname(user_id), impl.getNickname(executor_id)), Permission::MuteUser);
+    });
     return true;
 }
 
@@ -422,22 +526,20 @@ bool GroupRoom::unmuteUser(UserID executor_id, UserID user_id)
 {
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
-    if (executor_id == user_id || !hasUser(user_id) || !hasUser(executor_id))
-        return false;
-
-    auto executor_idType = m_impl->m_permission.getUserPermissionType(executor_id);
-    auto userIdType = m_impl->m_permission.getUserPermissionType(user_id);
-    if (userIdType >= executor_idType)
+    if (!m_impl->canManage(executor_id, user_id, Permission::UnmuteUser))
         return false;
 
-    std::unique_lock<std::shared_mutex> lock1(m_impl->m_muted_user_map_mutex, std::defer_lock);
-    std::shared_lock<std::shared_mutex> lock2(m_impl->m_user_id_map_mutex, std::defer_lock);
-    std::lock(lock1, lock2);
-
-    m_impl->m_muted_user_map.erase(user_id);
-    sendTipMessage(executor_id, std::format("{} was unmuted by {}",
-        m_impl->m_user_id_map[user_id].nickname, m_impl->m_user_id_map[executor_id].nickname));
-
+    m_impl->m_mailbox.post([self = shared_from_this(), executor_id, user_id]() {
+        GroupRoomImpl& impl = *self->m_impl;
+        if (!impl.canManage(executor_id, user_id, Permission::UnmuteUser))
+            return;
+        {
+            std::lock_guard<adaptive_mutex> lock(impl.m_member_mutex);
+            impl.setMuteDeadline(user_id, std::chrono::utc_clock::time_point());
+        }
+        impl.sendTip(*self, executor_id, std::format("{} was unmuted by {}",
+            impl.getNickname(user_id), impl.getNickname(executor_id)), Permission::UnmuteUser);
+    });
     return true;
 }
 
@@ -445,21 +547,28 @@ bool GroupRoom::kickUser(UserID executor_id, UserID user_id)
 {
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
-    if (executor_id == user_id || !hasUser(user_id) || !hasUser(executor_id))
-        return false;
 
-    auto executor_idType = m_impl->m_permission.getUserPermissionType(executor_id);
-    auto userIdType = m_impl->m_permission.getUserPermissionType(user_id);
-    if (userIdType >= executor_idType)
-        return false;
-
-    std::unique_lock<std::shared_mutex> lock1(m_impl->m_user_id_map_mutex, std::defer_lock),
-        lock2(m_impl->m_muted_user_map_mutex, std::defer_lock);
-    std::lock(lock1, lock2);
-    sendTipMessage(executor_id, std::format("{} was kicked by {}",
-        m_impl->m_user_id_map[user_id].nickname, m_impl->m_user_id_map[executor_id].nickname));
-    m_impl->m_user_id_map.erase(user_id);
+    // The user leaves right away like with removeMember(), the tip follows on the room
+    std::string tip;
+    {
+        std::lock_guard<adaptive_mutex> lock(m_impl->m_member_mutex);
+        if (!m_impl->canManage(executor_id, user_id, Permission::KickUser))
+            return false;
+        tip = std::format("{} was kicked by {}",
+            m_impl->getNickname(user_id), m_impl->getNickname(executor_id));
+        m_impl->m_members->remove(user_id);
+        TextDataRoom::leaveRoom(user_id);
+    }
 
+    auto frame = makeGroupMessageFrame("group_tip_message", executor_id, m_impl->m_group_id, tip);
+    // The kicked user isn't in the room anymore, so it gets the tip on its own
+    if (serverManager.hasUser(user_id))
+        serverManager.getUser(user_id)->notifyAll(frame);
+    m_impl->m_mailbox.post([self = shared_from_this(), executor_id, frame,
+        tip = std::move(tip)]() mutable {
+        self->m_impl->deliver(*self, executor_id,
+            {executor_id, std::move(tip), MessageType::TIP_MESSAGE}, frame, Permission::KickUser);
+    });
     return true;
 }
 
@@ -467,21 +576,20 @@ bool GroupRoom::addOperator(UserID executor_id, UserID user_id)
 {
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
-    if (executor_id == user_id || !hasUser(user_id) || !hasUser(executor_id))
-        return false;
-
-    if (m_impl->m_permission.getUserPermissionType(executor_id) != PermissionType::Administrator)
-        return false;
-    if (m_impl->m_permission.getUserPermissionType(user_id) != PermissionType::Default)
+    if (!m_impl->canManage(executor_id, user_id, Permission::AddOperator, PermissionType::Default))
         return false;
 
-    m_impl->m_permission.modifyUserPermission(user_id,
-        PermissionType::Operator);
-
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_user_id_map_mutex);
-    sendTipMessage(executor_id, std::format("{} was turned operator by {}",
-        m_impl->m_user_id_map[user_id].nickname, m_impl->m_user_id_map[executor_id].nickname));
-
+    m_impl->m_mailbox.post([self = shared_from_this(), executor_id, user_id]() {
+        GroupRoomImpl& impl = *self->m_impl;
+        if (!impl.canManage(executor_id, user_id, Permission::AddOperator, PermissionType::Default))
+            return;
+        {
+            std::lock_guard<adaptive_mutex> lock(impl.m_member_mutex);
+            impl.setPermission(user_id, PermissionType::Operator);
+        }
+        impl.sendTip(*self, executor_id, std::format("{} was turned operator by {}",
+            impl.getNickname(user_id), impl.getNickname(executor_id)), Permission::AddOperator);
+    });
     return true;
 }
 
@@ -489,23 +597,20 @@ bool GroupRoom::removeOperator(UserID executor_id, UserID user_id)
 {
     if (!m_impl->m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
-    if (executor_id == user_id || !hasUser(user_id) || !hasUser(executor_id))
+    if (!m_impl->canManage(executor_id, user_id, Permission::RemoveOperator, PermissionType::Operator))
         return false;
 
-    if (m_impl->m_permission.getUserPermissionType(executor_id) !=
-        PermissionType::Administrator)
-        return false;
-    if (m_impl->m_permission.getUserPermissionType(user_id) !=
-        PermissionType::Operator)
-        return false;
-
-    m_impl->m_permission.modifyUserPermission(user_id,
-        PermissionType::Default);
-
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_user_id_map_mutex);
-    sendTipMessage(executor_id, std::format("{} was turned default user by {}",
-        m_impl->m_user_id_map[user_id].nickname, m_impl->m_user_id_map[executor_id].nickname));
-
+    m_impl->m_mailbox.post([self = shared_from_this(), executor_id, user_id]() {
+        GroupRoomImpl& impl = *self->m_impl;
+        if (!impl.canManage(executor_id, user_id, Permission::RemoveOperator, PermissionType::Operator))
+            return;
+        {
+            std::lock_guard<adaptive_mutex> lock(impl.m_member_mutex);
+            impl.setPermission(user_id, PermissionType::Default);
+        }
+        impl.sendTip(*self, executor_id, std::format("{} was turned default user by {}",
+            impl.getNickname(user_id), impl.getNickname(executor_id)), Permission::RemoveOperator);
+    });
     return true;
 }
 
@@ -525,26 +630,17 @@ bool GroupRoom::canBeUsed() const
     return m_impl->m_can_be_used;
 }
 
-asio::awaitable<void> GroupRoom::auto_clean()
+void GroupRoom::auto_clean()
 {
-    using namespace std::chrono_literals;
-    try {
-        while (true) {
-            m_impl->m_clear_timer.expires_after(10min);
-            co_await m_impl->m_clear_timer.async_wait(asio::use_awaitable);
-            std::unique_lock<std::shared_mutex> lock(m_impl->m_message_map_mutex);
-            auto end = m_impl->m_message_map.upper_bound(std::chrono::utc_clock::now() - std::chrono::days(7));
-            m_impl->m_message_map.erase(m_impl->m_message_map.begin(), end);
-        }
-    } catch(...) {
-        co_return;
-    }
+    std::unique_lock<profiled_shared_mutex> lock(m_impl->m_message_map_mutex);
+    auto end = m_impl->m_message_map.upper_bound(std::chrono::utc_clock::now() - std::chrono::days(7));
+    m_impl->m_message_map.erase(m_impl->m_message_map.begin(), end);
 }
 
 void GroupRoom::stop_cleaning()
 {
-    std::error_code ec;
-    m_impl->m_clear_timer.cancel(ec);
+    // Waits for a sweep that is running, so the room can be destroyed afterwards
+    m_impl->m_clear_timer.cancel();
 }
 
 } // namespace qls
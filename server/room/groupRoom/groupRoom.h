@@ -3,6 +3,7 @@
 
 #include <chrono>
 #include <asio.hpp>
+#include <memory>
 #include <vector>
 
 #include "qls_error.h"
@@ -21,7 +22,20 @@ struct GroupRoomImplDeleter
     void operator()(GroupRoomImpl* gri);
 };
 
-class GroupRoom: public TextDataRoom
+/**
+ * @class GroupRoom
+ * @brief Group chat room that runs as an actor.
+ *
+ * Sends and mutations are posted to the mailbox of the room and processed one at
+ * a time, so every member sees the messages of a room in the same order and the
+ * state of the room needs no lock. The members are kept in a GroupMemberTable that
+ * is changed in place and only replaced when it's full, readers use the latest one
+ * without waiting for the room. Joins and leaves are published by addMember(),
+ * removeMember() and kickUser() themselves, so they take effect in the order they
+ * are called and a new member can send right away. Rooms must be owned by a
+ * std::shared_ptr, the queued tasks keep their room alive.
+ */
+class GroupRoom: public TextDataRoom, public std::enable_shared_from_this<GroupRoom>
 {
 public:
     struct UserDataStructure
@@ -35,10 +49,23 @@ public:
     GroupRoom(GroupRoom&&) = delete;
     ~GroupRoom() noexcept;
 
+    /**
+     * @brief Adds a member, hasMember() sees it once this returns.
+     * @return false if the user is already a member
+     */
     bool addMember(UserID user_id);
     bool hasMember(UserID user_id) const;
+
+    /**
+     * @brief Removes a member, hasMember() no longer sees it once this returns.
+     * @return false if the user isn't a member
+     */
     bool removeMember(UserID user_id);
-    
+
+    /**
+     * @brief Queues a message, it's dropped if the sender isn't a member or is muted
+     *        when the room processes it.
+     */
     void sendMessage(UserID sender_user_id, std::string_view message);
     void sendTipMessage(UserID sender_user_id, std::string_view message);
     void sendUserTipMessage(UserID sender_user_id, std::string_view, UserID receiver_user_id);
@@ -47,6 +74,7 @@ public:
         const std::chrono::utc_clock::time_point& to);
 
     bool                                    hasUser(UserID user_id) const;
+    std::size_t                             getMemberCount() const;
     std::unordered_map<UserID,
         UserDataStructure>                  getUserList() const;
     std::string                             getUserNickname(UserID user_id) const;
@@ -58,6 +86,12 @@ public:
     std::vector<UserID>                     getDefaultUserList() const;
     std::vector<UserID>                     getOperatorList() const;
     
+    /**
+     * @brief The management functions check the permissions against the latest snapshot
+     *        and queue the change, which the room checks again when it processes it.
+     *        kickUser() removes the user right away and only queues the tip.
+     * @return Whether the change was queued
+     */
     bool muteUser(UserID executor_id, UserID user_id, const std::chrono::minutes& mins);
     bool unmuteUser(UserID executor_id, UserID user_id);
     bool kickUser(UserID executor_id, UserID user_id);
@@ -68,7 +102,11 @@ public:
     void removeThisRoom();
     bool canBeUsed() const;
 
-    asio::awaitable<void> auto_clean();
+    /**
+     * @brief Removes the messages older than 7 days,
+     *        the clear timer posts it to the room every 10 minutes.
+     */
+    void auto_clean();
     void stop_cleaning();
 
 private:
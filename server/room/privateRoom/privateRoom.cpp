@@ -3,13 +3,17 @@
 #include <stdexcept>
 #include <vector>
 #include <atomic>
+#include <map>
+#include <memory_resource>
 #include <shared_mutex>
 #include <Json.h>
 
 #include "qls_error.h"
 #include "manager.h"
-#include "qls_error.h"
 #include "returnStateMessage.hpp"
+#include "jsonStreamWriter.h"
+#include "profiled_shared_mutex.hpp"
+#include "coarse_clock.hpp"
 
 extern qls::Manager serverManager;
 
@@ -18,111 +22,87 @@ static std::pmr::synchronized_pool_resource local_sync_private_room_pool;
 namespace qls
 {
 
-struct PrivateRoomImpl
+struct PrivateMessageLog
 {
-    const UserID m_user_id_1, m_user_id_2;
-
-    std::atomic<bool>               m_can_be_used;
-
     std::map<std::chrono::utc_clock::time_point, MessageStructure>
                             m_message_map;
-    std::shared_mutex       m_message_map_mutex;
-
-    asio::steady_timer      m_clear_timer{serverManager.getServerNetwork().get_io_context()};
+    profiled_shared_mutex   m_message_map_mutex{"PrivateMessageLog::m_message_map_mutex"};
 };
 
-void PrivateRoomImplDeleter::operator()(PrivateRoomImpl* pri) noexcept
-{
-    local_sync_private_room_pool.deallocate(pri, sizeof(PrivateRoomImpl));
-}
-
 // PrivateRoom
 PrivateRoom::PrivateRoom(UserID user_id_1, UserID user_id_2, bool is_create):
-    TextDataRoom(&local_sync_private_room_pool),
-    m_impl(
-        [&](PrivateRoomImpl* pri) {
-            new(pri) PrivateRoomImpl(user_id_1, user_id_2); return pri;
-            } (static_cast<PrivateRoomImpl*>(
-                local_sync_private_room_pool.allocate(sizeof(PrivateRoomImpl)))))
+    m_user_id_1(user_id_1),
+    m_user_id_2(user_id_2)
 {
     if (is_create) {
         // sql 创建private room
-        m_impl->m_can_be_used = true;
+        m_can_be_used = true;
     } else {
         // sql 读取private room
-        m_impl->m_can_be_used = true;
+        m_can_be_used = true;
     }
-
-    TextDataRoom::joinRoom(user_id_1);
-    TextDataRoom::joinRoom(user_id_2);
-    asio::co_spawn(serverManager.getServerNetwork().get_io_context(),
-        auto_clean(), asio::detached);
-}
-
-PrivateRoom::~PrivateRoom() noexcept
-{
-    stop_cleaning();
 }
 
 void PrivateRoom::sendMessage(std::string_view message, UserID sender_user_id)
 {
-    if (!m_impl->m_can_be_used)
+    if (!m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::private_room_unable_to_use));
-    if (!hasUser(sender_user_id))
+    if (sender_user_id != m_user_id_1 && sender_user_id != m_user_id_2)
         return;
 
     // 存储数据
-    {
-        std::unique_lock<std::shared_mutex> lock(m_impl->m_message_map_mutex);
-        m_impl->m_message_map.insert({
-            std::chrono::utc_clock::now(),
-            {sender_user_id, std::string(message),
-            MessageType::TIP_MESSAGE} });
-    }
-
-    qjson::JObject json;
-    json["type"] = "private_message";
-    json["data"]["user_id"] = sender_user_id.getOriginValue();
-    json["data"]["message"] = message;
-
-    sendData(qjson::JWriter::fastWrite(json));
+    storeMessage(message, sender_user_id, MessageType::NOMAL_MESSAGE);
+
+    JsonStreamWriter writer;
+    writer.startObject()
+        .member("type", "private_message")
+        .key("data").startObject()
+            .member("user_id", sender_user_id.getOriginValue())
+            .member("message", message)
+        .endObject()
+    .endObject();
+
+    sendFrame(writer.finishShared(DataPackage::Text));
 }
 
 void PrivateRoom::sendTipMessage(std::string_view message, UserID sender_user_id)
 {
-    if (!m_impl->m_can_be_used)
+    if (!m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::private_room_unable_to_use));
-    if (!hasUser(sender_user_id))
+    if (sender_user_id != m_user_id_1 && sender_user_id != m_user_id_2)
         return;
-    
-    // 存储数据
-    {
-        std::unique_lock<std::shared_mutex> lock(m_impl->m_message_map_mutex);
-        m_impl->m_message_map.insert({
-            std::chrono::utc_clock::now(),
-            {sender_user_id, std::string(message),
-            MessageType::TIP_MESSAGE} });
-    }
-    
-    qjson::JObject json;
-    json["type"] = "private_tip_message";
-    json["data"]["user_id"] = sender_user_id.getOriginValue();
-    json["data"]["message"] = message;
 
-    sendData(qjson::JWriter::fastWrite(json));
+    // 存储数据
+    storeMessage(message, sender_user_id, MessageType::TIP_MESSAGE);
+
+    JsonStreamWriter writer;
+    writer.startObject()
+        .member("type", "private_tip_message")
+        .key("data").startObject()
+            .member("user_id", sender_user_id.getOriginValue())
+            .member("message", message)
+        .endObject()
+    .endObject();
+
+    sendFrame(writer.finishShared(DataPackage::Text));
 }
 
 std::vector<MessageResult> PrivateRoom::getMessage(
     const std::chrono::utc_clock::time_point& from,
     const std::chrono::utc_clock::time_point& to)
 {
-    if (!m_impl->m_can_be_used)
-        throw std::system_error(make_error_code(qls_errc::group_room_unable_to_use));
+    if (!m_can_be_used)
+        throw std::system_error(make_error_code(qls_errc::private_room_unable_to_use));
     if (from > to)
         return {};
 
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_message_map_mutex);
-    const auto& message_map = std::as_const(m_impl->m_message_map);
+    // No log means nothing was ever sent
+    auto log = m_message_log.load(std::memory_order_acquire);
+    if (!log)
+        return {};
+
+    std::shared_lock<profiled_shared_mutex> lock(log->m_message_map_mutex);
+    const auto& message_map = std::as_const(log->m_message_map);
     if (message_map.empty())
         return {};
     auto start = message_map.lower_bound(from);
@@ -136,21 +116,21 @@ std::vector<MessageResult> PrivateRoom::getMessage(
 
 std::pair<UserID, UserID> PrivateRoom::getUserID() const
 {
-    if (!m_impl->m_can_be_used)
+    if (!m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::private_room_unable_to_use));
-    return {m_impl->m_user_id_1, m_impl->m_user_id_2};
+    return {m_user_id_1, m_user_id_2};
 }
 
 bool PrivateRoom::hasMember(UserID user_id) const
 {
-    if (!m_impl->m_can_be_used)
+    if (!m_can_be_used)
         throw std::system_error(make_error_code(qls_errc::private_room_unable_to_use));
-    return user_id == m_impl->m_user_id_1 || user_id == m_impl->m_user_id_2;
+    return user_id == m_user_id_1 || user_id == m_user_id_2;
 }
 
 void PrivateRoom::removeThisRoom()
 {
-    m_impl->m_can_be_used = false;
+    m_can_be_used = false;
 
     {
         // sql 上面删除此房间
@@ -161,29 +141,49 @@ void PrivateRoom::removeThisRoom()
 
 bool PrivateRoom::canBeUsed() const
 {
-    return m_impl->m_can_be_used;
+    return m_can_be_used;
 }
 
-asio::awaitable<void> PrivateRoom::auto_clean()
+void PrivateRoom::auto_clean()
 {
-    using namespace std::chrono_literals;
-    try {
-        while (true) {
-            m_impl->m_clear_timer.expires_after(10min);
-            co_await m_impl->m_clear_timer.async_wait(asio::use_awaitable);
-            std::unique_lock<std::shared_mutex> lock(m_impl->m_message_map_mutex);
-            auto end = m_impl->m_message_map.upper_bound(std::chrono::utc_clock::now() - std::chrono::days(7));
-            m_impl->m_message_map.erase(m_impl->m_message_map.begin(), end);
-        }
-    } catch(...) {
-        co_return;
+    auto log = m_message_log.load(std::memory_order_acquire);
+    if (!log)
+        return;
+
+    std::unique_lock<profiled_shared_mutex> lock(log->m_message_map_mutex);
+    auto end = log->m_message_map.upper_bound(CoarseClock::utcNow() - std::chrono::days(7));
+    log->m_message_map.erase(log->m_message_map.begin(), end);
+}
+
+void PrivateRoom::storeMessage(std::string_view message, UserID sender_user_id, MessageType type)
+{
+    auto log = m_message_log.load(std::memory_order_acquire);
+    if (!log) {
+        // Two first messages may race, the loser uses the log of the winner
+        auto new_log = std::allocate_shared<PrivateMessageLog>(
+            std::pmr::polymorphic_allocator<PrivateMessageLog>(&local_sync_private_room_pool));
+        if (m_message_log.compare_exchange_strong(log, new_log, std::memory_order_acq_rel))
+            log = std::move(new_log);
     }
+
+    std::unique_lock<profiled_shared_mutex> lock(log->m_message_map_mutex);
+    // Messages stored in the same tick of the clock get the next free time point
+    auto time_point = CoarseClock::utcNow();
+    while (log->m_message_map.find(time_point) != log->m_message_map.cend()) {
+        ++time_point;
+    }
+    log->m_message_map.insert({
+        time_point,
+        {sender_user_id, std::string(message), type} });
 }
 
-void PrivateRoom::stop_cleaning()
+void PrivateRoom::sendFrame(const std::shared_ptr<const std::string>& frame) const
 {
-    std::error_code ec;
-    m_impl->m_clear_timer.cancel(ec);
+    // A user without connections gets nothing, the message is still in the log
+    for (UserID user_id: {m_user_id_1, m_user_id_2}) {
+        if (serverManager.hasUser(user_id))
+            serverManager.getUser(user_id)->notifyAll(frame);
+    }
 }
 
 } // namespace qls
@@ -1,10 +1,11 @@
 #ifndef PRIVATE_ROOM_H
 #define PRIVATE_ROOM_H
 
+#include <atomic>
 #include <chrono>
 #include <string_view>
-#include <memory_resource>
 #include <memory>
+#include <vector>
 
 #include "userid.hpp"
 #include "room.h"
@@ -12,41 +13,62 @@
 namespace qls
 {
 
-struct PrivateRoomImpl;
-struct PrivateRoomImplDeleter
-{
-    void operator()(PrivateRoomImpl* pri) noexcept;
-};
-    
+struct PrivateMessageLog;
+
 /*
-* @brief 私聊房间基类
+* @brief 私聊房间
+*
+* A conversation between two friends is only the pair of users and a handle to its
+* message log, the log is made by the first message. Messages go straight to the
+* connections of the two users, so a friendship has no user map, no timer and no
+* coroutine of its own. The old messages of every conversation are removed by one
+* task of the manager.
 */
-class PrivateRoom: public TextDataRoom
+class PrivateRoom final
 {
 public:
     PrivateRoom(UserID user_id_1, UserID user_id_2, bool is_create);
     PrivateRoom(const PrivateRoom&) = delete;
     PrivateRoom(PrivateRoom&&) = delete;
 
-    ~PrivateRoom() noexcept;
+    ~PrivateRoom() noexcept = default;
+
+    PrivateRoom& operator=(const PrivateRoom&) = delete;
+    PrivateRoom& operator=(PrivateRoom&&) = delete;
 
     void sendMessage(std::string_view message, UserID sender_user_id);
     void sendTipMessage(std::string_view message, UserID sender_user_id);
     std::vector<MessageResult> getMessage(
         const std::chrono::utc_clock::time_point& from,
         const std::chrono::utc_clock::time_point& to);
-        
+
     std::pair<UserID, UserID> getUserID() const;
     bool hasMember(UserID user_id) const;
 
     void removeThisRoom();
     bool canBeUsed() const;
 
-    asio::awaitable<void> auto_clean();
-    void stop_cleaning();
+    /**
+     * @brief Removes the messages older than 7 days,
+     *        called by the manager every 10 minutes.
+     */
+    void auto_clean();
 
 private:
-    std::unique_ptr<PrivateRoomImpl, PrivateRoomImplDeleter> m_impl;
+    /**
+     * @brief Stores a message in the log, the log is made if there's none yet.
+     */
+    void storeMessage(std::string_view message, UserID sender_user_id, MessageType type);
+
+    /**
+     * @brief Sends a frame to the connections of both users.
+     */
+    void sendFrame(const std::shared_ptr<const std::string>& frame) const;
+
+    const UserID                    m_user_id_1, m_user_id_2;
+    std::atomic<bool>               m_can_be_used;
+    std::atomic<std::shared_ptr<PrivateMessageLog>>
+                                    m_message_log; ///< nullptr until the first message
 };
 
 } // namespace qls
@@ -7,9 +7,11 @@
 
 #include "Json.h"
 #include "dataPackage.h"
+#include "jsonStreamWriter.h"
 #include "manager.h"
 #include "logger.hpp"
 #include "user.h"
+#include "profiled_shared_mutex.hpp"
 
 extern qls::Manager serverManager;
 extern Log::Logger serverLogger;
@@ -30,7 +32,7 @@ struct TCPRoomImpl
 
     std::pmr::unordered_map<UserID, std::weak_ptr<User>>
                                 m_user_map;
-    mutable std::shared_mutex   m_user_map_mutex;
+    mutable profiled_shared_mutex m_user_map_mutex{"TCPRoomImpl::m_user_map_mutex"};
 };
 
 void TCPRoomImplDeleter::operator()(TCPRoomImpl* mem_pointer) noexcept
@@ -49,7 +51,7 @@ TCPRoom::~TCPRoom() noexcept = default;
 
 void TCPRoom::joinRoom(UserID user_id)
 {
-    std::unique_lock<std::shared_mutex> lock(m_impl->m_user_map_mutex);
+    std::unique_lock<profiled_shared_mutex> lock(m_impl->m_user_map_mutex);
     if (m_impl->m_user_map.find(user_id) != m_impl->m_user_map.cend())
         return;
 
@@ -58,13 +60,13 @@ void TCPRoom::joinRoom(UserID user_id)
 
 bool TCPRoom::hasUser(UserID user_id) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_user_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_user_map_mutex);
     return m_impl->m_user_map.find(user_id) != m_impl->m_user_map.cend();
 }
 
 void TCPRoom::leaveRoom(UserID user_id)
 {
-    std::unique_lock<std::shared_mutex> lock(m_impl->m_user_map_mutex);
+    std::unique_lock<profiled_shared_mutex> lock(m_impl->m_user_map_mutex);
     auto iter = m_impl->m_user_map.find(user_id);
     if (iter == m_impl->m_user_map.cend())
         return;
@@ -74,20 +76,30 @@ void TCPRoom::leaveRoom(UserID user_id)
 
 void TCPRoom::sendData(std::string_view data)
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_user_map_mutex);
+    sendFrame(std::make_shared<const std::string>(data));
+}
+
+void TCPRoom::sendData(std::string_view data, UserID user_id)
+{
+    sendFrame(std::make_shared<const std::string>(data), user_id);
+}
+
+void TCPRoom::sendFrame(const std::shared_ptr<const std::string>& frame)
+{
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_user_map_mutex);
 
     for (const auto& [user_id, user_ptr]: std::as_const(m_impl->m_user_map)) {
-        if (!user_ptr.expired())
-            user_ptr.lock()->notifyAll(data);
+        if (auto user = user_ptr.lock())
+            user->notifyAll(frame);
     }
 }
 
-void TCPRoom::sendData(std::string_view data, UserID user_id)
+void TCPRoom::sendFrame(const std::shared_ptr<const std::string>& frame, UserID user_id)
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_user_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_user_map_mutex);
     if (m_impl->m_user_map.find(user_id) == m_impl->m_user_map.cend())
         throw std::logic_error("User id not in room.");
-    serverManager.getUser(user_id)->notifyAll(data);
+    serverManager.getUser(user_id)->notifyAll(frame);
 }
 
 /*
@@ -104,11 +116,11 @@ struct KCPRoomImpl
 
     std::pmr::unordered_map<UserID, std::weak_ptr<User>>
                                 m_user_map;
-    mutable std::shared_mutex   m_user_map_mutex;
+    mutable profiled_shared_mutex m_user_map_mutex{"KCPRoomImpl::m_user_map_mutex"};
 
     std::pmr::unordered_set<std::shared_ptr<KCPSocket>>
                                 m_socket_map;
-    mutable std::shared_mutex   m_socket_map_mutex;
+    mutable profiled_shared_mutex m_socket_map_mutex{"KCPRoomImpl::m_socket_map_mutex"};
 };
 
 KCPRoom::KCPRoom(std::pmr::memory_resource *mr):
@@ -127,7 +139,7 @@ KCPRoom::~KCPRoom() noexcept = default;
 
 void KCPRoom::joinRoom(UserID user_id)
 {
-    std::unique_lock<std::shared_mutex> lock(m_impl->m_user_map_mutex);
+    std::unique_lock<profiled_shared_mutex> lock(m_impl->m_user_map_mutex);
     if (m_impl->m_user_map.find(user_id) != m_impl->m_user_map.cend())
         return;
 
@@ -136,13 +148,13 @@ void KCPRoom::joinRoom(UserID user_id)
 
 bool KCPRoom::hasUser(UserID user_id) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_user_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_user_map_mutex);
     return m_impl->m_user_map.find(user_id) != m_impl->m_user_map.cend();
 }
 
 void KCPRoom::leaveRoom(UserID user_id)
 {
-    std::unique_lock<std::shared_mutex> lock(m_impl->m_user_map_mutex);
+    std::unique_lock<profiled_shared_mutex> lock(m_impl->m_user_map_mutex);
     auto iter = m_impl->m_user_map.find(user_id);
     if (iter == m_impl->m_user_map.cend())
         return;
@@ -152,19 +164,19 @@ void KCPRoom::leaveRoom(UserID user_id)
 
 void KCPRoom::addSocket(const std::shared_ptr<KCPSocket> &socket)
 {
-    std::lock_guard<std::shared_mutex> lock(m_impl->m_socket_map_mutex);
+    std::lock_guard<profiled_shared_mutex> lock(m_impl->m_socket_map_mutex);
     m_impl->m_socket_map.emplace(socket);
 }
 
 bool KCPRoom::hasSocket(const std::shared_ptr<KCPSocket> &socket) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_socket_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_socket_map_mutex);
     return m_impl->m_socket_map.find(socket) != m_impl->m_socket_map.cend();
 }
 
 void KCPRoom::removeSocket(const std::shared_ptr<KCPSocket> &socket)
 {
-    std::lock_guard<std::shared_mutex> lock(m_impl->m_socket_map_mutex);
+    std::lock_guard<profiled_shared_mutex> lock(m_impl->m_socket_map_mutex);
     auto iter = m_impl->m_socket_map.find(socket);
     if (iter != m_impl->m_socket_map.end())
         m_impl->m_socket_map.erase(iter);
@@ -172,7 +184,7 @@ void KCPRoom::removeSocket(const std::shared_ptr<KCPSocket> &socket)
 
 void KCPRoom::sendData(std::string_view data)
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_socket_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_socket_map_mutex);
     for (const auto& socket: std::as_const(m_impl->m_socket_map)) {
         socket->async_write_some(asio::buffer(data), [](auto, auto){});
     }
@@ -190,16 +202,16 @@ void KCPRoom::sendData(std::string_view data, UserID user_id)
 
 void TextDataRoom::sendData(std::string_view data)
 {
-    auto package = DataPackage::makePackage(data);
-    package->type = DataPackage::Text;
-    TCPRoom::sendData(package->packageToString());
+    JsonStreamWriter writer;
+    writer.raw(data);
+    sendFrame(writer.finishShared(DataPackage::Text));
 }
 
 void TextDataRoom::sendData(std::string_view data, UserID user_id)
 {
-    auto package = DataPackage::makePackage(data);
-    package->type = DataPackage::Text;
-    TCPRoom::sendData(package->packageToString(), user_id);
+    JsonStreamWriter writer;
+    writer.raw(data);
+    sendFrame(writer.finishShared(DataPackage::Text), user_id);
 }
 
 } // namespace qls
@@ -71,6 +71,13 @@ public:
     virtual void sendData(std::string_view data);
     virtual void sendData(std::string_view data, UserID user_id);
 
+    /**
+     * @brief Sends a data package to every user, all the writes share the same buffer.
+     * @param frame Data package in network byte order, e.g. from JsonStreamWriter::finishShared()
+     */
+    void sendFrame(const std::shared_ptr<const std::string>& frame);
+    void sendFrame(const std::shared_ptr<const std::string>& frame, UserID user_id);
+
 private:
     std::unique_ptr<TCPRoomImpl, TCPRoomImplDeleter> m_impl;
 };
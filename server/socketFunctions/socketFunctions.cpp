@@ -1,8 +1,16 @@
 #include "socketFunctions.h"
 
 #include <asio/experimental/awaitable_operators.hpp>
+#include <asio/experimental/concurrent_channel.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <optional>
 #include <system_error>
+#include <utility>
+#include <vector>
 #include <logger.hpp>
+#include <eventLog.h>
 #include <Json.h>
 
 #include "userid.hpp"
@@ -10,9 +18,15 @@
 #include "manager.h"
 #include "returnStateMessage.hpp"
 #include "JsonMsgProcess.h"
+#include "JsonMsgProcessCommand.h"
 #include "qls_error.h"
+#include "jsonStreamWriter.h"
+#include "binaryCodec.h"
+#include "lzCodec.h"
+#include "networkEndianness.hpp"
 
 extern Log::Logger serverLogger;
+extern Log::EventLogger serverEventLogger;
 extern qls::Manager serverManager;
 
 // SocketService
@@ -20,20 +34,61 @@ namespace qls
 {
 struct SocketServiceImpl
 {
+    using signal_channel = asio::experimental::concurrent_channel<void(std::error_code)>;
+
+    SocketServiceImpl(std::shared_ptr<Connection> connection_ptr):
+        m_connection_ptr(connection_ptr),
+        m_jsonProcess(UserID(-1)),
+        m_finished_channel(connection_ptr ? connection_ptr->strand :
+            throw std::system_error(qls::qls_errc::null_socket_pointer), 1),
+        m_write_lock(connection_ptr->strand, 1) {}
+
     // socket ptr
     std::shared_ptr<Connection> m_connection_ptr;
     // JsonMsgProcess
     JsonMessageProcess      m_jsonProcess;
     // package
     qls::Package            m_package;
+
+    // Number of requests in flight
+    std::atomic<std::size_t> m_in_flight = 0;
+    // Maximum number of requests in flight
+    std::atomic<std::size_t> m_pipeline_limit = 1;
+    // Whether binary encoded requests are accepted
+    std::atomic<bool>       m_binary_encoding = false;
+    // Payload size from which replies are compressed, 0 if disabled
+    std::atomic<std::size_t> m_compression_threshold = 0;
+    // Whether replies larger than max_send_frame_size are fragmented
+    std::atomic<bool>       m_fragmentation = false;
+    // Created on the first compressed reply, only used on the strand
+    std::unique_ptr<LzCompressor> m_compressor;
+    // Downloads whose reply hasn't been written yet, only used on the strand
+    std::vector<std::pair<std::shared_ptr<MappedFile>, long long>> m_queued_files;
+    // Time from which the next chunk of any download may be sent, only used on the strand
+    std::chrono::steady_clock::time_point m_next_file_chunk_time;
+    // Signaled whenever a pipelined request finishes
+    signal_channel          m_finished_channel;
+    // Only one write can be in progress on the ssl stream
+    signal_channel          m_write_lock;
+
+    /**
+    * @brief Wait until the number of requests in flight drops below the limit
+    */
+    asio::awaitable<void> waitInFlight(std::size_t limit)
+    {
+        while (m_in_flight >= limit)
+            co_await m_finished_channel.async_receive(asio::use_awaitable);
+    }
+
+    void finishRequest()
+    {
+        --m_in_flight;
+        m_finished_channel.try_send(std::error_code{});
+    }
 };
 
 SocketService::SocketService(std::shared_ptr<Connection> connection_ptr) :
-    m_impl(std::make_unique<SocketServiceImpl>(connection_ptr, UserID(-1)))
-{
-    if (!connection_ptr)
-        throw std::system_error(qls::qls_errc::null_socket_pointer);
-}
+    m_impl(std::make_unique<SocketServiceImpl>(connection_ptr)) {}
 
 SocketService::~SocketService() noexcept = default;
 
@@ -42,61 +97,310 @@ std::shared_ptr<Connection> SocketService::get_connection_ptr() const
     return m_impl->m_connection_ptr;
 }
 
+std::size_t SocketService::setPipelineLimit(std::size_t limit)
+{
+    limit = std::clamp<std::size_t>(limit, 1, max_pipeline_limit);
+    m_impl->m_pipeline_limit = limit;
+    return limit;
+}
+
+std::size_t SocketService::getPipelineLimit() const
+{
+    return m_impl->m_pipeline_limit;
+}
+
+void SocketService::setBinaryEncoding(bool enabled)
+{
+    m_impl->m_binary_encoding = enabled;
+}
+
+bool SocketService::isBinaryEncoding() const
+{
+    return m_impl->m_binary_encoding;
+}
+
+std::size_t SocketService::setCompressionThreshold(std::size_t threshold)
+{
+    if (threshold)
+        threshold = std::max(threshold, min_compression_threshold);
+    m_impl->m_compression_threshold = threshold;
+    return threshold;
+}
+
+std::size_t SocketService::getCompressionThreshold() const
+{
+    return m_impl->m_compression_threshold;
+}
+
+void SocketService::setFragmentation(bool enabled)
+{
+    m_impl->m_fragmentation = enabled;
+}
+
+bool SocketService::isFragmentation() const
+{
+    return m_impl->m_fragmentation;
+}
+
+void SocketService::sendFile(std::shared_ptr<MappedFile> file, long long file_id)
+{
+    m_impl->m_queued_files.emplace_back(std::move(file), file_id);
+}
+
+void SocketService::startQueuedFiles()
+{
+    for (auto& [file, file_id]: std::exchange(m_impl->m_queued_files, {})) {
+        asio::co_spawn(m_impl->m_connection_ptr->strand,
+            async_send_file(std::move(file), file_id),
+            [self = shared_from_this()](std::exception_ptr exception) {
+                if (!exception)
+                    return;
+                try {
+                    std::rethrow_exception(exception);
+                } catch (const std::exception& e) {
+                    serverLogger.error(std::string(e.what()));
+                } catch (...) {}
+            });
+    }
+}
+
+asio::awaitable<void> SocketService::async_send_file(std::shared_ptr<MappedFile> file, long long file_id)
+{
+    using namespace std::chrono;
+    // Keep the connection alive until the file is sent
+    auto self = shared_from_this();
+    const std::string_view content = file->getData();
+    const auto chunk_interval = duration_cast<steady_clock::duration>(
+        duration<double>(double(file_chunk_size) / file_bandwidth_share));
+    asio::steady_timer timer(m_impl->m_connection_ptr->strand);
+
+    std::size_t offset = 0;
+    do {
+        // The downloads of a connection share one schedule, so together they
+        // send no more than file_bandwidth_share
+        auto now = steady_clock::now();
+        auto send_time = std::max(m_impl->m_next_file_chunk_time, now);
+        m_impl->m_next_file_chunk_time = send_time + chunk_interval;
+        if (send_time > now) {
+            timer.expires_at(send_time);
+            co_await timer.async_wait(asio::use_awaitable);
+        }
+
+        std::string_view chunk = content.substr(offset, file_chunk_size);
+        // The chunk is copied from the page cache straight into the send buffer
+        std::string frame = acquireSendBuffer();
+        frame.resize(sizeof(DataPackage) + sizeof(long long) + chunk.size());
+        DataPackage::writeHeader(frame.data(), static_cast<int>(frame.size()),
+            DataPackage::FileStream, file_id);
+        long long network_offset = swapNetworkEndianness(static_cast<long long>(offset));
+        std::memcpy(frame.data() + sizeof(DataPackage), &network_offset, sizeof(long long));
+        std::memcpy(frame.data() + sizeof(DataPackage) + sizeof(long long), chunk.data(), chunk.size());
+        // The write lock is taken per chunk, so replies are written between the chunks
+        co_await async_write_frame(std::move(frame));
+        offset += chunk.size();
+    } while (offset < content.size());
+}
+
+asio::awaitable<std::size_t> SocketService::async_send(std::string frame)
+{
+    // Compress bulk replies if the connection asked for it
+    if (std::size_t threshold = m_impl->m_compression_threshold;
+        threshold && frame.size() - sizeof(DataPackage) >= threshold) {
+        if (!m_impl->m_compressor)
+            m_impl->m_compressor = std::make_unique<LzCompressor>();
+        if (std::string compressed = DataPackage::compressFrame(frame, *m_impl->m_compressor);
+            !compressed.empty()) {
+            releaseSendBuffer(std::move(frame));
+            frame = std::move(compressed);
+        }
+    }
+
+    // Clients of the old protocol treat every data package as a whole message
+    if (m_impl->m_fragmentation && frame.size() > max_send_frame_size) {
+        // Other replies can be written between the fragments
+        std::vector<std::string> fragments = DataPackage::splitFrame(frame, max_send_frame_size);
+        releaseSendBuffer(std::move(frame));
+        std::size_t size = 0;
+        for (auto& fragment: fragments)
+            size += co_await async_write_frame(std::move(fragment));
+        co_return size;
+    }
+    co_return co_await async_write_frame(std::move(frame));
+}
+
+asio::awaitable<std::size_t> SocketService::async_write_frame(std::string frame)
+{
+    // Replies of pipelined requests may finish at the same time
+    co_await m_impl->m_write_lock.async_send(std::error_code{}, asio::use_awaitable);
+    std::size_t size = 0;
+    std::exception_ptr exception;
+    try {
+        // Send data to the connection
+        size = co_await asio::async_write(m_impl->m_connection_ptr->socket,
+            asio::buffer(frame),
+            asio::bind_executor(m_impl->m_connection_ptr->strand, asio::use_awaitable));
+    } catch (...) {
+        exception = std::current_exception();
+    }
+    m_impl->m_write_lock.try_receive([](std::error_code) {});
+    releaseSendBuffer(std::move(frame));
+    if (exception)
+        std::rethrow_exception(exception);
+    co_return size;
+}
+
+asio::awaitable<std::size_t> SocketService::async_send_error(std::string_view msg, long long requestID)
+{
+    JsonStreamWriter writer;
+    writer.message("error", msg);
+    co_return co_await async_send(writer.finish(DataPackage::Text, requestID));
+}
+
+asio::awaitable<void> SocketService::processText(LazyJsonDocument document, long long requestID)
+{
+    qjson::JObject result = co_await m_impl->m_jsonProcess.processJsonMessage(document.root(), *this);
+    // Serialize the reply straight into the send buffer
+    JsonStreamWriter writer;
+    writer.value(result);
+    co_await async_send(writer.finish(DataPackage::Text, requestID));
+}
+
+asio::awaitable<void> SocketService::processBinary(qjson::JObject json, long long requestID)
+{
+    qjson::JObject result = co_await m_impl->m_jsonProcess.processJsonMessage(json, *this);
+    co_await async_send(makeBinaryFrame(result, requestID));
+}
+
+asio::awaitable<void> SocketService::processFileStream(std::string_view data, long long requestID)
+{
+    if (data.size() < sizeof(long long)) {
+        co_await async_send_error("The data body must start with the offset!", requestID);
+        co_return;
+    }
+    long long offset = 0;
+    std::memcpy(&offset, data.data(), sizeof(long long));
+    offset = swapNetworkEndianness(offset);
+
+    const long long file_size = offset + static_cast<long long>(data.size() - sizeof(long long));
+    std::optional<qjson::JObject> result;
+    std::string error;
+    try {
+        // Chunks are not acknowledged one by one, only the complete upload
+        if (!serverManager.getServerFileTransferManager().writeUploadChunk(
+                requestID, m_impl->m_jsonProcess.getLocalUserID(), offset, data.substr(sizeof(long long))))
+            co_return;
+        // If the server is busy, the client finishes the upload with an empty chunk at its end
+        result = co_await m_impl->m_jsonProcess.finishUpload(requestID, *this);
+    } catch (const std::system_error& e) {
+        error = e.code().message();
+    }
+    if (!error.empty()) {
+        // The client resumes from get_file_upload_offset
+        co_await async_send_error(error, requestID);
+        co_return;
+    }
+    // A busy server replies without a file ID
+    const qjson::dict_t& reply = result->getDict();
+    if (auto iter = reply.find("file_id"); iter != reply.cend())
+        serverEventLogger.log(Log::EventID::FileUploaded, m_impl->m_jsonProcess.getLocalUserID(),
+            iter->second.getInt(), file_size);
+
+    JsonStreamWriter writer;
+    writer.value(*result);
+    co_await async_send(writer.finish(DataPackage::Text, requestID));
+}
+
+asio::awaitable<void> SocketService::schedule(int ordering_type, asio::awaitable<void> request)
+{
+    if (m_impl->m_pipeline_limit == 1 || ordering_type == JsonMessageCommand::SequentialOrder) {
+        // Wait for the requests in flight, the later ones wait for this one
+        co_await m_impl->waitInFlight(1);
+        co_await std::move(request);
+        // download_file is sequential, so the chunks follow the reply that carries the size
+        startQueuedFiles();
+        co_return;
+    }
+
+    // Run the request concurrently once there is a free slot
+    co_await m_impl->waitInFlight(m_impl->m_pipeline_limit);
+    ++m_impl->m_in_flight;
+    asio::co_spawn(m_impl->m_connection_ptr->strand,
+        std::move(request),
+        [self = shared_from_this()](std::exception_ptr exception) {
+            self->m_impl->finishRequest();
+            if (!exception)
+                return;
+            try {
+                std::rethrow_exception(exception);
+            } catch (const std::exception& e) {
+                serverLogger.error(std::string(e.what()));
+            } catch (...) {}
+            // Let the reading loop clean the connection up
+            std::error_code ec;
+            self->m_impl->m_connection_ptr->socket.lowest_layer().close(ec);
+        });
+}
+
 asio::awaitable<void> SocketService::process(
     std::string_view data,
     std::shared_ptr<qls::DataPackage> pack)
 {
-    auto async_send = [this](
-        std::string_view data,
-        long long requestID = 0,
-        DataPackage::DataPackageType type = DataPackage::Unknown,
-        int sequence = 0,
-        int sequenceSize = 1) -> asio::awaitable<std::size_t> {
-            std::string out(data);
-            auto pack = qls::DataPackage::makePackage(out);
-            pack->requestID = requestID;
-            pack->sequence = sequence;
-            pack->type = type;
-            // Send data to the connection
-            co_return co_await asio::async_write(m_impl->m_connection_ptr->socket,
-                asio::buffer(pack->packageToString()),
-                asio::bind_executor(m_impl->m_connection_ptr->strand, asio::use_awaitable));
-    };
-
     // Check whether the user was logged in
     if (m_impl->m_jsonProcess.getLocalUserID() == -1ll &&
-        pack->type != DataPackage::Text) {
-        co_await async_send(
-            qjson::JWriter::fastWrite(makeErrorMessage("You haven't logged in!")),
-            pack->requestID,
-            DataPackage::Text);
+        pack->type != DataPackage::Text &&
+        !(pack->type == DataPackage::Binary && m_impl->m_binary_encoding)) {
+        co_await m_impl->waitInFlight(1);
+        co_await async_send_error("You haven't logged in!", pack->requestID);
         co_return;
     }
 
     // Check the type of the data pack
     switch (pack->type) {
-    case DataPackage::Text:
-        // json data type
-        co_await async_send(qjson::JWriter::fastWrite(
-                co_await m_impl->m_jsonProcess.processJsonMessage(
-                    qjson::JParser::fastParse(data), *this)),
-            pack->requestID,
-            DataPackage::Text);
+    case DataPackage::Text: {
+        // json data type, only the structure is indexed here
+        std::optional<LazyJsonDocument> document;
+        try {
+            document.emplace(std::string(data));
+        } catch (const std::system_error&) {}
+        if (!document) {
+            co_await m_impl->waitInFlight(1);
+            co_await async_send_error("The data body must be valid json!", pack->requestID);
+            co_return;
+        }
+        int ordering_type = JsonMessageProcess::getOrderingType(document->root());
+        co_await schedule(ordering_type, processText(std::move(*document), pack->requestID));
         co_return;
+    }
     case DataPackage::FileStream:
-        // file stream type
-        co_await async_send(qjson::JWriter::fastWrite(makeErrorMessage("Error type")),
-            pack->requestID, DataPackage::Text); // Temporarily return an error
+        // file stream type, a chunk of an upload
+        co_await m_impl->waitInFlight(1);
+        co_await processFileStream(data, pack->requestID);
         co_return;
-    case DataPackage::Binary:
-        // binary stream type
-        co_await async_send(qjson::JWriter::fastWrite(makeErrorMessage("Error type")),
-            pack->requestID, DataPackage::Text); // Temporarily return an error
+    case DataPackage::Binary: {
+        // binary encoded request, it must be negotiated with set_encoding first
+        if (!m_impl->m_binary_encoding) {
+            co_await m_impl->waitInFlight(1);
+            co_await async_send_error("Binary encoding hasn't been negotiated!", pack->requestID);
+            co_return;
+        }
+        std::optional<qjson::JObject> json;
+        try {
+            json.emplace(decodeBinaryJson(data));
+        } catch (const std::system_error&) {}
+        if (!json) {
+            co_await m_impl->waitInFlight(1);
+            co_await async_send(makeBinaryFrame(
+                makeErrorMessage("The data body must be valid binary encoding!"), pack->requestID));
+            co_return;
+        }
+        int ordering_type = JsonMessageProcess::getOrderingType(*json);
+        co_await schedule(ordering_type, processBinary(std::move(*json), pack->requestID));
         co_return;
+    }
     default:
         // unknown type
-        co_await async_send(qjson::JWriter::fastWrite(makeErrorMessage("Error type")),
-            pack->requestID, DataPackage::Text);
+        co_await m_impl->waitInFlight(1);
+        co_await async_send_error("Error type", pack->requestID);
         co_return;
     }
     co_return;
@@ -6,21 +6,36 @@
 #include <shared_mutex>
 #include <atomic>
 #include <memory>
+#include <Json.h>
 
 #include "dataPackage.h"
 #include "package.h"
 #include "network.h"
 #include "socket.h"
 #include "connection.hpp"
+#include "lazyJson.h"
+#include "mappedFile.h"
 
 namespace qls
 {
 
 struct SocketServiceImpl;
 
-class SocketService final
+class SocketService final: public std::enable_shared_from_this<SocketService>
 {
 public:
+    /// Maximum number of requests that a connection can keep in flight
+    static constexpr std::size_t max_pipeline_limit = 32;
+    /// Smallest payload that is worth compressing
+    static constexpr std::size_t min_compression_threshold = 256;
+    /// Larger replies are sent in fragments if the connection asked for it,
+    /// so they don't hold up the other replies
+    static constexpr std::size_t max_send_frame_size = 64 * 1024;
+    /// Size of the file content in a FileStream data package
+    static constexpr std::size_t file_chunk_size = 32 * 1024;
+    /// Bytes per second a connection may spend on downloads, the rest is left to chat
+    static constexpr std::size_t file_bandwidth_share = 4 * 1024 * 1024;
+
     SocketService(std::shared_ptr<Connection> connection_ptr);
     ~SocketService() noexcept;
 
@@ -40,7 +55,128 @@ public:
         std::string_view data,
         std::shared_ptr<qls::DataPackage> pack);
 
+    /**
+    * @brief Set how many requests of this connection can be processed at the same time.
+    *        Replies of concurrent requests are sent as soon as they finish,
+    *        tagged with the requestID of the request.
+    * @param limit Requested limit, clamped to [1, max_pipeline_limit]
+    * @return The limit in effect
+    */
+    std::size_t setPipelineLimit(std::size_t limit);
+
+    /**
+    * @brief Get how many requests of this connection can be processed at the same time
+    */
+    std::size_t getPipelineLimit() const;
+
+    /**
+    * @brief Set whether the connection may send requests as binary data packages.
+    *        Binary requests are replied in the binary encoding as well.
+    * @param enabled Whether the binary encoding is enabled
+    */
+    void setBinaryEncoding(bool enabled);
+
+    /**
+    * @brief Get whether the connection may send requests as binary data packages
+    */
+    bool isBinaryEncoding() const;
+
+    /**
+    * @brief Set the payload size from which replies of this connection are compressed.
+    *        Compressed data packages have DataPackage::compressed_flag set in their type.
+    * @param threshold Payload size in bytes, 0 disables compression,
+    *        other values are raised to min_compression_threshold
+    * @return The threshold in effect
+    */
+    std::size_t setCompressionThreshold(std::size_t threshold);
+
+    /**
+    * @brief Get the payload size from which replies are compressed, 0 if disabled
+    */
+    std::size_t getCompressionThreshold() const;
+
+    /**
+    * @brief Set whether replies larger than max_send_frame_size are split into
+    *        fragments numbered by sequence and sequenceSize. Clients that don't
+    *        enable it get every reply in one data package.
+    * @param enabled Whether reply fragmentation is enabled
+    */
+    void setFragmentation(bool enabled);
+
+    /**
+    * @brief Get whether large replies are split into fragments
+    */
+    bool isFragmentation() const;
+
+    /**
+    * @brief Send a stored file to the connection in FileStream data packages once
+    *        the reply of the current request was written, the request must be sequential.
+    *        Each package has the file ID as requestID and its data is the offset
+    *        of the chunk (8 bytes, network byte order) followed by the chunk.
+    * @param file Mapped file to send
+    * @param file_id ID of the file
+    */
+    void sendFile(std::shared_ptr<MappedFile> file, long long file_id);
+
 private:
+    /**
+    * @brief Process a json request and send the reply
+    * @param document Indexed json request, decoded lazily by the command
+    * @param requestID ID of the request
+    */
+    asio::awaitable<void> processText(LazyJsonDocument document, long long requestID);
+
+    /**
+    * @brief Process a binary encoded request and send the reply in the same encoding
+    * @param json Decoded request
+    * @param requestID ID of the request
+    */
+    asio::awaitable<void> processBinary(qjson::JObject json, long long requestID);
+
+    /**
+    * @brief Run a request in order or together with the other requests in flight
+    * @param ordering_type JsonMessageCommand::OrderingType of the request
+    * @param request Coroutine that processes the request and sends the reply
+    */
+    asio::awaitable<void> schedule(int ordering_type, asio::awaitable<void> request);
+
+    /**
+    * @brief Start sending the files queued by sendFile()
+    */
+    void startQueuedFiles();
+
+    /**
+    * @brief Store a chunk of an upload, the data is the offset of the chunk
+    *        (8 bytes, network byte order) followed by the chunk
+    * @param data Data of the FileStream data package
+    * @param requestID ID of the upload
+    */
+    asio::awaitable<void> processFileStream(std::string_view data, long long requestID);
+
+    /**
+    * @brief Send a file chunk by chunk, all the downloads of the connection
+    *        together are limited to file_bandwidth_share
+    */
+    asio::awaitable<void> async_send_file(std::shared_ptr<MappedFile> file, long long file_id);
+
+    /**
+    * @brief Send a data package to the connection, compressed and fragmented
+    *        if the connection enabled it
+    * @param frame Data package in network byte order, e.g. from JsonStreamWriter::finish()
+    */
+    asio::awaitable<std::size_t> async_send(std::string frame);
+
+    /**
+    * @brief Write a data package to the connection, writes are serialized
+    * @param frame Data package in network byte order
+    */
+    asio::awaitable<std::size_t> async_write_frame(std::string frame);
+
+    /**
+    * @brief Send {"state": "error", "message": msg} to the connection
+    */
+    asio::awaitable<std::size_t> async_send_error(std::string_view msg, long long requestID);
+
     std::unique_ptr<SocketServiceImpl> m_impl;
 };
 
@@ -0,0 +1,273 @@
+#include "timingWheel.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace qls
+{
+
+/// Bits of the tick that index the first level
+static constexpr int root_bits = 8;
+/// Bits of the tick that index each of the upper levels
+static constexpr int level_bits = 6;
+static constexpr int upper_levels = 3;
+static constexpr std::size_t root_size = std::size_t(1) << root_bits;
+static constexpr std::size_t level_size = std::size_t(1) << level_bits;
+/// Timers further away are kept in the last slot until they come closer
+static constexpr std::uint64_t max_ticks =
+    std::uint64_t(1) << (root_bits + level_bits * upper_levels);
+
+struct alignas(64) TimingWheelShard
+{
+    TimingWheelShard(TimingWheel::clock::time_point start):
+        m_start(start) {}
+
+    /**
+     * @brief Converts a time point to the first tick at or after it.
+     */
+    std::uint64_t toTick(TimingWheel::clock::time_point time) const noexcept
+    {
+        if (time <= m_start)
+            return 0;
+        auto ticks = (time - m_start + TimingWheel::tick_duration - TimingWheel::clock::duration(1)) /
+            TimingWheel::tick_duration;
+        return static_cast<std::uint64_t>(ticks);
+    }
+
+    /**
+     * @brief Puts a timer into the slot of its expiry, the lock must be held.
+     */
+    void link(WheelTimer* timer) noexcept
+    {
+        std::uint64_t expiry = std::max(timer->m_expiry, m_current);
+        std::uint64_t delta = expiry - m_current;
+        WheelTimer** slot;
+        if (delta < root_size) {
+            slot = &m_root[expiry & (root_size - 1)];
+        } else {
+            int level = 0;
+            while (level < upper_levels - 1 &&
+                delta >= (std::uint64_t(1) << (root_bits + level_bits * (level + 1))))
+                ++level;
+            if (delta >= max_ticks)
+                expiry = m_current + max_ticks - 1;
+            slot = &m_levels[level][(expiry >> (root_bits + level_bits * level)) & (level_size - 1)];
+        }
+
+        timer->m_slot = slot;
+        timer->m_prev = nullptr;
+        timer->m_next = *slot;
+        if (*slot)
+            (*slot)->m_prev = timer;
+        *slot = timer;
+        ++m_count;
+    }
+
+    /**
+     * @brief Takes a timer out of its slot, the lock must be held.
+     * @return Whether the timer was scheduled
+     */
+    bool unlink(WheelTimer* timer) noexcept
+    {
+        if (!timer->m_slot)
+            return false;
+        if (timer->m_prev)
+            timer->m_prev->m_next = timer->m_next;
+        else
+            *timer->m_slot = timer->m_next;
+        if (timer->m_next)
+            timer->m_next->m_prev = timer->m_prev;
+        timer->m_slot = nullptr;
+        timer->m_prev = timer->m_next = nullptr;
+        --m_count;
+        return true;
+    }
+
+    /**
+     * @brief Moves the timers of an upper slot down to the levels below.
+     * @return Index of the slot, 0 means the next level must be cascaded too
+     */
+    std::size_t cascade(int level) noexcept
+    {
+        std::size_t index = (m_current >> (root_bits + level_bits * level)) & (level_size - 1);
+        WheelTimer* timer = m_levels[level][index];
+        m_levels[level][index] = nullptr;
+        while (timer) {
+            WheelTimer* next = timer->m_next;
+            timer->m_slot = nullptr;
+            --m_count;
+            link(timer);
+            timer = next;
+        }
+        return index;
+    }
+
+    /**
+     * @brief Turns the shard up to a tick, the lock must be held.
+     * @param expired Receives the timers that expired, marked as firing
+     */
+    void advance(std::uint64_t tick, std::vector<WheelTimer*>& expired)
+    {
+        while (m_current <= tick) {
+            std::size_t index = m_current & (root_size - 1);
+            if (index == 0) {
+                for (int level = 0; level < upper_levels && cascade(level) == 0; ++level) {}
+            }
+
+            WheelTimer* timer = m_root[index];
+            m_root[index] = nullptr;
+            while (timer) {
+                WheelTimer* next = timer->m_next;
+                timer->m_slot = nullptr;
+                timer->m_prev = timer->m_next = nullptr;
+                timer->m_firing = true;
+                timer->m_firing_thread = std::this_thread::get_id();
+                --m_count;
+                expired.push_back(timer);
+                timer = next;
+            }
+            ++m_current;
+        }
+    }
+
+    const TimingWheel::clock::time_point    m_start;
+    adaptive_mutex                          m_mutex{"timing wheel"};
+    std::uint64_t                           m_current = 0;  ///< Next tick to expire
+    std::size_t                             m_count = 0;    ///< Number of scheduled timers
+    WheelTimer*                             m_root[root_size] = {};
+    WheelTimer*                             m_levels[upper_levels][level_size] = {};
+};
+
+struct TimingWheelImpl
+{
+    TimingWheelImpl(std::size_t shard_num):
+        m_start(TimingWheel::clock::now())
+    {
+        shard_num = shard_num ? shard_num :
+            std::max<std::size_t>(1, std::thread::hardware_concurrency());
+        for (std::size_t i = 0; i < shard_num; ++i)
+            m_shards.emplace_back(std::make_unique<TimingWheelShard>(m_start));
+    }
+
+    const TimingWheel::clock::time_point            m_start;
+    std::vector<std::unique_ptr<TimingWheelShard>>  m_shards;
+    std::atomic<std::size_t>                        m_next_shard = 0; ///< Round robin index for new timers
+    std::atomic<bool>                               m_is_running = false;
+    std::vector<WheelTimer*>                        m_expired; ///< Only used by advance()
+};
+
+TimingWheel::TimingWheel(std::size_t shard_num):
+    m_impl(std::make_unique<TimingWheelImpl>(shard_num)) {}
+
+TimingWheel::~TimingWheel() noexcept = default;
+
+asio::awaitable<void> TimingWheel::auto_tick()
+{
+    m_impl->m_is_running = true;
+    asio::steady_timer timer(co_await asio::this_coro::executor);
+    auto next_time = clock::now();
+    while (m_impl->m_is_running) {
+        advance(clock::now());
+        // Ticks are counted from the start of the wheel, so a late wake-up doesn't drift
+        next_time += tick_duration;
+        timer.expires_at(std::max(next_time, clock::now()));
+        std::error_code ec;
+        co_await timer.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    }
+}
+
+void TimingWheel::stop()
+{
+    m_impl->m_is_running = false;
+}
+
+std::size_t TimingWheel::advance(clock::time_point now)
+{
+    std::size_t expired_count = 0;
+    for (auto& shard_ptr: m_impl->m_shards) {
+        TimingWheelShard& shard = *shard_ptr;
+        std::vector<WheelTimer*>& expired = m_impl->m_expired;
+        {
+            std::lock_guard<adaptive_mutex> lock(shard.m_mutex);
+            // The tick that contains now has not passed yet
+            std::uint64_t tick = shard.toTick(now);
+            if (tick == 0)
+                continue;
+            shard.advance(tick - 1, expired);
+        }
+
+        // Callbacks run without the lock, so they can reschedule their timer
+        for (WheelTimer* timer: expired) {
+            try {
+                timer->m_callback();
+            } catch (...) {}
+            std::lock_guard<adaptive_mutex> lock(shard.m_mutex);
+            timer->m_firing = false;
+        }
+        expired_count += expired.size();
+        expired.clear();
+    }
+    return expired_count;
+}
+
+std::size_t TimingWheel::getTimerCount() const noexcept
+{
+    std::size_t count = 0;
+    for (auto& shard: m_impl->m_shards) {
+        std::lock_guard<adaptive_mutex> lock(shard->m_mutex);
+        count += shard->m_count;
+    }
+    return count;
+}
+
+WheelTimer::WheelTimer(TimingWheel& wheel) noexcept:
+    m_shard(*wheel.m_impl->m_shards[wheel.m_impl->m_next_shard.fetch_add(1, std::memory_order_relaxed) %
+        wheel.m_impl->m_shards.size()]) {}
+
+WheelTimer::~WheelTimer() noexcept
+{
+    cancel();
+}
+
+std::unique_lock<adaptive_mutex> WheelTimer::lockIdle() noexcept
+{
+    while (true) {
+        std::unique_lock<adaptive_mutex> lock(m_shard.m_mutex);
+        if (!m_firing || m_firing_thread == std::this_thread::get_id())
+            return lock;
+        lock.unlock();
+        std::this_thread::yield();
+    }
+}
+
+void WheelTimer::expires_after(TimingWheel::clock::duration duration, Callback callback)
+{
+    auto lock = lockIdle();
+    m_shard.unlink(this);
+    m_callback = std::move(callback);
+    m_expiry = m_shard.toTick(TimingWheel::clock::now() + duration);
+    m_shard.link(this);
+}
+
+void WheelTimer::expires_after(TimingWheel::clock::duration duration)
+{
+    // Rescheduling doesn't touch the callback, so it needn't wait for it
+    std::lock_guard<adaptive_mutex> lock(m_shard.m_mutex);
+    m_shard.unlink(this);
+    m_expiry = m_shard.toTick(TimingWheel::clock::now() + duration);
+    m_shard.link(this);
+}
+
+bool WheelTimer::cancel() noexcept
+{
+    auto lock = lockIdle();
+    return m_shard.unlink(this);
+}
+
+bool WheelTimer::isScheduled() const noexcept
+{
+    std::lock_guard<adaptive_mutex> lock(m_shard.m_mutex);
+    return m_slot != nullptr;
+}
+
+} // namespace qls
@@ -0,0 +1,149 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "adaptive_mutex.hpp"
+
+namespace qls
+{
+
+struct TimingWheelImpl;
+struct TimingWheelShard;
+class WheelTimer;
+
+/**
+ * @class TimingWheel
+ * @brief Hierarchical timing wheel shared by all the timeouts of the server.
+ *
+ * Timers are intrusive nodes in the slot lists of the wheel, so scheduling,
+ * rescheduling and cancelling a timer are O(1) and don't allocate. The first
+ * level has 256 slots of one tick, the three levels above it have 64 slots each
+ * and their timers are cascaded down as the wheel turns. The wheel is split into
+ * shards with their own lock, a single asio timer turns all of them.
+ */
+class TimingWheel final
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    /// Resolution of the wheel, timers expire at most one tick late
+    static constexpr std::chrono::milliseconds tick_duration{100};
+
+    /**
+     * @brief Constructs the wheel, timers can be scheduled before it runs.
+     * @param shard_num Number of shards, 0 for one per hardware thread
+     */
+    TimingWheel(std::size_t shard_num = 0);
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel(TimingWheel&&) = delete;
+    ~TimingWheel() noexcept;
+
+    TimingWheel& operator=(const TimingWheel&) = delete;
+    TimingWheel& operator=(TimingWheel&&) = delete;
+
+    /**
+     * @brief Turns the wheel every tick until stop() is called.
+     *        The callbacks of the timers are called on this coroutine's executor.
+     */
+    asio::awaitable<void> auto_tick();
+
+    /**
+     * @brief Stops turning the wheel, timers no longer expire.
+     */
+    void stop();
+
+    /**
+     * @brief Expires the timers that are due at a time point,
+     *        called by auto_tick().
+     * @return Number of expired timers
+     */
+    std::size_t advance(clock::time_point now);
+
+    /**
+     * @brief Gets the number of scheduled timers.
+     */
+    [[nodiscard]] std::size_t getTimerCount() const noexcept;
+
+private:
+    friend class WheelTimer;
+
+    std::unique_ptr<TimingWheelImpl> m_impl;
+};
+
+/**
+ * @class WheelTimer
+ * @brief A timer of a TimingWheel.
+ *
+ * The callback is called on the thread that turns the wheel and must be short,
+ * longer work should be posted to an executor. Once cancel() returns or the timer
+ * is destroyed, the callback is neither running on another thread nor called later,
+ * so it may use the object that owns the timer. The timer must not be destroyed
+ * by its own callback.
+ */
+class WheelTimer final
+{
+public:
+    using Callback = std::move_only_function<void()>;
+
+    WheelTimer(TimingWheel& wheel) noexcept;
+    WheelTimer(const WheelTimer&) = delete;
+    WheelTimer(WheelTimer&&) = delete;
+    ~WheelTimer() noexcept;
+
+    WheelTimer& operator=(const WheelTimer&) = delete;
+    WheelTimer& operator=(WheelTimer&&) = delete;
+
+    /**
+     * @brief Sets the callback and schedules the timer, a scheduled timer is rescheduled.
+     *        Must not be called from the timer's own callback.
+     */
+    void expires_after(TimingWheel::clock::duration duration, Callback callback);
+
+    /**
+     * @brief Reschedules the timer with the callback it already has.
+     *        May be called from the timer's own callback.
+     */
+    void expires_after(TimingWheel::clock::duration duration);
+
+    /**
+     * @brief Cancels the timer, waits if its callback is running on another thread.
+     * @return true if the timer was scheduled
+     */
+    bool cancel() noexcept;
+
+    /**
+     * @brief Checks whether the timer is scheduled.
+     */
+    [[nodiscard]] bool isScheduled() const noexcept;
+
+private:
+    friend class TimingWheel;
+    friend struct TimingWheelShard;
+
+    /**
+     * @brief Locks the shard once the callback isn't running on another thread.
+     */
+    std::unique_lock<adaptive_mutex> lockIdle() noexcept;
+
+    TimingWheelShard&   m_shard;
+    // The fields below are guarded by the lock of the shard
+    WheelTimer*         m_prev = nullptr;
+    WheelTimer*         m_next = nullptr;
+    WheelTimer**        m_slot = nullptr;   ///< Head of the slot list the timer is in
+    std::uint64_t       m_expiry = 0;       ///< Tick the timer expires at
+    bool                m_firing = false;   ///< Whether the callback is running
+    std::thread::id     m_firing_thread;    ///< Thread that runs the callback
+    Callback            m_callback;
+};
+
+} // namespace qls
+
+#endif // !TIMING_WHEEL_H
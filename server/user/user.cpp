@@ -9,9 +9,11 @@
 #include "logger.hpp"
 #include "qls_error.h"
 #include "dataPackage.h"
+#include "jsonStreamWriter.h"
 #include "userid.hpp"
 #include "groupid.hpp"
 #include "md_proxy.hpp"
+#include "profiled_shared_mutex.hpp"
 
 extern Log::Logger serverLogger;
 extern qls::Manager serverManager;
@@ -33,31 +35,31 @@ struct UserImpl
     std::string password; ///< User's hashed password
     std::string salt; ///< Salt used in password hashing
 
-    std::shared_mutex   m_data_mutex; ///< Mutex for thread-safe access to user data
+    profiled_shared_mutex m_data_mutex{"UserImpl::m_data_mutex"}; ///< Mutex for thread-safe access to user data
 
     std::unordered_set<UserID>      m_user_friend_map; ///< User's friend list
-    std::shared_mutex               m_user_friend_map_mutex; ///< Mutex for thread-safe access to friend list
+    profiled_shared_mutex           m_user_friend_map_mutex{"UserImpl::m_user_friend_map_mutex"}; ///< Mutex for thread-safe access to friend list
 
     std::unordered_map<UserID, Verification::UserVerification>
                                     m_user_friend_verification_map; ///< User's friend verification map
-    std::shared_mutex               m_user_friend_verification_map_mutex; ///< Mutex for thread-safe access to friend verification map
+    profiled_shared_mutex           m_user_friend_verification_map_mutex{"UserImpl::m_user_friend_verification_map_mutex"}; ///< Mutex for thread-safe access to friend verification map
 
     std::unordered_set<GroupID>     m_user_group_map; ///< User's group list
-    std::shared_mutex               m_user_group_map_mutex; ///< Mutex for thread-safe access to group list
+    profiled_shared_mutex           m_user_group_map_mutex{"UserImpl::m_user_group_map_mutex"}; ///< Mutex for thread-safe access to group list
 
     std::multimap<GroupID, Verification::GroupVerification>
                                     m_user_group_verification_map; ///< User's group verification map
-    std::shared_mutex               m_user_group_verification_map_mutex; ///< Mutex for thread-safe access to group verification map
+    profiled_shared_mutex           m_user_group_verification_map_mutex{"UserImpl::m_user_group_verification_map_mutex"}; ///< Mutex for thread-safe access to group verification map
 
     std::unordered_map<std::shared_ptr<Connection>, DeviceType>
                                     m_connection_map; ///< Map of sockets associated with the user
-    std::shared_mutex               m_connection_map_mutex; ///< Mutex for thread-safe access to socket map
+    profiled_shared_mutex           m_connection_map_mutex{"UserImpl::m_connection_map_mutex"}; ///< Mutex for thread-safe access to socket map
 
     static ossl_proxy               m_ossl_proxy;
 
     bool removeFriend(UserID friend_user_id)
     {
-        std::unique_lock<std::shared_mutex> ul(m_user_friend_map_mutex);
+        std::unique_lock<profiled_shared_mutex> ul(m_user_friend_map_mutex);
         auto iter = m_user_friend_map.find(friend_user_id);
         if (iter == m_user_friend_map.cend())
             return false;
@@ -78,9 +80,10 @@ template<class T>
     requires requires (T json_value) { qjson::JObject(json_value); }
 static inline void sendJsonToUser(qls::UserID user_id, T&& json)
 {
-    auto pack = DataPackage::makePackage(qjson::JWriter::fastWrite(std::forward<T>(json)));
-    pack->type = DataPackage::Text;
-    serverManager.getUser(user_id)->notifyAll(pack->packageToString());
+    JsonStreamWriter writer;
+    const qjson::JObject& json_value = json;
+    writer.value(json_value);
+    serverManager.getUser(user_id)->notifyAll(writer.finishShared(DataPackage::Text));
 }
 
 User::User(UserID user_id, bool is_create):
@@ -104,49 +107,49 @@ User::~User() = default;
 
 UserID User::getUserID() const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_data_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_data_mutex);
     return m_impl->user_id;
 }
 
 std::string User::getUserName() const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_data_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_data_mutex);
     return m_impl->user_name;
 }
 
 long long User::getRegisteredTime() const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_data_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_data_mutex);
     return m_impl->registered_time;
 }
 
 int User::getAge() const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_data_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_data_mutex);
     return m_impl->age;
 }
 
 std::string User::getUserEmail() const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_data_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_data_mutex);
     return m_impl->email;
 }
 std::string User::getUserPhone() const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_data_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_data_mutex);
     return m_impl->phone;
 }
 
 std::string User::getUserProfile() const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_data_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_data_mutex);
     return m_impl->profile;
 }
 
 bool User::isUserPassword(std::string_view password) const
 {
     md_proxy sha512_proxy(m_impl->m_ossl_proxy, "SHA3-512");
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_data_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_data_mutex);
     std::string localPassword = sha512_proxy(password, m_impl->salt);
 
     return localPassword == m_impl->password;
@@ -154,31 +157,31 @@ bool User::isUserPassword(std::string_view password) const
 
 void User::updateUserName(std::string_view user_name)
 {
-    std::unique_lock<std::shared_mutex> lg(m_impl->m_data_mutex);
+    std::unique_lock<profiled_shared_mutex> lg(m_impl->m_data_mutex);
     m_impl->user_name = user_name;
 }
 
 void User::updateAge(int age)
 {
-    std::unique_lock<std::shared_mutex> lg(m_impl->m_data_mutex);
+    std::unique_lock<profiled_shared_mutex> lg(m_impl->m_data_mutex);
     m_impl->age = age;
 }
 
 void User::updateUserEmail(std::string_view email)
 {
-    std::unique_lock<std::shared_mutex> lg(m_impl->m_data_mutex);
+    std::unique_lock<profiled_shared_mutex> lg(m_impl->m_data_mutex);
     m_impl->email = email;
 }
 
 void User::updateUserPhone(std::string_view phone)
 {
-    std::unique_lock<std::shared_mutex> lg(m_impl->m_data_mutex);
+    std::unique_lock<profiled_shared_mutex> lg(m_impl->m_data_mutex);
     m_impl->phone = phone;
 }
 
 void User::updateUserProfile(std::string_view profile)
 {
-    std::unique_lock<std::shared_mutex> lg(m_impl->m_data_mutex);
+    std::unique_lock<profiled_shared_mutex> lg(m_impl->m_data_mutex);
     m_impl->profile = profile;
 }
 
@@ -195,7 +198,7 @@ void User::firstUpdateUserPassword(std::string_view new_password)
     std::string localPassword = sha512_proxy(new_password, localSalt);
 
     {
-        std::unique_lock<std::shared_mutex>
+        std::unique_lock<profiled_shared_mutex>
             lock(m_impl->m_data_mutex);
         m_impl->password = localPassword;
         m_impl->salt = localSalt;
@@ -221,7 +224,7 @@ void User::updateUserPassword(
     std::string localPassword = sha512_proxy(new_password, localSalt);
 
     {
-        std::unique_lock<std::shared_mutex>
+        std::unique_lock<profiled_shared_mutex>
             lock(m_impl->m_data_mutex);
         m_impl->password = localPassword;
         m_impl->salt = localSalt;
@@ -233,7 +236,7 @@ void User::updateUserPassword(
 
 bool User::userHasFriend(UserID friend_user_id) const
 {
-    std::shared_lock<std::shared_mutex>
+    std::shared_lock<profiled_shared_mutex>
         lock(m_impl->m_user_friend_map_mutex);
     return m_impl->m_user_friend_map.find(friend_user_id) !=
         m_impl->m_user_friend_map.cend();
@@ -241,7 +244,7 @@ bool User::userHasFriend(UserID friend_user_id) const
 
 bool User::userHasGroup(GroupID group_id) const
 {
-    std::shared_lock<std::shared_mutex>
+    std::shared_lock<profiled_shared_mutex>
         lock(m_impl->m_user_group_map_mutex);
     return m_impl->m_user_group_map.find(group_id) !=
         m_impl->m_user_group_map.cend();
@@ -249,14 +252,14 @@ bool User::userHasGroup(GroupID group_id) const
 
 std::unordered_set<UserID> User::getFriendList() const
 {
-    std::shared_lock<std::shared_mutex>
+    std::shared_lock<profiled_shared_mutex>
         lock(m_impl->m_user_friend_map_mutex);
     return m_impl->m_user_friend_map;
 }
 
 std::unordered_set<GroupID> User::getGroupList() const
 {
-    std::shared_lock<std::shared_mutex>
+    std::shared_lock<profiled_shared_mutex>
         lock(m_impl->m_user_group_map_mutex);
     return m_impl->m_user_group_map;
 }
@@ -362,7 +365,7 @@ void User::updateFriendList(
     if (!callback_function)
         throw std::system_error(make_error_code(qls::qls_errc::null_pointer));
 
-    std::unique_lock<std::shared_mutex> lock(m_impl->m_user_friend_map_mutex);
+    std::unique_lock<profiled_shared_mutex> lock(m_impl->m_user_friend_map_mutex);
     callback_function(m_impl->m_user_friend_map);
 }
 
@@ -372,7 +375,7 @@ void User::updateGroupList(
     if (!callback_function)
         throw std::system_error(make_error_code(qls::qls_errc::null_pointer));
 
-    std::unique_lock<std::shared_mutex>
+    std::unique_lock<profiled_shared_mutex>
         lock(m_impl->m_user_group_map_mutex);
     callback_function(m_impl->m_user_group_map);
 }
@@ -381,7 +384,7 @@ void User::addFriendVerification(
     UserID friend_user_id,
     const Verification::UserVerification& u)
 {
-    std::unique_lock<std::shared_mutex>
+    std::unique_lock<profiled_shared_mutex>
         lock(m_impl->m_user_friend_verification_map_mutex);
     m_impl->m_user_friend_verification_map.emplace(friend_user_id, u);
 }
@@ -390,14 +393,14 @@ void User::addGroupVerification(
     GroupID group_id,
     const Verification::GroupVerification& u)
 {
-    std::unique_lock<std::shared_mutex>
+    std::unique_lock<profiled_shared_mutex>
         lock(m_impl->m_user_group_verification_map_mutex);
     m_impl->m_user_group_verification_map.insert({ group_id, u });
 }
 
 void User::removeFriendVerification(UserID friend_user_id)
 {
-    std::unique_lock<std::shared_mutex>
+    std::unique_lock<profiled_shared_mutex>
         lock(m_impl->m_user_friend_verification_map_mutex);
     auto itor = m_impl->m_user_friend_verification_map.find(friend_user_id);
     if (itor == m_impl->m_user_friend_verification_map.cend())
@@ -408,7 +411,7 @@ void User::removeFriendVerification(UserID friend_user_id)
 std::unordered_map<UserID, Verification::UserVerification>
     User::getFriendVerificationList() const
 {
-    std::shared_lock<std::shared_mutex>
+    std::shared_lock<profiled_shared_mutex>
         lock(m_impl->m_user_friend_verification_map_mutex);
     return m_impl->m_user_friend_verification_map;
 }
@@ -505,7 +508,7 @@ bool User::removeGroup(GroupID group_id)
 
 void User::removeGroupVerification(GroupID group_id, UserID user_id)
 {
-    std::unique_lock<std::shared_mutex>
+    std::unique_lock<profiled_shared_mutex>
         lock(m_impl->m_user_group_verification_map_mutex);
     std::size_t size = m_impl->m_user_group_verification_map.count(group_id);
     if (!size) throw std::system_error(qls_errc::verification_not_existed);
@@ -522,7 +525,7 @@ void User::removeGroupVerification(GroupID group_id, UserID user_id)
 std::multimap<GroupID, Verification::GroupVerification>
     User::getGroupVerificationList() const
 {
-    std::shared_lock<std::shared_mutex>
+    std::shared_lock<profiled_shared_mutex>
         lock(m_impl->m_user_group_verification_map_mutex);
     return m_impl->m_user_group_verification_map;
 }
@@ -531,7 +534,7 @@ void User::addConnection(
     const std::shared_ptr<Connection> &connection_ptr,
     DeviceType type)
 {
-    std::unique_lock<std::shared_mutex>
+    std::unique_lock<profiled_shared_mutex>
         lock(m_impl->m_connection_map_mutex);
     if (m_impl->m_connection_map.find(connection_ptr) != m_impl->m_connection_map.cend())
         throw std::system_error(qls_errc::socket_pointer_existed);
@@ -541,13 +544,13 @@ void User::addConnection(
 
 bool User::hasConnection(const std::shared_ptr<Connection> &connection_ptr) const
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_connection_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_connection_map_mutex);
     return m_impl->m_connection_map.find(connection_ptr) != m_impl->m_connection_map.cend();
 }
 
 void User::modifyConnectionType(const std::shared_ptr<Connection> &connection_ptr, DeviceType type)
 {
-    std::unique_lock<std::shared_mutex> lock(m_impl->m_connection_map_mutex);
+    std::unique_lock<profiled_shared_mutex> lock(m_impl->m_connection_map_mutex);
     auto iter = m_impl->m_connection_map.find(connection_ptr);
     if (iter == m_impl->m_connection_map.cend())
         throw std::system_error(qls_errc::null_socket_pointer, "socket pointer doesn't exist");
@@ -557,7 +560,7 @@ void User::modifyConnectionType(const std::shared_ptr<Connection> &connection_pt
 
 void User::removeConnection(const std::shared_ptr<Connection>& connection_ptr)
 {
-    std::unique_lock<std::shared_mutex> lock(m_impl->m_connection_map_mutex);
+    std::unique_lock<profiled_shared_mutex> lock(m_impl->m_connection_map_mutex);
     auto iter = m_impl->m_connection_map.find(connection_ptr);
     if (iter == m_impl->m_connection_map.cend())
         throw std::system_error(qls_errc::null_socket_pointer, "socket pointer doesn't exist");
@@ -567,9 +570,13 @@ void User::removeConnection(const std::shared_ptr<Connection>& connection_ptr)
 
 void User::notifyAll(std::string_view data)
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_connection_map_mutex);
-    std::shared_ptr<std::string> buffer_ptr(std::allocate_shared<std::string>(
+    notifyAll(std::allocate_shared<std::string>(
         std::pmr::polymorphic_allocator<std::string>(&local_user_sync_pool), data));
+}
+
+void User::notifyAll(const std::shared_ptr<const std::string>& buffer_ptr)
+{
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_connection_map_mutex);
     for (const auto& [connection_ptr, type]: m_impl->m_connection_map) {
         asio::async_write(connection_ptr->socket, asio::buffer(*buffer_ptr),
             asio::bind_executor(connection_ptr->strand,
@@ -582,7 +589,7 @@ void User::notifyAll(std::string_view data)
 
 void User::notifyWithType(DeviceType type, std::string_view data)
 {
-    std::shared_lock<std::shared_mutex> lock(m_impl->m_connection_map_mutex);
+    std::shared_lock<profiled_shared_mutex> lock(m_impl->m_connection_map_mutex);
     std::shared_ptr<std::string> buffer_ptr(std::allocate_shared<std::string>(
         std::pmr::polymorphic_allocator<std::string>(&local_user_sync_pool), data));
     for (const auto& [connection_ptr, dtype]: m_impl->m_connection_map) {
@@ -147,6 +147,12 @@ public:
      */
     void notifyAll(std::string_view data);
 
+    /**
+     * @brief Notifies all sockets associated with the user.
+     * @param buffer Data to send, shared by all the writes without being copied.
+     */
+    void notifyAll(const std::shared_ptr<const std::string>& buffer);
+
     /**
      * @brief Notifies sockets of a specific DeviceType associated with the user.
      * @param type DeviceType of sockets to notify.
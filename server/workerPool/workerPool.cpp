@@ -0,0 +1,230 @@
+#include "workerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "adaptive_mutex.hpp"
+
+namespace qls
+{
+
+struct alignas(64) WorkerQueue
+{
+    adaptive_mutex                  mutex{"worker queue"};
+    std::deque<WorkerPool::Task>    tasks;
+};
+
+struct WorkerPoolImpl
+{
+    WorkerPoolImpl(std::size_t thread_num, std::size_t capacity):
+        m_thread_num(thread_num ? thread_num :
+            std::max<std::size_t>(2, std::thread::hardware_concurrency() / 2)),
+        m_capacity(capacity)
+    {
+        for (std::size_t i = 0; i < m_thread_num; ++i)
+            m_queues.emplace_back(std::make_unique<WorkerQueue>());
+    }
+
+    const std::size_t                           m_thread_num;
+    const std::size_t                           m_capacity;
+    std::vector<std::unique_ptr<WorkerQueue>>   m_queues; ///< One queue per worker
+    std::vector<std::thread>                    m_threads;
+
+    std::atomic<std::size_t>    m_pending = 0; ///< Places reserved by accepted tasks that didn't start yet
+    std::atomic<std::size_t>    m_queued = 0; ///< Tasks pushed into the queues, changed under their locks
+    std::atomic<std::size_t>    m_next_queue = 0; ///< Round robin index for foreign threads
+    std::atomic<bool>           m_is_running = false;
+
+    std::mutex                  m_sleep_mutex;
+    std::condition_variable     m_sleep_cv;
+
+    inline static thread_local WorkerPoolImpl*  tl_pool = nullptr;
+    inline static thread_local std::size_t      tl_index = 0;
+
+    bool popLocal(std::size_t index, WorkerPool::Task& task)
+    {
+        auto& queue = *m_queues[index];
+        std::lock_guard<adaptive_mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            return false;
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        --m_queued;
+        return true;
+    }
+
+    bool steal(std::size_t index, WorkerPool::Task& task)
+    {
+        // Queues that are busy are skipped first, and waited for
+        // only if no other queue had a task
+        bool skipped = false;
+        for (std::size_t i = 1; i < m_thread_num; ++i) {
+            auto& queue = *m_queues[(index + i) % m_thread_num];
+            std::unique_lock<adaptive_mutex> lock(queue.mutex, std::try_to_lock);
+            if (!lock.owns_lock()) {
+                skipped = true;
+                continue;
+            }
+            if (popFront(queue, task))
+                return true;
+        }
+        if (!skipped)
+            return false;
+
+        for (std::size_t i = 1; i < m_thread_num; ++i) {
+            auto& queue = *m_queues[(index + i) % m_thread_num];
+            std::lock_guard<adaptive_mutex> lock(queue.mutex);
+            if (popFront(queue, task))
+                return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Takes the oldest task of a queue, the caller holds its lock.
+     */
+    bool popFront(WorkerQueue& queue, WorkerPool::Task& task)
+    {
+        if (queue.tasks.empty())
+            return false;
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        --m_queued;
+        return true;
+    }
+
+    void workFunction(std::size_t index)
+    {
+        tl_pool = this;
+        tl_index = index;
+        while (true) {
+            WorkerPool::Task task;
+            if (popLocal(index, task) || steal(index, task)) {
+                --m_pending;
+                task();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_sleep_mutex);
+            // Only tasks that are in a queue wake the workers, a place that is
+            // reserved but not pushed yet would make them spin
+            m_sleep_cv.wait(lock, [this]() { return m_queued > 0 || !m_is_running; });
+            if (!m_is_running)
+                return;
+        }
+    }
+};
+
+WorkerPool::WorkerPool(std::size_t thread_num, std::size_t capacity):
+    m_impl(std::make_unique<WorkerPoolImpl>(thread_num, capacity)) {}
+
+WorkerPool::~WorkerPool() noexcept
+{
+    stop();
+}
+
+void WorkerPool::start()
+{
+    if (m_impl->m_is_running.exchange(true))
+        return;
+
+    for (std::size_t i = 0; i < m_impl->m_thread_num; ++i)
+        m_impl->m_threads.emplace_back([this, i]() { m_impl->workFunction(i); });
+}
+
+void WorkerPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_impl->m_sleep_mutex);
+        if (!m_impl->m_is_running.exchange(false))
+            return;
+    }
+    m_impl->m_sleep_cv.notify_all();
+
+    for (auto& thread: m_impl->m_threads) {
+        if (thread.joinable())
+            thread.join();
+    }
+    m_impl->m_threads.clear();
+
+    // Run what is left, so the coroutines waiting for the tasks are resumed
+    // instead of being leaked. A post that reserved its place before the pool
+    // stopped is still pushed, so wait for every reservation to be released.
+    while (m_impl->m_pending > 0) {
+        bool ran = false;
+        for (auto& queue: m_impl->m_queues) {
+            Task task;
+            {
+                std::lock_guard<adaptive_mutex> lock(queue->mutex);
+                if (!m_impl->popFront(*queue, task))
+                    continue;
+            }
+            --m_impl->m_pending;
+            task();
+            ran = true;
+        }
+        if (!ran)
+            std::this_thread::yield();
+    }
+}
+
+bool WorkerPool::tryPost(Task& task)
+{
+    if (!task || !m_impl->m_is_running)
+        return false;
+
+    // Reserve a place in the pool
+    if (m_impl->m_pending.fetch_add(1) >= m_impl->m_capacity) {
+        --m_impl->m_pending;
+        return false;
+    }
+    // The pool stopped after the first check, stop() may be done draining
+    if (!m_impl->m_is_running) {
+        --m_impl->m_pending;
+        return false;
+    }
+
+    // Workers push into their own queue, other threads spread the tasks
+    std::size_t index = WorkerPoolImpl::tl_pool == m_impl.get() ?
+        WorkerPoolImpl::tl_index :
+        m_impl->m_next_queue.fetch_add(1, std::memory_order_relaxed) % m_impl->m_thread_num;
+    {
+        auto& queue = *m_impl->m_queues[index];
+        std::lock_guard<adaptive_mutex> lock(queue.mutex);
+        queue.tasks.emplace_back(std::move(task));
+        ++m_impl->m_queued;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_impl->m_sleep_mutex);
+    }
+    m_impl->m_sleep_cv.notify_one();
+    return true;
+}
+
+bool WorkerPool::isFull() const noexcept
+{
+    return m_impl->m_pending >= m_impl->m_capacity;
+}
+
+std::size_t WorkerPool::getQueueSize() const noexcept
+{
+    return m_impl->m_pending;
+}
+
+std::size_t WorkerPool::getCapacity() const noexcept
+{
+    return m_impl->m_capacity;
+}
+
+std::size_t WorkerPool::getThreadNum() const noexcept
+{
+    return m_impl->m_thread_num;
+}
+
+} // namespace qls
@@ -0,0 +1,80 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <memory>
+#include <functional>
+#include <cstddef>
+
+namespace qls
+{
+
+struct WorkerPoolImpl;
+
+/**
+ * @class WorkerPool
+ * @brief Bounded work-stealing thread pool for CPU-heavy tasks,
+ *        isolated from the threads that run socket IO.
+ */
+class WorkerPool final
+{
+public:
+    using Task = std::move_only_function<void()>;
+
+    /**
+     * @brief Constructs the pool (threads are started by start()).
+     * @param thread_num Number of worker threads, 0 for default
+     * @param capacity Maximum number of tasks waiting in the pool
+     */
+    WorkerPool(std::size_t thread_num = 0, std::size_t capacity = 4096);
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool(WorkerPool&&) = delete;
+    ~WorkerPool() noexcept;
+
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    WorkerPool& operator=(WorkerPool&&) = delete;
+
+    /**
+     * @brief Starts the worker threads.
+     */
+    void start();
+
+    /**
+     * @brief Stops and joins the worker threads, the tasks left in the pool
+     *        are run on the calling thread.
+     */
+    void stop();
+
+    /**
+     * @brief Tries to post a task into the pool.
+     * @param task The task, only moved from if it was accepted
+     * @return true if the task was accepted, false if the pool is full or stopped
+     */
+    [[nodiscard]] bool tryPost(Task& task);
+
+    /**
+     * @brief Checks whether the pool can't accept more tasks.
+     */
+    [[nodiscard]] bool isFull() const noexcept;
+
+    /**
+     * @brief Gets the number of tasks waiting in the pool.
+     */
+    [[nodiscard]] std::size_t getQueueSize() const noexcept;
+
+    /**
+     * @brief Gets the maximum number of tasks waiting in the pool.
+     */
+    [[nodiscard]] std::size_t getCapacity() const noexcept;
+
+    /**
+     * @brief Gets the number of worker threads.
+     */
+    [[nodiscard]] std::size_t getThreadNum() const noexcept;
+
+private:
+    std::unique_ptr<WorkerPoolImpl> m_impl;
+};
+
+} // namespace qls
+
+#endif // !WORKER_POOL_H
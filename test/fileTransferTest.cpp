@@ -0,0 +1,132 @@
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "fileTransfer.h"
+#include "md_proxy.hpp"
+#include "ossl_proxy.hpp"
+#include "qls_error.h"
+
+using qls::UserID;
+
+static int failures = 0;
+
+static void check(bool condition, std::string_view what)
+{
+    if (!condition) {
+        std::cerr << "failed: " << what << '\n';
+        ++failures;
+    }
+}
+
+/**
+ * @brief Checks that a function throws a system_error with a code.
+ */
+template<class Function>
+static void checkThrows(Function function, qls::qls_errc errc, std::string_view what)
+{
+    try {
+        function();
+    } catch (const std::system_error& e) {
+        check(e.code() == make_error_code(errc), what);
+        return;
+    }
+    check(false, what);
+}
+
+static std::string hashOf(std::string_view content)
+{
+    static qls::ossl_proxy ossl;
+    qls::md_proxy digest(ossl, qls::AttachmentStore::hash_algorithm);
+    return digest(content);
+}
+
+static long long upload(qls::FileTransferManager& manager, UserID owner, std::string_view content)
+{
+    long long upload_id = manager.createUpload(owner,
+        static_cast<long long>(content.size()), hashOf(content));
+    if (!manager.writeUploadChunk(upload_id, owner, 0, content))
+        return -1;
+    return manager.finishUpload(upload_id, owner);
+}
+
+int main()
+{
+    const auto directory = std::filesystem::temp_directory_path() / "qls_file_transfer_test";
+    std::filesystem::remove_all(directory);
+
+    const UserID owner(10000);
+    const UserID other(10001);
+    const std::string content(100000, 'q');
+    long long file_id = -1;
+    {
+        qls::FileTransferManager manager(directory);
+        manager.init();
+
+        file_id = upload(manager, owner, content);
+        check(file_id > 0, "the upload is stored");
+        {
+            // An upload is only finished once all its bytes arrived
+            long long upload_id = manager.createUpload(owner,
+                static_cast<long long>(content.size()), hashOf(content));
+            check(!manager.writeUploadChunk(upload_id, owner, 0, std::string_view(content).substr(0, 10)),
+                "a partial upload isn't complete");
+            checkThrows([&]() { (void)manager.finishUpload(upload_id, owner); },
+                qls::qls_errc::upload_offset_mismatched, "a partial upload can't be finished");
+            check(manager.writeUploadChunk(upload_id, owner, 10, std::string_view(content).substr(10)),
+                "the last chunk completes the upload");
+            check(manager.writeUploadChunk(upload_id, owner, static_cast<long long>(content.size()), {}),
+                "an empty chunk at the end asks to finish again");
+            check(manager.finishUpload(upload_id, owner) > 0, "the completed upload is stored");
+        }
+        check(manager.openFile(file_id)->getData() == content, "the owner downloads the file");
+
+        // A second user counting through the IDs finds nothing
+        for (long long id = 1; id <= 4096; ++id) {
+            if (id == file_id)
+                continue;
+            checkThrows([&]() { (void)manager.openFile(id); },
+                qls::qls_errc::file_not_existed, "a counted file ID is not a file");
+        }
+        checkThrows([&]() { manager.removeFile(file_id, other); },
+            qls::qls_errc::file_not_existed, "a second user can't remove the file");
+        check(upload(manager, owner, content) != file_id + 1, "file IDs are not sequential");
+
+        // Knowing the hash isn't enough to get a file of the content
+        const std::string hash = hashOf(content);
+        const auto size = static_cast<long long>(content.size());
+        check(manager.addFileReference(other, hash, size) < 0, "a second user must upload the content");
+        check(manager.addFileReference(owner, hash, size) > 0, "the owner skips the upload");
+        long long other_file_id = upload(manager, other, content);
+        check(other_file_id > 0, "the second user uploads the content");
+        check(manager.addFileReference(other, hash, size) > 0, "the second user skips the next upload");
+
+        // Unfinished uploads are limited per user, and only idle ones are dropped
+        long long first_upload_id = -1;
+        for (std::size_t i = 0; i < qls::FileTransferManager::max_uploads_per_user; ++i) {
+            long long upload_id = manager.createUpload(owner, size, hash);
+            if (first_upload_id < 0)
+                first_upload_id = upload_id;
+        }
+        checkThrows([&]() { (void)manager.createUpload(owner, size, hash); },
+            qls::qls_errc::too_many_uploads, "a user has a limited number of uploads");
+        manager.removeIdleUploads();
+        check(manager.getUploadOffset(first_upload_id, owner) == 0, "an active upload is kept");
+    }
+    {
+        // The IDs are kept across restarts
+        qls::FileTransferManager manager(directory);
+        manager.init();
+        check(manager.hasFile(file_id), "the file ID is loaded again");
+        manager.removeFile(file_id, owner);
+        checkThrows([&]() { (void)manager.openFile(file_id); },
+            qls::qls_errc::file_not_existed, "a removed file can't be downloaded");
+    }
+
+    std::filesystem::remove_all(directory);
+    if (failures)
+        std::cerr << failures << " checks failed\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,276 @@
+#ifndef ADAPTIVE_MUTEX_HPP
+#define ADAPTIVE_MUTEX_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace qls
+{
+
+/**
+ * @brief Contention statistics of the locks that share a name.
+ */
+struct LockStatistics
+{
+    static constexpr std::size_t histogram_size = 16;
+
+    std::string     name;
+    std::uint64_t   acquisitions = 0;
+    std::uint64_t   contended = 0;      ///< Acquisitions that found the lock taken
+    std::uint64_t   parked = 0;         ///< Contended acquisitions that had to sleep
+    std::uint64_t   total_wait_ns = 0;
+    std::uint64_t   max_wait_ns = 0;
+    /// Bucket i counts the waits shorter than 256ns << i, the last one counts the longer ones too
+    std::array<std::uint64_t, histogram_size> wait_histogram{};
+};
+
+/**
+ * @class LockTelemetry
+ * @brief Counters shared by the locks of a name, kept for the life of the process.
+ *
+ * The locks of a name are often the shards of one table, so the counters are a
+ * cache line every shard writes. Recording is off until setEnabled(true) is
+ * called, until then a named lock costs as much as an unnamed one.
+ */
+class LockTelemetry final
+{
+public:
+    LockTelemetry(const LockTelemetry&) = delete;
+    LockTelemetry(LockTelemetry&&) = delete;
+
+    LockTelemetry& operator=(const LockTelemetry&) = delete;
+    LockTelemetry& operator=(LockTelemetry&&) = delete;
+
+    /**
+     * @brief Gets the counters of a name, they are created on first use.
+     */
+    static LockTelemetry& get(std::string_view name)
+    {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto iter = std::find_if(registry.entries.begin(), registry.entries.end(),
+            [name](const auto& entry) { return entry->m_name == name; });
+        if (iter != registry.entries.end())
+            return **iter;
+        registry.entries.emplace_back(new LockTelemetry(name));
+        return *registry.entries.back();
+    }
+
+    /**
+     * @brief Gets the statistics of every name.
+     */
+    static std::vector<LockStatistics> getAllStatistics()
+    {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        std::vector<LockStatistics> result;
+        result.reserve(registry.entries.size());
+        for (const auto& entry: registry.entries)
+            result.push_back(entry->getStatistics());
+        return result;
+    }
+
+    static void setEnabled(bool enabled) noexcept
+    {
+        s_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] static bool isEnabled() noexcept
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    void recordAcquisition() noexcept
+    {
+        m_acquisitions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void recordWait(std::uint64_t wait_ns, bool parked) noexcept
+    {
+        m_acquisitions.fetch_add(1, std::memory_order_relaxed);
+        m_contended.fetch_add(1, std::memory_order_relaxed);
+        if (parked)
+            m_parked.fetch_add(1, std::memory_order_relaxed);
+        m_total_wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+        std::uint64_t max_ns = m_max_wait_ns.load(std::memory_order_relaxed);
+        while (wait_ns > max_ns &&
+            !m_max_wait_ns.compare_exchange_weak(max_ns, wait_ns, std::memory_order_relaxed));
+        std::size_t bucket = std::min<std::size_t>(std::bit_width(wait_ns >> 8),
+            LockStatistics::histogram_size - 1);
+        m_wait_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] LockStatistics getStatistics() const
+    {
+        LockStatistics statistics;
+        statistics.name = m_name;
+        statistics.acquisitions = m_acquisitions.load(std::memory_order_relaxed);
+        statistics.contended = m_contended.load(std::memory_order_relaxed);
+        statistics.parked = m_parked.load(std::memory_order_relaxed);
+        statistics.total_wait_ns = m_total_wait_ns.load(std::memory_order_relaxed);
+        statistics.max_wait_ns = m_max_wait_ns.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < LockStatistics::histogram_size; ++i)
+            statistics.wait_histogram[i] = m_wait_histogram[i].load(std::memory_order_relaxed);
+        return statistics;
+    }
+
+private:
+    struct Registry
+    {
+        std::mutex                                      mutex;
+        std::vector<std::unique_ptr<LockTelemetry>>     entries;
+    };
+
+    explicit LockTelemetry(std::string_view name):
+        m_name(name) {}
+
+    static Registry& getRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    inline static std::atomic<bool> s_enabled = false;
+
+    const std::string           m_name;
+    std::atomic<std::uint64_t>  m_acquisitions = 0;
+    std::atomic<std::uint64_t>  m_contended = 0;
+    std::atomic<std::uint64_t>  m_parked = 0;
+    std::atomic<std::uint64_t>  m_total_wait_ns = 0;
+    std::atomic<std::uint64_t>  m_max_wait_ns = 0;
+    std::array<std::atomic<std::uint64_t>, LockStatistics::histogram_size>
+                                m_wait_histogram{};
+};
+
+/**
+ * @class adaptive_mutex
+ * @brief Mutex for short critical sections that spins before it sleeps.
+ *
+ * A contended lock() spins with exponential backoff for a bounded time, which is
+ * usually enough for the owner to leave a short critical section, then parks on
+ * the atomic. Parked threads are counted, so unlock() only wakes one up when
+ * there is one and the uncontended path never makes a system call. While the
+ * telemetry is on, a named lock records its acquisitions and wait times in the
+ * LockTelemetry of its name.
+ */
+class adaptive_mutex
+{
+public:
+    /// The backoff doubles up to this many pauses before the thread parks
+    static constexpr std::uint32_t max_spin_pauses = 64;
+
+    adaptive_mutex() = default;
+
+    /**
+     * @param name Name under which the contention is recorded,
+     *        locks of the same kind may share a name
+     */
+    explicit adaptive_mutex(std::string_view name):
+        m_telemetry(&LockTelemetry::get(name)) {}
+
+    ~adaptive_mutex() = default;
+
+    adaptive_mutex(const adaptive_mutex&) = delete;
+    adaptive_mutex(adaptive_mutex&&) = delete;
+
+    adaptive_mutex& operator=(const adaptive_mutex&) = delete;
+    adaptive_mutex& operator=(adaptive_mutex&&) = delete;
+
+    void lock() noexcept
+    {
+        if (try_lock()) {
+            if (LockTelemetry* telemetry = getTelemetry())
+                telemetry->recordAcquisition();
+            return;
+        }
+        lockContended();
+    }
+
+    bool try_lock() noexcept
+    {
+        std::uint32_t expected = 0;
+        return m_locked.compare_exchange_strong(expected, 1,
+            std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void unlock() noexcept
+    {
+        // Sequentially consistent with the waiter count, so a thread that is
+        // about to park either sees the lock free or is seen here
+        m_locked.store(0, std::memory_order_seq_cst);
+        if (m_waiters.load(std::memory_order_seq_cst) != 0)
+            m_locked.notify_one();
+    }
+
+private:
+    static void pause() noexcept
+    {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield");
+#endif
+    }
+
+    /**
+     * @brief Gets the telemetry of the name, nullptr if the lock has no name or recording is off.
+     */
+    LockTelemetry* getTelemetry() const noexcept
+    {
+        return m_telemetry && LockTelemetry::isEnabled() ? m_telemetry : nullptr;
+    }
+
+    void lockContended() noexcept
+    {
+        LockTelemetry* telemetry = getTelemetry();
+        auto start = telemetry ? std::chrono::steady_clock::now() :
+            std::chrono::steady_clock::time_point();
+        bool parked = false;
+
+        bool acquired = false;
+        for (std::uint32_t pauses = 1; pauses <= max_spin_pauses && !acquired; pauses *= 2) {
+            for (std::uint32_t i = 0; i < pauses; ++i)
+                pause();
+            // Only try to take the lock when it looks free, so spinning doesn't steal its cache line
+            acquired = m_locked.load(std::memory_order_relaxed) == 0 && try_lock();
+        }
+
+        if (!acquired) {
+            parked = true;
+            m_waiters.fetch_add(1, std::memory_order_seq_cst);
+            std::uint32_t expected = 0;
+            while (!m_locked.compare_exchange_strong(expected, 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                m_locked.wait(1, std::memory_order_relaxed);
+                expected = 0;
+            }
+            m_waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        if (telemetry)
+            telemetry->recordWait(static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count()), parked);
+    }
+
+    std::atomic<std::uint32_t>  m_locked = 0;
+    std::atomic<std::uint32_t>  m_waiters = 0;  ///< Threads that are parked or about to park
+    LockTelemetry*              m_telemetry = nullptr;
+};
+
+} // namespace qls
+
+#endif // !ADAPTIVE_MUTEX_HPP
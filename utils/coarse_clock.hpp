@@ -0,0 +1,127 @@
+#ifndef COARSE_CLOCK_HPP
+#define COARSE_CLOCK_HPP
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <stop_token>
+#include <thread>
+
+namespace qls
+{
+
+/**
+ * @class CoarseClock
+ * @brief Clock for hot paths, read with one atomic load.
+ *
+ * While a CoarseClock is running, its thread stores the time of steady_clock and
+ * utc_clock every tick_interval, and steadyNow() and utcNow() return the stored
+ * times, which are at most about a tick late. Code that needs the exact time, like
+ * timing something shorter than a tick, reads the clocks itself or calls the
+ * precise functions. Until a clock is started the coarse functions read the precise
+ * clocks, so code that runs without the server still gets the right time.
+ */
+class CoarseClock final
+{
+public:
+    static constexpr std::chrono::milliseconds tick_interval{1};
+
+    CoarseClock() = default;
+    ~CoarseClock() noexcept
+    {
+        stop();
+    }
+
+    CoarseClock(const CoarseClock&) = delete;
+    CoarseClock(CoarseClock&&) = delete;
+
+    CoarseClock& operator=(const CoarseClock&) = delete;
+    CoarseClock& operator=(CoarseClock&&) = delete;
+
+    /**
+     * @brief Starts the thread that updates the times, only one clock may run at a time.
+     */
+    void start()
+    {
+        if (m_thread.joinable())
+            return;
+        if (s_running.exchange(true, std::memory_order_acq_rel))
+            throw std::logic_error("another coarse clock is running");
+        update();
+        m_thread = std::jthread([](std::stop_token stop_token) {
+            while (!stop_token.stop_requested()) {
+                std::this_thread::sleep_for(tick_interval);
+                update();
+            }
+        });
+    }
+
+    /**
+     * @brief Stops the thread, the coarse functions read the precise clocks again.
+     */
+    void stop() noexcept
+    {
+        if (!m_thread.joinable())
+            return;
+        m_thread.request_stop();
+        m_thread.join();
+        s_steady_ticks.store(0, std::memory_order_relaxed);
+        s_utc_ticks.store(0, std::memory_order_relaxed);
+        s_running.store(false, std::memory_order_release);
+    }
+
+    [[nodiscard]] bool isRunning() const noexcept
+    {
+        return m_thread.joinable();
+    }
+
+    /**
+     * @brief Gets the time of steady_clock at the last tick.
+     */
+    [[nodiscard]] static std::chrono::steady_clock::time_point steadyNow() noexcept
+    {
+        auto ticks = s_steady_ticks.load(std::memory_order_relaxed);
+        if (ticks == 0) [[unlikely]]
+            return preciseSteadyNow();
+        return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(ticks));
+    }
+
+    /**
+     * @brief Gets the time of utc_clock at the last tick.
+     */
+    [[nodiscard]] static std::chrono::utc_clock::time_point utcNow()
+    {
+        auto ticks = s_utc_ticks.load(std::memory_order_relaxed);
+        if (ticks == 0) [[unlikely]]
+            return preciseUtcNow();
+        return std::chrono::utc_clock::time_point(std::chrono::utc_clock::duration(ticks));
+    }
+
+    [[nodiscard]] static std::chrono::steady_clock::time_point preciseSteadyNow() noexcept
+    {
+        return std::chrono::steady_clock::now();
+    }
+
+    [[nodiscard]] static std::chrono::utc_clock::time_point preciseUtcNow()
+    {
+        return std::chrono::utc_clock::now();
+    }
+
+private:
+    static void update()
+    {
+        s_steady_ticks.store(preciseSteadyNow().time_since_epoch().count(), std::memory_order_relaxed);
+        s_utc_ticks.store(preciseUtcNow().time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    /// Ticks of the clocks at the last update, 0 while no clock is running
+    inline static std::atomic<std::chrono::steady_clock::rep>               s_steady_ticks = 0;
+    inline static std::atomic<std::chrono::utc_clock::rep>                  s_utc_ticks = 0;
+    inline static std::atomic<bool>                                         s_running = false;
+
+    std::jthread m_thread;
+};
+
+} // namespace qls
+
+#endif // !COARSE_CLOCK_HPP
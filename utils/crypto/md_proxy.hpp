@@ -85,6 +85,16 @@ namespace qls
             return message_digest_ && digest_context_;
         }
 
+        /**
+         * @brief Feeds data into the digest, the digest is finished by operator()
+         *        so data can be hashed chunk by chunk.
+         */
+        void update(std::string_view data)
+        {
+            if (EVP_DigestUpdate(digest_context_, data.data(), data.size()) != 1)
+                throw std::runtime_error("EVP_DigestUpdate() failed");
+        }
+
         template<class... Args>
             requires requires (Args&&... args) { (std::string_view(std::forward<Args>(args)), ...); }
         std::string operator()(Args&&... args)
@@ -94,12 +104,7 @@ namespace qls
             if (digest_length <= 0)
                 throw std::runtime_error("EVP_MD_get_size() returned invalid size");
 
-            auto input = [this](std::string_view data) {
-                if (EVP_DigestUpdate(digest_context_, data.data(), data.size()) != 1)
-                    throw std::runtime_error("EVP_DigestUpdate() failed");
-            };
-
-            (input(std::forward<Args>(args)), ...);
+            (update(std::forward<Args>(args)), ...);
 
             digest_value.resize(digest_length);
             if (EVP_DigestFinal(digest_context_,
@@ -33,6 +33,12 @@ std::string qls_error_category::message(int Errval) const
     case qls_errc::hash_mismatched:
         return "hash mismatched";
 
+    // json error
+    case qls_errc::invalid_json:
+        return "json is invalid";
+    case qls_errc::json_type_mismatched:
+        return "type of json value mismatched";
+
     // network error
     case qls_errc::null_tls_context:
         return "tls context is null";
@@ -88,6 +94,22 @@ std::string qls_error_category::message(int Errval) const
         return "no permission";
     case qls_errc::permission_denied:
         return "permission denied";
+
+    // file error
+    case qls_errc::file_not_existed:
+        return "file not existed";
+    case qls_errc::file_too_large:
+        return "file is too large";
+    case qls_errc::upload_not_existed:
+        return "upload not existed";
+    case qls_errc::upload_offset_mismatched:
+        return "upload offset mismatched";
+    case qls_errc::invalid_file_hash:
+        return "invalid file hash";
+    case qls_errc::file_hash_mismatched:
+        return "file hash mismatched";
+    case qls_errc::too_many_uploads:
+        return "too many unfinished uploads";
         
     default:
         break;
@@ -21,6 +21,10 @@ enum class qls_errc
     data_too_small,
     data_too_large,
     hash_mismatched,
+
+    // json error
+    invalid_json,
+    json_type_mismatched,
     
     // network error
     null_tls_context,
@@ -54,7 +58,16 @@ enum class qls_errc
 
     // permission error
     no_permission,
-    permission_denied
+    permission_denied,
+
+    // file error
+    file_not_existed,
+    file_too_large,
+    upload_not_existed,
+    upload_offset_mismatched,
+    invalid_file_hash,
+    file_hash_mismatched,
+    too_many_uploads
 };
 std::error_code make_error_code(qls::qls_errc errc) noexcept;
 
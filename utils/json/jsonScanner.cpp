@@ -0,0 +1,294 @@
+#include "jsonScanner.h"
+
+#include <bit>
+#include <cstring>
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#   define QLS_JSON_SCANNER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define QLS_JSON_SCANNER_SSE2
+#endif
+
+namespace qls
+{
+
+namespace
+{
+
+struct BlockMasks
+{
+    std::uint64_t quote;        ///< '"'
+    std::uint64_t backslash;    ///< '\\'
+    std::uint64_t structural;   ///< '{', '}', '[', ']', ':', ','
+};
+
+#if defined(QLS_JSON_SCANNER_AVX2)
+
+inline std::uint64_t equalMask(__m256i lo, __m256i hi, char ch) noexcept
+{
+    const __m256i value = _mm256_set1_epi8(ch);
+    std::uint64_t low = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, value)));
+    std::uint64_t high = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, value)));
+    return low | (high << 32);
+}
+
+inline BlockMasks classifyBlock(const char* block) noexcept
+{
+    const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+    return {
+        equalMask(lo, hi, '"'),
+        equalMask(lo, hi, '\\'),
+        equalMask(lo, hi, '{') | equalMask(lo, hi, '}') |
+        equalMask(lo, hi, '[') | equalMask(lo, hi, ']') |
+        equalMask(lo, hi, ':') | equalMask(lo, hi, ',')
+    };
+}
+
+#elif defined(QLS_JSON_SCANNER_SSE2)
+
+inline std::uint64_t equalMask(const __m128i (&chunks)[4], char ch) noexcept
+{
+    const __m128i value = _mm_set1_epi8(ch);
+    std::uint64_t mask = 0;
+    for (int i = 0; i < 4; ++i) {
+        mask |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(chunks[i], value)))) << (i * 16);
+    }
+    return mask;
+}
+
+inline BlockMasks classifyBlock(const char* block) noexcept
+{
+    const __m128i chunks[4] = {
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(block)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 32)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 48))
+    };
+    return {
+        equalMask(chunks, '"'),
+        equalMask(chunks, '\\'),
+        equalMask(chunks, '{') | equalMask(chunks, '}') |
+        equalMask(chunks, '[') | equalMask(chunks, ']') |
+        equalMask(chunks, ':') | equalMask(chunks, ',')
+    };
+}
+
+#else
+
+inline BlockMasks classifyBlock(const char* block) noexcept
+{
+    BlockMasks masks{0, 0, 0};
+    for (int i = 0; i < 64; ++i) {
+        const std::uint64_t bit = std::uint64_t(1) << i;
+        switch (block[i]) {
+        case '"':   masks.quote |= bit; break;
+        case '\\':  masks.backslash |= bit; break;
+        case '{': case '}': case '[': case ']': case ':': case ',':
+            masks.structural |= bit; break;
+        default: break;
+        }
+    }
+    return masks;
+}
+
+#endif
+
+/**
+ * @brief Bit i of the result is the xor of bits 0..i of the input,
+ *        which turns quote positions into a mask of the string contents.
+ */
+inline std::uint64_t prefixXor(std::uint64_t bits) noexcept
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+inline int hexValue(char ch) noexcept
+{
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+inline bool readHex4(std::string_view raw, std::size_t pos, std::uint32_t& value) noexcept
+{
+    if (pos + 4 > raw.size())
+        return false;
+    value = 0;
+    for (std::size_t i = 0; i < 4; ++i) {
+        int digit = hexValue(raw[pos + i]);
+        if (digit < 0)
+            return false;
+        value = (value << 4) | static_cast<std::uint32_t>(digit);
+    }
+    return true;
+}
+
+inline void appendUtf8(std::string& out, std::uint32_t code_point)
+{
+    if (code_point < 0x80) {
+        out += static_cast<char>(code_point);
+    } else if (code_point < 0x800) {
+        out += static_cast<char>(0xC0 | (code_point >> 6));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        out += static_cast<char>(0xE0 | (code_point >> 12));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code_point >> 18));
+        out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+} // namespace
+
+bool buildStructuralIndex(std::string_view json, std::vector<std::uint32_t>& index)
+{
+    index.clear();
+    index.reserve(json.size() / 8 + 8);
+
+    std::uint64_t next_is_escaped = 0;  ///< Last block ended with an unescaped backslash
+    std::uint64_t inside_string = 0;    ///< All ones if last block ended inside a string
+
+    auto scanBlock = [&](const char* block, std::size_t offset) {
+        BlockMasks masks = classifyBlock(block);
+
+        // Backslashes are rare, so escapes are resolved one backslash at a time
+        std::uint64_t escaped = next_is_escaped;
+        next_is_escaped = 0;
+        for (std::uint64_t backslash = masks.backslash; backslash; backslash &= backslash - 1) {
+            int bit = std::countr_zero(backslash);
+            if ((escaped >> bit) & 1)
+                continue;
+            if (bit == 63)
+                next_is_escaped = 1;
+            else
+                escaped |= std::uint64_t(1) << (bit + 1);
+        }
+
+        const std::uint64_t quotes = masks.quote & ~escaped;
+        const std::uint64_t string_mask = prefixXor(quotes) ^ inside_string;
+        inside_string = static_cast<std::uint64_t>(static_cast<std::int64_t>(string_mask) >> 63);
+
+        // Structural characters outside strings and the opening quotes
+        std::uint64_t structurals = (masks.structural & ~string_mask) | (quotes & string_mask);
+        for (; structurals; structurals &= structurals - 1)
+            index.push_back(static_cast<std::uint32_t>(offset + std::countr_zero(structurals)));
+    };
+
+    std::size_t offset = 0;
+    for (; offset + 64 <= json.size(); offset += 64)
+        scanBlock(json.data() + offset, offset);
+    if (offset < json.size()) {
+        char tail[64];
+        std::memset(tail, ' ', sizeof(tail));
+        std::memcpy(tail, json.data() + offset, json.size() - offset);
+        scanBlock(tail, offset);
+    }
+
+    return inside_string == 0;
+}
+
+std::size_t findBackslash(std::string_view str, std::size_t pos) noexcept
+{
+    const char* data = str.data();
+    const std::size_t size = str.size();
+#if defined(QLS_JSON_SCANNER_AVX2)
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    for (; pos + 32 <= size; pos += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, backslash)));
+        if (mask)
+            return pos + std::countr_zero(mask);
+    }
+#elif defined(QLS_JSON_SCANNER_SSE2)
+    const __m128i backslash = _mm_set1_epi8('\\');
+    for (; pos + 16 <= size; pos += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslash)));
+        if (mask)
+            return pos + std::countr_zero(mask);
+    }
+#endif
+    for (; pos < size; ++pos) {
+        if (data[pos] == '\\')
+            return pos;
+    }
+    return size;
+}
+
+bool unescapeJsonString(std::string_view raw, std::string& out)
+{
+    out.clear();
+    out.reserve(raw.size());
+
+    std::size_t pos = 0;
+    while (true) {
+        // Copy the run before the next escape sequence at once
+        std::size_t escape = findBackslash(raw, pos);
+        out.append(raw.data() + pos, escape - pos);
+        if (escape == raw.size())
+            return true;
+        if (escape + 1 >= raw.size())
+            return false;
+
+        pos = escape + 2;
+        switch (raw[escape + 1]) {
+        case '"':   out += '"'; break;
+        case '\\':  out += '\\'; break;
+        case '/':   out += '/'; break;
+        case 'b':   out += '\b'; break;
+        case 'f':   out += '\f'; break;
+        case 'n':   out += '\n'; break;
+        case 'r':   out += '\r'; break;
+        case 't':   out += '\t'; break;
+        case 'u': {
+            std::uint32_t code_point = 0;
+            if (!readHex4(raw, pos, code_point))
+                return false;
+            pos += 4;
+            if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+                // Surrogate pair
+                std::uint32_t low = 0;
+                if (pos + 2 > raw.size() || raw[pos] != '\\' || raw[pos + 1] != 'u' ||
+                    !readHex4(raw, pos + 2, low) || low < 0xDC00 || low > 0xDFFF)
+                    return false;
+                pos += 6;
+                code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+            } else if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+                return false;
+            }
+            appendUtf8(out, code_point);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+}
+
+const char* getJsonScannerInstructionSet() noexcept
+{
+#if defined(QLS_JSON_SCANNER_AVX2)
+    return "AVX2";
+#elif defined(QLS_JSON_SCANNER_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace qls
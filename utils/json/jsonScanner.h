@@ -0,0 +1,47 @@
+#ifndef JSON_SCANNER_H
+#define JSON_SCANNER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace qls
+{
+
+/**
+ * @brief Builds the structural index of a json text.
+ *
+ * The index holds, in order, the positions of every '{', '}', '[', ']', ':'
+ * and ',' outside of strings and the position of the opening quote of every
+ * string. Characters are classified 64 bytes at a time with AVX2 or SSE2
+ * when the target supports them, and with a scalar loop otherwise.
+ *
+ * @param json Json text, must be shorter than 4 GiB
+ * @param index Receives the structural positions
+ * @return false if the text ends inside a string
+ */
+[[nodiscard]] bool buildStructuralIndex(std::string_view json, std::vector<std::uint32_t>& index);
+
+/**
+ * @brief Finds the first backslash in a string.
+ * @return Position of the backslash, or str.size() if there isn't one
+ */
+[[nodiscard]] std::size_t findBackslash(std::string_view str, std::size_t pos = 0) noexcept;
+
+/**
+ * @brief Decodes the escape sequences of the raw content of a json string.
+ * @param raw Characters between the quotes
+ * @param out Receives the decoded UTF-8 string
+ * @return false if an escape sequence is invalid
+ */
+[[nodiscard]] bool unescapeJsonString(std::string_view raw, std::string& out);
+
+/**
+ * @brief Gets the name of the instruction set used by the scanner.
+ */
+[[nodiscard]] const char* getJsonScannerInstructionSet() noexcept;
+
+} // namespace qls
+
+#endif // !JSON_SCANNER_H
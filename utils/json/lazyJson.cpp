@@ -0,0 +1,241 @@
+#include "lazyJson.h"
+
+#include <charconv>
+#include <system_error>
+
+#include "jsonScanner.h"
+#include "qls_error.h"
+
+namespace qls
+{
+
+static inline bool isJsonSpace(char ch) noexcept
+{
+    return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t';
+}
+
+[[noreturn]] static void throwInvalidJson()
+{
+    throw std::system_error(qls_errc::invalid_json);
+}
+
+// LazyJsonDocument
+
+LazyJsonDocument::LazyJsonDocument(std::string json):
+    m_text(std::move(json))
+{
+    if (m_text.size() >= UINT32_MAX || !buildStructuralIndex(m_text, m_index))
+        throwInvalidJson();
+
+    // Pair every bracket with its counterpart, so containers can be skipped at once
+    m_match.assign(m_index.size(), 0);
+    std::vector<std::uint32_t> open_brackets;
+    for (std::uint32_t i = 0; i < m_index.size(); ++i) {
+        char ch = m_text[m_index[i]];
+        if (ch == '{' || ch == '[') {
+            open_brackets.push_back(i);
+        } else if (ch == '}' || ch == ']') {
+            if (open_brackets.empty() ||
+                m_text[m_index[open_brackets.back()]] != (ch == '}' ? '{' : '['))
+                throwInvalidJson();
+            m_match[open_brackets.back()] = i;
+            open_brackets.pop_back();
+        }
+    }
+    if (!open_brackets.empty())
+        throwInvalidJson();
+
+    // Nothing but whitespace may follow the root value
+    LazyJsonValue value = root();
+    for (std::size_t i = value.m_end; i < m_text.size(); ++i) {
+        if (!isJsonSpace(m_text[i]))
+            throwInvalidJson();
+    }
+}
+
+LazyJsonValue LazyJsonDocument::root() const
+{
+    return makeValue(0, 0);
+}
+
+LazyJsonValue LazyJsonDocument::makeValue(std::uint32_t begin, std::uint32_t index) const
+{
+    const auto size = static_cast<std::uint32_t>(m_text.size());
+    while (begin < size && isJsonSpace(m_text[begin]))
+        ++begin;
+    if (begin >= size)
+        throwInvalidJson();
+
+    const char ch = m_text[begin];
+    if (ch == '{' || ch == '[') {
+        if (index >= m_index.size() || m_index[index] != begin)
+            throwInvalidJson();
+        return LazyJsonValue(this, begin, m_index[m_match[index]] + 1, index);
+    }
+
+    // A string or a scalar ends before the next structural character
+    std::uint32_t end = index + (ch == '"' ? 1 : 0) < m_index.size() ?
+        m_index[index + (ch == '"' ? 1 : 0)] : size;
+    while (end > begin && isJsonSpace(m_text[end - 1]))
+        --end;
+
+    if (ch == '"') {
+        if (index >= m_index.size() || m_index[index] != begin ||
+            end - begin < 2 || m_text[end - 1] != '"')
+            throwInvalidJson();
+    } else if (end == begin || ch == '}' || ch == ']' || ch == ':' || ch == ',') {
+        throwInvalidJson();
+    }
+    return LazyJsonValue(this, begin, end, index);
+}
+
+// LazyJsonValue
+
+qjson::JValueType LazyJsonValue::getType() const
+{
+    if (!m_document)
+        return qjson::JNull;
+
+    switch (m_document->m_text[m_begin]) {
+    case '{':   return qjson::JDict;
+    case '[':   return qjson::JList;
+    case '"':   return qjson::JString;
+    case 't':
+    case 'f':   return qjson::JBool;
+    case 'n':   return qjson::JNull;
+    default:
+        return getRaw().find_first_of(".eE") == std::string_view::npos ?
+            qjson::JInt : qjson::JDouble;
+    }
+}
+
+LazyJsonValue LazyJsonValue::find(std::string_view key) const
+{
+    if (getType() != qjson::JDict)
+        throw std::system_error(qls_errc::json_type_mismatched);
+
+    const std::string&                  text = m_document->m_text;
+    const std::vector<std::uint32_t>&   index = m_document->m_index;
+    const std::uint32_t                 close = m_document->m_match[m_index];
+
+    std::string unescaped_key;
+    std::uint32_t i = m_index + 1;
+    while (i < close) {
+        // "key" : value
+        if (text[index[i]] != '"' || i + 1 >= close || text[index[i + 1]] != ':')
+            throwInvalidJson();
+        std::uint32_t key_end = index[i + 1];
+        while (key_end > index[i] && isJsonSpace(text[key_end - 1]))
+            --key_end;
+        if (key_end - index[i] < 2 || text[key_end - 1] != '"')
+            throwInvalidJson();
+
+        LazyJsonValue value = m_document->makeValue(index[i + 1] + 1, i + 2);
+        std::string_view raw_key(text.data() + index[i] + 1, key_end - index[i] - 2);
+        if (findBackslash(raw_key) == raw_key.size()) {
+            if (raw_key == key)
+                return value;
+        } else if (unescapeJsonString(raw_key, unescaped_key) && unescaped_key == key) {
+            return value;
+        }
+
+        i = value.nextIndex();
+        if (i < close) {
+            if (text[index[i]] != ',')
+                throwInvalidJson();
+            ++i;
+        }
+    }
+    return {};
+}
+
+long long LazyJsonValue::getInt() const
+{
+    if (getType() != qjson::JInt)
+        throw std::system_error(qls_errc::json_type_mismatched);
+
+    std::string_view raw = getRaw();
+    long long number = 0;
+    auto [ptr, ec] = std::from_chars(raw.data(), raw.data() + raw.size(), number);
+    if (ec != std::errc{} || ptr != raw.data() + raw.size())
+        throwInvalidJson();
+    return number;
+}
+
+double LazyJsonValue::getDouble() const
+{
+    qjson::JValueType type = getType();
+    if (type != qjson::JDouble && type != qjson::JInt)
+        throw std::system_error(qls_errc::json_type_mismatched);
+
+    std::string_view raw = getRaw();
+    double number = 0;
+    auto [ptr, ec] = std::from_chars(raw.data(), raw.data() + raw.size(), number);
+    if (ec != std::errc{} || ptr != raw.data() + raw.size())
+        throwInvalidJson();
+    return number;
+}
+
+bool LazyJsonValue::getBool() const
+{
+    std::string_view raw = getRaw();
+    if (raw == "true")
+        return true;
+    if (raw == "false")
+        return false;
+    throw std::system_error(qls_errc::json_type_mismatched);
+}
+
+std::string LazyJsonValue::getString() const
+{
+    if (getType() != qjson::JString)
+        throw std::system_error(qls_errc::json_type_mismatched);
+
+    std::string_view raw = getRaw();
+    std::string result;
+    if (!unescapeJsonString(raw.substr(1, raw.size() - 2), result))
+        throwInvalidJson();
+    return result;
+}
+
+std::string_view LazyJsonValue::getRaw() const noexcept
+{
+    if (!m_document)
+        return {};
+    return std::string_view(m_document->m_text).substr(m_begin, m_end - m_begin);
+}
+
+qjson::JObject LazyJsonValue::materialize() const
+{
+    qjson::JObject json;
+    switch (getType()) {
+    case qjson::JInt:
+        json = getInt();
+        return json;
+    case qjson::JBool:
+        json = getBool();
+        return json;
+    case qjson::JString:
+        json = getString();
+        return json;
+    default:
+        if (!m_document)
+            return json;
+        return qjson::JParser::fastParse(getRaw());
+    }
+}
+
+std::uint32_t LazyJsonValue::nextIndex() const
+{
+    switch (m_document->m_text[m_begin]) {
+    case '{':
+    case '[':
+        return m_document->m_match[m_index] + 1;
+    case '"':
+        return m_index + 1;
+    default:
+        return m_index;
+    }
+}
+
+} // namespace qls
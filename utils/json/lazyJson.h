@@ -0,0 +1,131 @@
+#ifndef LAZY_JSON_H
+#define LAZY_JSON_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <Json.h>
+
+namespace qls
+{
+
+class LazyJsonDocument;
+
+/**
+ * @class LazyJsonValue
+ * @brief View of a value of a LazyJsonDocument.
+ *
+ * Nothing is parsed until the value is read, members are located through
+ * the structural index of the document. The view is cheap to copy and must
+ * not outlive its document.
+ */
+class LazyJsonValue final
+{
+public:
+    LazyJsonValue() = default;
+    ~LazyJsonValue() = default;
+
+    /**
+     * @brief Whether the view refers to a value, find() returns an
+     *        invalid view if the member doesn't exist.
+     */
+    [[nodiscard]] bool isValid() const noexcept { return m_document != nullptr; }
+
+    /**
+     * @brief Gets the type of the value from its first character.
+     */
+    [[nodiscard]] qjson::JValueType getType() const;
+
+    /**
+     * @brief Finds a member of a dict.
+     * @param key Name of the member
+     * @return View of the member, invalid if there is no such member
+     */
+    [[nodiscard]] LazyJsonValue find(std::string_view key) const;
+
+    [[nodiscard]] long long getInt() const;
+    [[nodiscard]] double getDouble() const;
+    [[nodiscard]] bool getBool() const;
+    [[nodiscard]] std::string getString() const;
+
+    /**
+     * @brief Gets the text of the value as it is in the document.
+     */
+    [[nodiscard]] std::string_view getRaw() const noexcept;
+
+    /**
+     * @brief Parses the value into a qjson::JObject.
+     */
+    [[nodiscard]] qjson::JObject materialize() const;
+
+private:
+    friend class LazyJsonDocument;
+
+    LazyJsonValue(const LazyJsonDocument* document, std::uint32_t begin,
+        std::uint32_t end, std::uint32_t index) noexcept:
+        m_document(document), m_begin(begin), m_end(end), m_index(index) {}
+
+    /**
+     * @brief Gets the position in the structural index right after the value.
+     */
+    [[nodiscard]] std::uint32_t nextIndex() const;
+
+    const LazyJsonDocument* m_document = nullptr;
+    std::uint32_t m_begin = 0;  ///< First character of the value
+    std::uint32_t m_end = 0;    ///< One past the last character of the value
+    /// Index entry of the opening bracket or quote, or of the structural following a scalar
+    std::uint32_t m_index = 0;
+};
+
+/**
+ * @class LazyJsonDocument
+ * @brief Json text with its structural index.
+ *
+ * The constructor scans the text once with SIMD and validates the nesting
+ * of brackets, values are decoded on demand through LazyJsonValue.
+ */
+class LazyJsonDocument final
+{
+public:
+    /**
+     * @brief Indexes a json text.
+     * @param json Json text, owned by the document
+     * @throw std::system_error(qls_errc::invalid_json) if the text is malformed
+     */
+    explicit LazyJsonDocument(std::string json);
+    LazyJsonDocument(const LazyJsonDocument&) = delete;
+    LazyJsonDocument(LazyJsonDocument&&) noexcept = default;
+    ~LazyJsonDocument() = default;
+
+    LazyJsonDocument& operator=(const LazyJsonDocument&) = delete;
+    LazyJsonDocument& operator=(LazyJsonDocument&&) noexcept = default;
+
+    /**
+     * @brief Gets the root value of the document.
+     */
+    [[nodiscard]] LazyJsonValue root() const;
+
+    /**
+     * @brief Gets the json text of the document.
+     */
+    [[nodiscard]] std::string_view getText() const noexcept { return m_text; }
+
+private:
+    friend class LazyJsonValue;
+
+    /**
+     * @brief Makes a view of the value that starts at a character.
+     * @param begin Position of the character, whitespace is skipped
+     * @param index First index entry at or after begin
+     */
+    [[nodiscard]] LazyJsonValue makeValue(std::uint32_t begin, std::uint32_t index) const;
+
+    std::string                 m_text;
+    std::vector<std::uint32_t>  m_index;    ///< Positions of structural characters
+    std::vector<std::uint32_t>  m_match;    ///< Index entry of the matching bracket of each open bracket
+};
+
+} // namespace qls
+
+#endif // !LAZY_JSON_H
@@ -0,0 +1,140 @@
+#include "eventLog.h"
+
+#include <condition_variable>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Log
+{
+
+/// Records are written once this much is batched, even before the flush interval
+static constexpr std::size_t max_batch_size = 256 * 1024;
+
+struct EventLoggerImpl
+{
+    /**
+     * @brief Opens the file of the current day, the magic is written to new files.
+     */
+    void openFile()
+    {
+        std::time_t t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        std::tm tm{};
+#ifdef _WIN32
+        localtime_s(&tm, &t);
+#else
+        localtime_r(&t, &tm);
+#endif
+        if (m_file.is_open() && tm.tm_yday == m_day)
+            return;
+
+        char name[32] = {};
+        std::strftime(name, sizeof(name), "events-%Y-%m-%d.bin", &tm);
+        std::error_code ec;
+        std::filesystem::create_directory("./logs", ec);
+        std::filesystem::path path = std::filesystem::path("./logs") / name;
+        bool is_new = !std::filesystem::exists(path, ec) || std::filesystem::file_size(path, ec) == 0;
+
+        m_file.close();
+        m_file.clear();
+        m_file.open(path, std::ios_base::app | std::ios_base::binary);
+        if (m_file && is_new)
+            m_file.write(event_log_magic.data(), static_cast<std::streamsize>(event_log_magic.size()));
+        m_day = tm.tm_yday;
+    }
+
+    void writeBatch()
+    {
+        if (m_batch.empty())
+            return;
+        openFile();
+        m_file.write(m_batch.data(), static_cast<std::streamsize>(m_batch.size()));
+        m_file.flush();
+        m_batch.clear();
+    }
+
+    std::string                             m_batch;
+    std::ofstream                           m_file;
+    int                                     m_day = -1;     ///< Day of the year of the open file
+
+    std::atomic<std::chrono::milliseconds>  m_flushInterval = std::chrono::milliseconds(100);
+    std::condition_variable                 m_cv;
+    std::mutex                              m_mutex;
+    std::atomic<bool>                       m_isRunning = true;
+    std::thread                             m_thread;
+};
+
+EventLogger::EventLogger():
+    m_impl(std::make_unique<EventLoggerImpl>())
+{
+    m_impl->m_batch.reserve(max_batch_size + max_record_size);
+    m_impl->m_thread = std::thread(&EventLogger::workFunction, this);
+}
+
+EventLogger::~EventLogger() noexcept
+{
+    m_impl->m_isRunning = false;
+    m_impl->m_cv.notify_all();
+    if (m_impl->m_thread.joinable())
+        m_impl->m_thread.join();
+}
+
+void EventLogger::setEnabled(bool enabled) noexcept
+{
+    m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool EventLogger::isEnabled() const noexcept
+{
+    return m_enabled.load(std::memory_order_relaxed);
+}
+
+void EventLogger::setFlushInterval(std::chrono::milliseconds interval) noexcept
+{
+    m_impl->m_flushInterval.store(interval, std::memory_order_relaxed);
+}
+
+std::size_t EventLogger::getDroppedCount() const noexcept
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+void EventLogger::wake() noexcept
+{
+    m_impl->m_cv.notify_one();
+}
+
+void EventLogger::workFunction()
+{
+    auto drainRing = [this]() {
+        bool moved = false;
+        while (m_impl->m_batch.size() < max_batch_size) {
+            if (!m_ring.consume([this](std::string_view record) { m_impl->m_batch.append(record); }))
+                break;
+            moved = true;
+        }
+        return moved;
+    };
+
+    while (true) {
+        while (drainRing()) {
+            if (m_impl->m_batch.size() >= max_batch_size)
+                m_impl->writeBatch();
+        }
+        m_impl->writeBatch();
+        if (!m_impl->m_isRunning) {
+            // Records that were claimed before the flag was seen
+            if (drainRing())
+                continue;
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(m_impl->m_mutex);
+        m_impl->m_cv.wait_for(lock, m_impl->m_flushInterval.load(std::memory_order_relaxed));
+    }
+}
+
+} // namespace Log
@@ -0,0 +1,110 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#include "eventRecord.h"
+#include "recordRing.hpp"
+
+namespace Log
+{
+
+struct EventLoggerImpl;
+
+/**
+ * @class EventLogger
+ * @brief Structured binary log of server events.
+ *
+ * A record is a timestamp, an event ID and typed arguments, encoded in a few
+ * dozen bytes straight into a slot of a lock-free ring buffer, so hot paths can
+ * log every event. A background thread appends the records to a file per day,
+ * ./logs/events-YYYY-MM-DD.bin, which the event log decoder turns into text or json.
+ * Records are dropped and counted when the ring buffer is full.
+ */
+class EventLogger final
+{
+public:
+    /// Number of records the ring buffer can hold, a power of two
+    static constexpr std::size_t ring_size = 8192;
+    /// Maximum size of an encoded record, arguments that don't fit are left out
+    static constexpr std::size_t max_record_size = 256;
+
+    /**
+     * @brief Starts the writing thread, the log file is opened with the first record.
+     */
+    EventLogger();
+    EventLogger(const EventLogger&) = delete;
+    EventLogger(EventLogger&&) = delete;
+    /**
+     * @brief Writes the remaining records and stops the writing thread.
+     */
+    ~EventLogger() noexcept;
+
+    EventLogger& operator=(const EventLogger&) = delete;
+    EventLogger& operator=(EventLogger&&) = delete;
+
+    /**
+     * @brief Logs an event.
+     * @param id Event
+     * @param args Arguments in the order of the event's documentation:
+     *             integers, bool, double, strings, UserID, GroupID,
+     *             std::error_code or std::chrono::duration
+     */
+    template<class... Args>
+    void log(EventID id, const Args&... args) noexcept
+    {
+        if (!m_enabled.load(std::memory_order_relaxed))
+            return;
+
+        Ring::Claim slot;
+        if (!m_ring.tryClaim(slot)) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        EventRecordWriter writer(slot.data, max_record_size, id, std::chrono::system_clock::now());
+        (writer.write(args), ...);
+        m_ring.publish(slot, writer.finish());
+
+        // The writing thread wakes up by itself every flush interval,
+        // it is woken early when the ring buffer fills up
+        if ((slot.position & (ring_size / 4 - 1)) == 0)
+            wake();
+    }
+
+    /**
+     * @brief Turns logging on or off, disabled events cost a load and a branch.
+     */
+    void setEnabled(bool enabled) noexcept;
+
+    /**
+     * @brief Checks whether events are logged.
+     */
+    [[nodiscard]] bool isEnabled() const noexcept;
+
+    /**
+     * @brief Sets how long records may stay in memory before they are written.
+     */
+    void setFlushInterval(std::chrono::milliseconds interval) noexcept;
+
+    /**
+     * @brief Gets how many records have been dropped because the ring buffer was full.
+     */
+    [[nodiscard]] std::size_t getDroppedCount() const noexcept;
+
+private:
+    using Ring = RecordRing<max_record_size, ring_size>;
+
+    void wake() noexcept;
+    void workFunction();
+
+    Ring                                m_ring;
+    std::atomic<bool>                   m_enabled = true;
+    std::atomic<std::size_t>            m_dropped = 0;
+    std::unique_ptr<EventLoggerImpl>    m_impl;
+};
+
+} // namespace Log
+
+#endif // !EVENT_LOG_H
@@ -0,0 +1,420 @@
+#include "eventRecord.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include "qls_error.h"
+
+namespace Log
+{
+
+/// [u16 length][u16 event ID][i64 time][u8 argument count]
+static constexpr std::size_t record_header_size = 13;
+/// Longer strings are truncated, so the arguments after them still fit
+static constexpr std::size_t max_string_size = 64;
+
+static constexpr EventInfo event_infos[] = {
+    { "connected",              { "address" } },
+    { "disconnected",           { "address", "error" } },
+    { "logged_in",              { "user", "device" } },
+    { "login_failed",           { "user", "device" } },
+    { "friend_message_sent",    { "sender", "receiver", "size" } },
+    { "group_message_sent",     { "sender", "group", "size" } },
+    { "file_uploaded",          { "user", "file", "size" } },
+    { "request_processed",      { "function", "duration" } }
+};
+
+const EventInfo* getEventInfo(EventID id) noexcept
+{
+    auto index = static_cast<std::size_t>(id) - 1;
+    if (index >= std::size(event_infos))
+        return nullptr;
+    return &event_infos[index];
+}
+
+static inline std::uint64_t zigzag(long long value) noexcept
+{
+    auto bits = static_cast<std::uint64_t>(value);
+    return (bits << 1) ^ (0 - (bits >> 63));
+}
+
+static inline long long unzigzag(std::uint64_t value) noexcept
+{
+    return static_cast<long long>((value >> 1) ^ (0 - (value & 1)));
+}
+
+static std::size_t varintSize(std::uint64_t value) noexcept
+{
+    std::size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+static char* writeVarint(char* out, std::uint64_t value) noexcept
+{
+    while (value >= 0x80) {
+        *out++ = static_cast<char>(static_cast<std::uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<char>(value);
+    return out;
+}
+
+static void writeLittleEndian(char* out, std::uint64_t value, int size) noexcept
+{
+    for (int i = 0; i < size; ++i)
+        out[i] = static_cast<char>(value >> (i * 8));
+}
+
+EventRecordWriter::EventRecordWriter(char* buffer, std::size_t capacity, EventID id,
+    std::chrono::system_clock::time_point time) noexcept :
+    m_buffer(buffer),
+    m_capacity(capacity),
+    m_size(record_header_size)
+{
+    auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(
+        time.time_since_epoch()).count();
+    writeLittleEndian(m_buffer + 2, static_cast<std::uint16_t>(id), 2);
+    writeLittleEndian(m_buffer + 4, static_cast<std::uint64_t>(microseconds), 8);
+    m_buffer[12] = 0;
+}
+
+bool EventRecordWriter::beginArgument(EventArgumentType type, std::size_t size) noexcept
+{
+    if (m_capacity - m_size < size + 1 || static_cast<std::uint8_t>(m_buffer[12]) == 0xFF)
+        return false;
+    m_buffer[m_size++] = static_cast<char>(type);
+    ++m_buffer[12];
+    return true;
+}
+
+void EventRecordWriter::writeInteger(EventArgumentType type, long long value) noexcept
+{
+    std::uint64_t encoded = zigzag(value);
+    if (beginArgument(type, varintSize(encoded)))
+        m_size = writeVarint(m_buffer + m_size, encoded) - m_buffer;
+}
+
+void EventRecordWriter::write(bool value) noexcept
+{
+    if (beginArgument(EventArgumentType::Bool, 1))
+        m_buffer[m_size++] = value ? 1 : 0;
+}
+
+void EventRecordWriter::write(double value) noexcept
+{
+    if (beginArgument(EventArgumentType::Double, 8)) {
+        writeLittleEndian(m_buffer + m_size, std::bit_cast<std::uint64_t>(value), 8);
+        m_size += 8;
+    }
+}
+
+void EventRecordWriter::write(std::string_view value) noexcept
+{
+    // Strings are cut to the space left, the length prefix takes one byte
+    std::size_t space = m_capacity - m_size;
+    if (space < 2)
+        return;
+    value = value.substr(0, std::min({ value.size(), max_string_size, space - 2 }));
+    if (beginArgument(EventArgumentType::String, varintSize(value.size()) + value.size())) {
+        char* out = writeVarint(m_buffer + m_size, value.size());
+        std::memcpy(out, value.data(), value.size());
+        m_size = out + value.size() - m_buffer;
+    }
+}
+
+void EventRecordWriter::write(qls::UserID value) noexcept
+{
+    writeInteger(EventArgumentType::UserID, value.getOriginValue());
+}
+
+void EventRecordWriter::write(qls::GroupID value) noexcept
+{
+    writeInteger(EventArgumentType::GroupID, value.getOriginValue());
+}
+
+void EventRecordWriter::write(const std::error_code& value) noexcept
+{
+    std::string_view category = value.category().name();
+    std::uint64_t encoded = zigzag(value.value());
+    std::size_t size = varintSize(encoded) + varintSize(category.size()) + category.size();
+    if (beginArgument(EventArgumentType::ErrorCode, size)) {
+        char* out = writeVarint(m_buffer + m_size, encoded);
+        out = writeVarint(out, category.size());
+        std::memcpy(out, category.data(), category.size());
+        m_size = out + category.size() - m_buffer;
+    }
+}
+
+std::size_t EventRecordWriter::finish() noexcept
+{
+    writeLittleEndian(m_buffer, m_size, 2);
+    return m_size;
+}
+
+/// Reads the fields of one record, any read past its end is an error
+class EventRecordReader
+{
+public:
+    EventRecordReader(std::string_view data):
+        m_data(data) {}
+
+    [[noreturn]] static void fail()
+    {
+        throw std::runtime_error("malformed event record");
+    }
+
+    std::uint64_t readLittleEndian(int size)
+    {
+        if (m_data.size() - m_pos < static_cast<std::size_t>(size))
+            fail();
+        std::uint64_t value = 0;
+        for (int i = 0; i < size; ++i)
+            value |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(m_data[m_pos++])) << (i * 8);
+        return value;
+    }
+
+    std::uint64_t readVarint()
+    {
+        std::uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            std::uint8_t byte = static_cast<std::uint8_t>(readLittleEndian(1));
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        fail();
+    }
+
+    std::string readString()
+    {
+        std::uint64_t size = readVarint();
+        if (size > m_data.size() - m_pos)
+            fail();
+        std::string str(m_data.substr(m_pos, size));
+        m_pos += size;
+        return str;
+    }
+
+    bool finished() const noexcept
+    {
+        return m_pos == m_data.size();
+    }
+
+private:
+    std::string_view    m_data;
+    std::size_t         m_pos = 0;
+};
+
+EventRecord decodeEventRecord(std::string_view& data)
+{
+    if (data.size() < record_header_size)
+        EventRecordReader::fail();
+    std::size_t length = static_cast<std::uint8_t>(data[0]) |
+        (static_cast<std::size_t>(static_cast<std::uint8_t>(data[1])) << 8);
+    if (length < record_header_size || length > data.size())
+        EventRecordReader::fail();
+
+    EventRecordReader reader(data.substr(2, length - 2));
+    data.remove_prefix(length);
+
+    EventRecord record;
+    record.id = static_cast<EventID>(reader.readLittleEndian(2));
+    record.time = std::chrono::system_clock::time_point(std::chrono::duration_cast<
+        std::chrono::system_clock::duration>(std::chrono::microseconds(
+            static_cast<long long>(reader.readLittleEndian(8)))));
+    std::size_t count = static_cast<std::size_t>(reader.readLittleEndian(1));
+    record.arguments.resize(count);
+    for (auto& argument: record.arguments) {
+        argument.type = static_cast<EventArgumentType>(reader.readLittleEndian(1));
+        switch (argument.type) {
+        case EventArgumentType::Int:
+        case EventArgumentType::UserID:
+        case EventArgumentType::GroupID:
+        case EventArgumentType::Duration:
+            argument.integer = unzigzag(reader.readVarint());
+            break;
+        case EventArgumentType::Double:
+            argument.real = std::bit_cast<double>(reader.readLittleEndian(8));
+            break;
+        case EventArgumentType::Bool:
+            argument.integer = reader.readLittleEndian(1) != 0;
+            break;
+        case EventArgumentType::String:
+            argument.text = reader.readString();
+            break;
+        case EventArgumentType::ErrorCode:
+            argument.integer = unzigzag(reader.readVarint());
+            argument.text = reader.readString();
+            break;
+        default:
+            EventRecordReader::fail();
+        }
+    }
+    if (!reader.finished())
+        EventRecordReader::fail();
+    return record;
+}
+
+static std::string formatTime(std::chrono::system_clock::time_point time)
+{
+    std::time_t t = std::chrono::system_clock::to_time_t(time);
+    std::tm tm{};
+#ifdef _WIN32
+    localtime_s(&tm, &t);
+#else
+    localtime_r(&t, &tm);
+#endif
+    auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(
+        time.time_since_epoch()).count() % 1000000;
+    std::stringstream ss;
+    ss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S") << '.'
+        << std::setw(6) << std::setfill('0') << (microseconds < 0 ? microseconds + 1000000 : microseconds);
+    return ss.str();
+}
+
+static std::string_view getArgumentName(const EventInfo* info, std::size_t index)
+{
+    if (info && index < info->argument_names.size() && !info->argument_names[index].empty())
+        return info->argument_names[index];
+    return {};
+}
+
+/**
+ * @brief Gets the message of an error code, only codes of this server are known.
+ */
+static std::string getErrorMessage(const EventArgument& argument)
+{
+    if (argument.integer == 0)
+        return "success";
+    if (argument.text == qls::make_error_code(qls::qls_errc::null_pointer).category().name())
+        return qls::make_error_code(static_cast<qls::qls_errc>(argument.integer)).message();
+    if (argument.text == std::system_category().name())
+        return std::error_code(static_cast<int>(argument.integer), std::system_category()).message();
+    if (argument.text == std::generic_category().name())
+        return std::error_code(static_cast<int>(argument.integer), std::generic_category()).message();
+    return {};
+}
+
+static void writeJsonString(std::ostream& out, std::string_view str)
+{
+    out << '"';
+    for (char c: str) {
+        switch (c) {
+        case '"': out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        case '\r': out << "\\r"; break;
+        case '\t': out << "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+                out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                    << static_cast<int>(c) << std::dec;
+            else
+                out << c;
+        }
+    }
+    out << '"';
+}
+
+std::string formatEventRecordText(const EventRecord& record)
+{
+    const EventInfo* info = getEventInfo(record.id);
+    std::stringstream ss;
+    ss << '[' << formatTime(record.time) << "] ";
+    if (info)
+        ss << info->name;
+    else
+        ss << "event_" << static_cast<int>(record.id);
+
+    for (std::size_t i = 0; i < record.arguments.size(); ++i) {
+        const EventArgument& argument = record.arguments[i];
+        ss << ' ';
+        if (auto name = getArgumentName(info, i); !name.empty())
+            ss << name << '=';
+        switch (argument.type) {
+        case EventArgumentType::Double:
+            ss << argument.real;
+            break;
+        case EventArgumentType::Bool:
+            ss << (argument.integer ? "true" : "false");
+            break;
+        case EventArgumentType::String:
+            writeJsonString(ss, argument.text);
+            break;
+        case EventArgumentType::ErrorCode:
+            ss << argument.text << ':' << argument.integer;
+            if (auto message = getErrorMessage(argument); !message.empty())
+                ss << '(' << message << ')';
+            break;
+        case EventArgumentType::Duration:
+            ss << argument.integer << "us";
+            break;
+        default:
+            ss << argument.integer;
+            break;
+        }
+    }
+    return ss.str();
+}
+
+std::string formatEventRecordJson(const EventRecord& record)
+{
+    const EventInfo* info = getEventInfo(record.id);
+    std::stringstream ss;
+    ss << "{\"time\":";
+    writeJsonString(ss, formatTime(record.time));
+    ss << ",\"timestamp\":" << std::chrono::duration_cast<std::chrono::microseconds>(
+        record.time.time_since_epoch()).count();
+    ss << ",\"event\":";
+    if (info)
+        writeJsonString(ss, info->name);
+    else
+        ss << static_cast<int>(record.id);
+
+    ss << ",\"arguments\":{";
+    for (std::size_t i = 0; i < record.arguments.size(); ++i) {
+        const EventArgument& argument = record.arguments[i];
+        if (i)
+            ss << ',';
+        auto name = getArgumentName(info, i);
+        writeJsonString(ss, name.empty() ? std::to_string(i) : std::string(name));
+        ss << ':';
+        switch (argument.type) {
+        case EventArgumentType::Double:
+            ss << argument.real;
+            break;
+        case EventArgumentType::Bool:
+            ss << (argument.integer ? "true" : "false");
+            break;
+        case EventArgumentType::String:
+            writeJsonString(ss, argument.text);
+            break;
+        case EventArgumentType::ErrorCode:
+            ss << "{\"category\":";
+            writeJsonString(ss, argument.text);
+            ss << ",\"value\":" << argument.integer << ",\"message\":";
+            writeJsonString(ss, getErrorMessage(argument));
+            ss << '}';
+            break;
+        case EventArgumentType::Duration:
+            ss << "{\"microseconds\":" << argument.integer << '}';
+            break;
+        default:
+            ss << argument.integer;
+            break;
+        }
+    }
+    ss << "}}";
+    return ss.str();
+}
+
+} // namespace Log
@@ -0,0 +1,146 @@
+#ifndef EVENT_RECORD_H
+#define EVENT_RECORD_H
+
+#include <array>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "userid.hpp"
+#include "groupid.hpp"
+
+namespace Log
+{
+
+/// Magic at the beginning of every event log file
+inline constexpr std::string_view event_log_magic = "QLSEVT01";
+
+/// Events of the structured log, the values are stored in the files so they must not change
+enum class EventID : std::uint16_t
+{
+    Connected = 1,          ///< address
+    Disconnected,           ///< address, error
+    LoggedIn,               ///< user, device
+    LoginFailed,            ///< user, device
+    FriendMessageSent,      ///< sender, receiver, size
+    GroupMessageSent,       ///< sender, group, size
+    FileUploaded,           ///< user, file, size
+    RequestProcessed        ///< function, duration
+};
+
+/// Type tag of an argument, the values are stored in the files so they must not change
+enum class EventArgumentType : std::uint8_t
+{
+    Int = 1,    ///< zigzag varint
+    Double,     ///< 8 bytes, little endian
+    Bool,       ///< 1 byte
+    String,     ///< varint length + bytes
+    UserID,     ///< zigzag varint
+    GroupID,    ///< zigzag varint
+    ErrorCode,  ///< zigzag varint value + varint length + category name
+    Duration    ///< zigzag varint of microseconds
+};
+
+/// Name of an event and of its arguments, for decoding
+struct EventInfo
+{
+    std::string_view                    name;
+    std::array<std::string_view, 4>     argument_names;
+};
+
+/**
+ * @brief Gets the names of an event.
+ * @return nullptr if the event is unknown
+ */
+[[nodiscard]] const EventInfo* getEventInfo(EventID id) noexcept;
+
+/// Decoded argument of a record
+struct EventArgument
+{
+    EventArgumentType   type = EventArgumentType::Int;
+    long long           integer = 0;    ///< Every type but Double and String
+    double              real = 0;       ///< Double
+    std::string         text;           ///< String, category name of ErrorCode
+};
+
+/// Decoded record
+struct EventRecord
+{
+    std::chrono::system_clock::time_point   time;
+    EventID                                 id = EventID::Connected;
+    std::vector<EventArgument>              arguments;
+};
+
+/**
+ * @class EventRecordWriter
+ * @brief Encodes a record into a fixed buffer:
+ *        [u16 length][u16 event ID][i64 microseconds since epoch][u8 argument count][arguments],
+ *        all little endian. Strings are truncated and arguments that don't fit are left out.
+ */
+class EventRecordWriter final
+{
+public:
+    EventRecordWriter(char* buffer, std::size_t capacity, EventID id,
+        std::chrono::system_clock::time_point time) noexcept;
+
+    void write(bool value) noexcept;
+    void write(double value) noexcept;
+    void write(std::string_view value) noexcept;
+    void write(const char* value) noexcept { write(std::string_view(value)); }
+    void write(const std::string& value) noexcept { write(std::string_view(value)); }
+    void write(qls::UserID value) noexcept;
+    void write(qls::GroupID value) noexcept;
+    void write(const std::error_code& value) noexcept;
+
+    template<std::integral T>
+        requires (!std::same_as<T, bool>)
+    void write(T value) noexcept
+    {
+        writeInteger(EventArgumentType::Int, static_cast<long long>(value));
+    }
+
+    template<class Rep, class Period>
+    void write(std::chrono::duration<Rep, Period> value) noexcept
+    {
+        writeInteger(EventArgumentType::Duration,
+            std::chrono::duration_cast<std::chrono::microseconds>(value).count());
+    }
+
+    /**
+     * @brief Fills in the length of the record.
+     * @return Size of the record
+     */
+    std::size_t finish() noexcept;
+
+private:
+    void writeInteger(EventArgumentType type, long long value) noexcept;
+    bool beginArgument(EventArgumentType type, std::size_t size) noexcept;
+
+    char*       m_buffer;
+    std::size_t m_capacity;
+    std::size_t m_size;
+};
+
+/**
+ * @brief Decodes the record at the beginning of data and removes it from data.
+ * @throw std::runtime_error if the record is malformed
+ */
+[[nodiscard]] EventRecord decodeEventRecord(std::string_view& data);
+
+/**
+ * @brief Formats a record as one line of text.
+ */
+[[nodiscard]] std::string formatEventRecordText(const EventRecord& record);
+
+/**
+ * @brief Formats a record as one line of json.
+ */
+[[nodiscard]] std::string formatEventRecordJson(const EventRecord& record);
+
+} // namespace Log
+
+#endif // !EVENT_RECORD_H
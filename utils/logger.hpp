@@ -5,23 +5,38 @@
 #include <condition_variable>
 #include <thread>
 #include <mutex>
-#include <queue>
 #include <chrono>
+#include <ctime>
 #include <fstream>
 #include <atomic>
 #include <string>
+#include <string_view>
 #include <filesystem>
 #include <stdexcept>
+#include <memory>
+#include <sstream>
+#include <iomanip>
+#include <streambuf>
+#include <concepts>
 #include <functional>
+#include <type_traits>
+
+#include "recordRing.hpp"
 
 namespace Log
 {
-    
+
 template<typename T>
 concept StreamType = requires (T t) {
     std::cout << t;
 };
 
+/// A streamable value, or a callable producing one that is only called
+/// when the record is written, e.g. [&] { return qjson::JWriter::fastWrite(json); }
+template<typename T>
+concept LogArgumentType = StreamType<T> ||
+    (std::invocable<T&> && StreamType<std::invoke_result_t<T&>>);
+
 class Logger
 {
 public:
@@ -34,22 +49,37 @@ public:
         LogDEBUG
     };
 
+    /// What print() does when the ring buffer is full
+    enum class OverflowPolicy
+    {
+        Drop = 0,   ///< The record is dropped and counted
+        Block       ///< The caller waits until the writing thread frees a slot
+    };
+
+    /// Number of records the ring buffer can hold, a power of two
+    static constexpr std::size_t ring_size = 4096;
+    /// Maximum size of a formatted record, longer records are truncated
+    static constexpr std::size_t max_record_size = 1024;
+    /// Records are written once this much is batched, even before the flush interval
+    static constexpr std::size_t max_batch_size = 256 * 1024;
+
     /**
      * @brief Default constructor.
      * Opens the log file and starts the logging thread.
      * Throws std::runtime_error if the log file cannot be opened.
      */
     Logger() :
-        m_isRunning(true),
-        m_thread(std::bind(&Logger::workFunction, this))
+        m_isRunning(true)
     {
         if (!openFile())
             throw std::runtime_error("Could not open the log file.");
+        m_batch.reserve(max_batch_size + max_record_size);
+        m_thread = std::thread(&Logger::workFunction, this);
     }
 
     /**
      * @brief Destructor.
-     * Stops the logging thread and closes the log file.
+     * Writes the remaining records, stops the logging thread and closes the log file.
      */
     ~Logger()
     {
@@ -66,7 +96,7 @@ public:
      * @param args Arguments to be logged.
      */
     template<typename... Args>
-        requires ((StreamType<Args>) && ...)
+        requires ((LogArgumentType<Args>) && ...)
     constexpr void info(Args&&... args)
     {
         print(LogMode::LogINFO, std::forward<Args>(args)...);
@@ -78,7 +108,7 @@ public:
      * @param args Arguments to be logged.
      */
     template<typename... Args>
-        requires ((StreamType<Args>) && ...)
+        requires ((LogArgumentType<Args>) && ...)
     constexpr void warning(Args&&... args)
     {
         print(LogMode::LogWARNING, std::forward<Args>(args)...);
@@ -90,7 +120,7 @@ public:
      * @param args Arguments to be logged.
      */
     template<typename... Args>
-        requires ((StreamType<Args>) && ...)
+        requires ((LogArgumentType<Args>) && ...)
     constexpr void error(Args&&... args)
     {
         print(LogMode::LogERROR, std::forward<Args>(args)...);
@@ -102,7 +132,7 @@ public:
      * @param args Arguments to be logged.
      */
     template<typename... Args>
-        requires ((StreamType<Args>) && ...)
+        requires ((LogArgumentType<Args>) && ...)
     constexpr void critical(Args&&... args)
     {
         print(LogMode::LogCRITICAL, std::forward<Args>(args)...);
@@ -110,87 +140,261 @@ public:
 
     /**
      * @brief Logs a debug message.
-     * Only logs if _DEBUG macro is defined.
+     * Debug messages are enabled by default only if _DEBUG macro is defined.
      * @tparam Args Variadic template arguments.
      * @param args Arguments to be logged.
      */
     template<typename... Args>
-        requires ((StreamType<Args>) && ...)
+        requires ((LogArgumentType<Args>) && ...)
     constexpr void debug(Args&&... args)
     {
-#ifdef _DEBUG
         print(LogMode::LogDEBUG, std::forward<Args>(args)...);
-#endif // _DEBUG
     }
 
     /**
-     * @brief Prints a log message to both console and file.
+     * @brief Sets the least severe mode that is logged, e.g. LogWARNING
+     *        drops LogDEBUG and LogINFO. Can be changed at any time.
+     */
+    void setLevel(LogMode level)
+    {
+        m_level.store(getSeverity(level), std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Gets the least severe mode that is logged.
+     */
+    LogMode getLevel() const
+    {
+        constexpr LogMode modes[] = { LogMode::LogDEBUG, LogMode::LogINFO,
+            LogMode::LogWARNING, LogMode::LogERROR, LogMode::LogCRITICAL };
+        return modes[m_level.load(std::memory_order_relaxed)];
+    }
+
+    /**
+     * @brief Checks whether messages of a mode are logged. Arguments that are
+     *        expensive to compute should be passed as callables, or the call
+     *        should be guarded by this function.
+     */
+    bool isEnabled(LogMode mode) const noexcept
+    {
+        return getSeverity(mode) >= m_level.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Formats a log message into the ring buffer,
+     *        the logging thread writes it to both console and file.
      * @tparam Args Variadic template arguments.
      * @param mode Log mode (INFO, WARNING, etc.).
      * @param args Arguments to be logged.
      */
     template<typename... Args>
-        requires ((StreamType<Args>) && ...)
-    void print(LogMode mode, Args... args)
+        requires ((LogArgumentType<Args>) && ...)
+    void print(LogMode mode, Args&&... args)
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_msgQueue.push(std::bind([mode = std::move(mode), this](auto&&... args) {
-            std::string modeString;
+        // Disabled records cost a load and a branch, callables aren't called
+        if (!isEnabled(mode))
+            return;
 
-            switch (mode) {
-            case Logger::LogMode::LogINFO:
-                modeString = "[INFO]";
-                break;
-            case Logger::LogMode::LogWARNING:
-                modeString = "[WRANING]";
-                break;
-            case Logger::LogMode::LogERROR:
-                modeString = "[ERROR]";
-                break;
-            case Logger::LogMode::LogCRITICAL:
-                modeString = "[CRITICAL]";
-                break;
-            case Logger::LogMode::LogDEBUG:
-                modeString = "[DEBUG]";
-                break;
-            default:
-                break;
+        // Claim a slot, several threads may log at the same time
+        Ring::Claim slot;
+        while (!m_ring.tryClaim(slot)) {
+            // The ring buffer is full
+            if (m_overflowPolicy.load(std::memory_order_relaxed) == OverflowPolicy::Drop) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
             }
+            m_cv.notify_one();
+            std::this_thread::yield();
+        }
 
-            std::cout << generateTimeFormatString() << modeString;
-            ((std::cout << args), ...);
-            std::cout << '\n';
+        // Format the record straight into the slot
+        RecordStream& record = getRecordStream();
+        record.buffer.reset(slot.data, slot.data + max_record_size - 1);
+        record.stream.clear();
+        try {
+            record.stream << generateTimeFormatString() << getModeString(mode);
+            (writeArgument(record.stream, std::forward<Args>(args)), ...);
+        } catch (...) {
+            // The slot must be published anyway, or the logging thread stalls
+            record.stream.setstate(std::ios_base::badbit);
+        }
+        std::size_t length = record.buffer.size();
+        if (!record.stream && length >= 3) {
+            // The record was truncated
+            slot.data[length - 1] = slot.data[length - 2] = slot.data[length - 3] = '.';
+        }
+        slot.data[length++] = '\n';
+        m_ring.publish(slot, length);
 
-            m_file << generateTimeFormatString() << modeString;
-            ((m_file << std::forward<decltype(args)>(args)), ...);
-            m_file << std::endl;
-            }, std::forward<Args>(args)...));
-        m_cv.notify_all();
+        // The logging thread wakes up by itself every flush interval,
+        // it is woken early for errors and when the ring buffer fills up
+        if (mode == LogMode::LogERROR || mode == LogMode::LogCRITICAL ||
+            (slot.position & (ring_size / 4 - 1)) == 0)
+            m_cv.notify_one();
+    }
+
+    /**
+     * @brief Sets how long records may stay in memory before they are written.
+     */
+    void setFlushInterval(std::chrono::milliseconds interval)
+    {
+        m_flushInterval.store(interval, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Gets how long records may stay in memory before they are written.
+     */
+    std::chrono::milliseconds getFlushInterval() const
+    {
+        return m_flushInterval.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Sets what print() does when the ring buffer is full.
+     */
+    void setOverflowPolicy(OverflowPolicy policy)
+    {
+        m_overflowPolicy.store(policy, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Gets what print() does when the ring buffer is full.
+     */
+    OverflowPolicy getOverflowPolicy() const
+    {
+        return m_overflowPolicy.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Gets how many records have been dropped because the ring buffer was full.
+     */
+    std::size_t getDroppedCount() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
     }
 
 protected:
+    using Ring = RecordRing<max_record_size, ring_size>;
+
+    /// Stream buffer over a slot, writes past its end are discarded
+    class RecordBuffer: public std::streambuf
+    {
+    public:
+        void reset(char* begin, char* end)
+        {
+            setp(begin, end);
+        }
+
+        std::size_t size() const
+        {
+            return static_cast<std::size_t>(pptr() - pbase());
+        }
+
+    protected:
+        int_type overflow(int_type) override
+        {
+            return traits_type::eof();
+        }
+    };
+
+    struct RecordStream
+    {
+        RecordBuffer    buffer;
+        std::ostream    stream{ &buffer };
+    };
+
+    /**
+     * @brief Gets the stream that formats the records of this thread.
+     */
+    static RecordStream& getRecordStream()
+    {
+        thread_local RecordStream record;
+        return record;
+    }
+
+    template<typename T>
+    static void writeArgument(std::ostream& stream, T&& arg)
+    {
+        if constexpr (std::invocable<T&>)
+            stream << std::invoke(arg);
+        else
+            stream << std::forward<T>(arg);
+    }
+
+    /// Modes ordered from the least severe
+    static constexpr int getSeverity(LogMode mode) noexcept
+    {
+        switch (mode) {
+        case LogMode::LogDEBUG:
+            return 0;
+        case LogMode::LogINFO:
+            return 1;
+        case LogMode::LogWARNING:
+            return 2;
+        case LogMode::LogERROR:
+            return 3;
+        default:
+            return 4;
+        }
+    }
+
+    static std::string_view getModeString(LogMode mode)
+    {
+        switch (mode) {
+        case Logger::LogMode::LogINFO:
+            return "[INFO]";
+        case Logger::LogMode::LogWARNING:
+            return "[WRANING]";
+        case Logger::LogMode::LogERROR:
+            return "[ERROR]";
+        case Logger::LogMode::LogCRITICAL:
+            return "[CRITICAL]";
+        case Logger::LogMode::LogDEBUG:
+            return "[DEBUG]";
+        default:
+            return {};
+        }
+    }
+
+    static std::tm getLocalTime(std::time_t t)
+    {
+        std::tm tm{};
+#ifdef _WIN32
+        localtime_s(&tm, &t);
+#else
+        localtime_r(&t, &tm);
+#endif
+        return tm;
+    }
+
     /**
      * @brief Generates a formatted log file name based on current date.
      * @return Formatted log file name.
      */
     static std::string generateFileName()
     {
-        auto t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        std::tm tm = getLocalTime(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()));
         std::stringstream ss;
-        ss << std::put_time(std::localtime(&t), "%Y-%m-%d.log");
+        ss << std::put_time(&tm, "%Y-%m-%d.log");
         return ss.str();
     }
 
     /**
      * @brief Generates a formatted timestamp string.
+     *        Each thread formats it once per second.
      * @return Formatted timestamp string.
      */
-    static std::string generateTimeFormatString()
+    static std::string_view generateTimeFormatString()
     {
-        auto t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-        std::stringstream ss;
-        ss << std::put_time(std::localtime(&t), "[%H:%M:%S]");
-        return ss.str();
+        thread_local std::time_t    cached_time = -1;
+        thread_local char           cached_string[32] = {};
+        std::time_t t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        if (t != cached_time) {
+            std::tm tm = getLocalTime(t);
+            std::strftime(cached_string, sizeof(cached_string), "[%H:%M:%S]", &tm);
+            cached_time = t;
+        }
+        return cached_string;
     }
 
     /**
@@ -201,36 +405,79 @@ protected:
     bool openFile()
     {
         std::filesystem::create_directory("./logs");
-        m_file.open("./logs/" + generateFileName(), std::ios_base::app);
+        m_file.open("./logs/" + generateFileName(), std::ios_base::app | std::ios_base::binary);
         return static_cast<bool>(m_file);
     }
 
+    /**
+     * @brief Moves the ready records of the ring buffer into the batch.
+     * @return Whether any record was moved
+     */
+    bool drainRing()
+    {
+        bool moved = false;
+        while (m_batch.size() < max_batch_size) {
+            if (!m_ring.consume([this](std::string_view record) { m_batch.append(record); }))
+                break;
+            moved = true;
+        }
+        return moved;
+    }
+
+    /**
+     * @brief Writes the batch to console and file in one call each.
+     */
+    void writeBatch()
+    {
+        if (m_batch.empty())
+            return;
+        std::cout.write(m_batch.data(), static_cast<std::streamsize>(m_batch.size()));
+        std::cout.flush();
+        m_file.write(m_batch.data(), static_cast<std::streamsize>(m_batch.size()));
+        m_file.flush();
+        m_batch.clear();
+    }
+
     /**
      * @brief Background function for logging thread.
-     * Waits for messages in the queue and processes them asynchronously.
+     * Collects the records and writes them in batches.
      */
     void workFunction()
     {
-        while (m_isRunning) {
-            std::unique_lock<std::mutex> lock(m_mutex);
-            m_cv.wait(lock, [&]() {return !m_msgQueue.empty() || !m_isRunning; });
-            if (!m_isRunning && m_msgQueue.empty())
+        while (true) {
+            while (drainRing()) {
+                if (m_batch.size() >= max_batch_size)
+                    writeBatch();
+            }
+            writeBatch();
+            if (!m_isRunning) {
+                // Records that were claimed before the flag was seen
+                if (drainRing())
+                    continue;
                 return;
-            else if (m_msgQueue.empty())
-                continue;
-            std::function<void()> getFunc = std::move(m_msgQueue.front());
-            m_msgQueue.pop();
-            getFunc();
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait_for(lock, m_flushInterval.load(std::memory_order_relaxed));
         }
     }
 
 private:
-    std::ofstream                       m_file;         /**< Log file stream */
-    std::condition_variable             m_cv;           /**< Condition variable for thread synchronization */
-    std::mutex                          m_mutex;        /**< Mutex for protecting shared resources */
-    std::atomic<bool>                   m_isRunning;    /**< Atomic flag for controlling thread termination */
-    std::queue<std::function<void()>>   m_msgQueue;     /**< Queue for storing log message functions */
-    std::thread                         m_thread;       /**< Thread for asynchronous logging */
+    Ring                                    m_ring;         /**< Ring buffer of formatted records */
+    std::atomic<std::size_t>                m_dropped = 0;  /**< Number of dropped records */
+#ifdef _DEBUG
+    std::atomic<int>                        m_level = getSeverity(LogMode::LogDEBUG); /**< Severity of the least severe mode that is logged */
+#else
+    std::atomic<int>                        m_level = getSeverity(LogMode::LogINFO); /**< Severity of the least severe mode that is logged */
+#endif // _DEBUG
+    std::atomic<OverflowPolicy>             m_overflowPolicy = OverflowPolicy::Block; /**< What to do when the ring buffer is full */
+    std::atomic<std::chrono::milliseconds>  m_flushInterval = std::chrono::milliseconds(100); /**< Longest time a record stays in memory */
+    std::string                             m_batch;        /**< Records waiting to be written */
+    std::ofstream                           m_file;         /**< Log file stream */
+    std::condition_variable                 m_cv;           /**< Wakes the logging thread early */
+    std::mutex                              m_mutex;        /**< Mutex for the condition variable */
+    std::atomic<bool>                       m_isRunning;    /**< Atomic flag for controlling thread termination */
+    std::thread                             m_thread;       /**< Thread for asynchronous logging */
 };
 
 } // namespace qls
@@ -0,0 +1,219 @@
+#include "binaryCodec.h"
+
+#include <algorithm>
+#include <bit>
+#include <system_error>
+
+#include "dataPackage.h"
+#include "jsonStreamWriter.h"
+#include "qls_error.h"
+
+namespace qls
+{
+
+/// Deeper values are rejected so a hostile frame can't exhaust the stack
+static constexpr int max_binary_depth = 64;
+
+static void writeVarint(std::string& out, std::uint64_t value)
+{
+    while (value >= 0x80) {
+        out += static_cast<char>(static_cast<std::uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+static inline void writeTag(std::string& out, BinaryTag tag)
+{
+    out += static_cast<char>(tag);
+}
+
+static void writeString(std::string& out, std::string_view str)
+{
+    writeVarint(out, str.size());
+    out += str;
+}
+
+void encodeBinaryJson(const qjson::JObject& json, std::string& out)
+{
+    switch (json.getType()) {
+    case qjson::JInt: {
+        // Zigzag keeps small negative numbers short
+        auto value = static_cast<std::uint64_t>(json.getInt());
+        writeTag(out, BinaryTag::Int);
+        writeVarint(out, (value << 1) ^ (0 - (value >> 63)));
+        break;
+    }
+    case qjson::JDouble: {
+        auto bits = std::bit_cast<std::uint64_t>(static_cast<double>(json.getDouble()));
+        writeTag(out, BinaryTag::Double);
+        for (int i = 0; i < 8; ++i)
+            out += static_cast<char>(bits >> (i * 8));
+        break;
+    }
+    case qjson::JBool:
+        writeTag(out, json.getBool() ? BinaryTag::True : BinaryTag::False);
+        break;
+    case qjson::JString:
+        writeTag(out, BinaryTag::String);
+        writeString(out, json.getString());
+        break;
+    case qjson::JList: {
+        const auto& list = json.getList();
+        writeTag(out, BinaryTag::List);
+        writeVarint(out, list.size());
+        for (const auto& element: list)
+            encodeBinaryJson(element, out);
+        break;
+    }
+    case qjson::JDict: {
+        const auto& dict = json.getDict();
+        writeTag(out, BinaryTag::Dict);
+        writeVarint(out, dict.size());
+        for (const auto& [name, element]: dict) {
+            writeString(out, name);
+            encodeBinaryJson(element, out);
+        }
+        break;
+    }
+    default:
+        writeTag(out, BinaryTag::Null);
+        break;
+    }
+}
+
+/**
+ * @brief Reads binary encoded values from a buffer.
+ */
+class BinaryReader final
+{
+public:
+    BinaryReader(std::string_view data):
+        m_data(data) {}
+
+    qjson::JObject readValue(int depth)
+    {
+        if (depth > max_binary_depth)
+            fail();
+
+        switch (static_cast<BinaryTag>(readByte())) {
+        case BinaryTag::Null:
+            return qjson::JObject();
+        case BinaryTag::False:
+            return qjson::JObject(false);
+        case BinaryTag::True:
+            return qjson::JObject(true);
+        case BinaryTag::Int: {
+            std::uint64_t value = readVarint();
+            return qjson::JObject(static_cast<long long>((value >> 1) ^ (0 - (value & 1))));
+        }
+        case BinaryTag::Double: {
+            if (m_data.size() - m_pos < 8)
+                fail();
+            std::uint64_t bits = 0;
+            for (int i = 0; i < 8; ++i)
+                bits |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(m_data[m_pos + i])) << (i * 8);
+            m_pos += 8;
+            return qjson::JObject(std::bit_cast<double>(bits));
+        }
+        case BinaryTag::String:
+            return qjson::JObject(readString());
+        case BinaryTag::List: {
+            std::uint64_t count = readCount();
+            qjson::JObject json(qjson::JList);
+            auto& list = json.getList();
+            // The count is only bounded by the bytes left, a short frame can claim
+            // a million elements, so reserve a little and let the list grow
+            list.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(count, 256)));
+            for (std::uint64_t i = 0; i < count; ++i)
+                list.emplace_back(readValue(depth + 1));
+            return json;
+        }
+        case BinaryTag::Dict: {
+            std::uint64_t count = readCount();
+            qjson::JObject json(qjson::JDict);
+            auto& dict = json.getDict();
+            for (std::uint64_t i = 0; i < count; ++i) {
+                std::string name(readString());
+                dict.insert_or_assign(std::move(name), readValue(depth + 1));
+            }
+            return json;
+        }
+        default:
+            fail();
+        }
+    }
+
+    bool isFinished() const noexcept
+    {
+        return m_pos == m_data.size();
+    }
+
+private:
+    [[noreturn]] static void fail()
+    {
+        throw std::system_error(qls_errc::invalid_data);
+    }
+
+    std::uint8_t readByte()
+    {
+        if (m_pos >= m_data.size())
+            fail();
+        return static_cast<std::uint8_t>(m_data[m_pos++]);
+    }
+
+    std::uint64_t readVarint()
+    {
+        std::uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            std::uint8_t byte = readByte();
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        fail();
+    }
+
+    /// Every element takes at least one byte, larger counts are forged
+    std::uint64_t readCount()
+    {
+        std::uint64_t count = readVarint();
+        if (count > m_data.size() - m_pos)
+            fail();
+        return count;
+    }
+
+    std::string_view readString()
+    {
+        std::uint64_t size = readVarint();
+        if (size > m_data.size() - m_pos)
+            fail();
+        std::string_view str = m_data.substr(m_pos, size);
+        m_pos += size;
+        return str;
+    }
+
+    std::string_view    m_data;
+    std::size_t         m_pos = 0;
+};
+
+qjson::JObject decodeBinaryJson(std::string_view data)
+{
+    BinaryReader reader(data);
+    qjson::JObject json = reader.readValue(0);
+    if (!reader.isFinished())
+        throw std::system_error(qls_errc::invalid_data);
+    return json;
+}
+
+std::string makeBinaryFrame(const qjson::JObject& json, long long requestID)
+{
+    std::string frame = acquireSendBuffer();
+    frame.resize(sizeof(DataPackage));
+    encodeBinaryJson(json, frame);
+    DataPackage::writeHeader(frame.data(), static_cast<int>(frame.size()),
+        DataPackage::Binary, requestID);
+    return frame;
+}
+
+} // namespace qls
@@ -0,0 +1,57 @@
+#ifndef BINARY_CODEC_H
+#define BINARY_CODEC_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <Json.h>
+
+namespace qls
+{
+
+/**
+ * @brief Tags of the compact binary encoding of json values.
+ *
+ * Every value is a one byte tag followed by its payload:
+ * integers are zigzag varints, doubles are 8 bytes in little endian,
+ * strings carry a varint length, lists and dicts a varint element count
+ * and dict keys are encoded as varint length + bytes.
+ */
+enum class BinaryTag: std::uint8_t
+{
+    Null = 0,
+    False = 1,
+    True = 2,
+    Int = 3,
+    Double = 4,
+    String = 5,
+    List = 6,
+    Dict = 7
+};
+
+/**
+ * @brief Appends the binary encoding of a json value.
+ * @param json Json value
+ * @param out Buffer to append to
+ */
+void encodeBinaryJson(const qjson::JObject& json, std::string& out);
+
+/**
+ * @brief Decodes a json value from its binary encoding.
+ * @param data Binary encoding of exactly one value
+ * @return Decoded json value
+ * @throw std::system_error(qls_errc::invalid_data) if the data is malformed
+ */
+[[nodiscard]] qjson::JObject decodeBinaryJson(std::string_view data);
+
+/**
+ * @brief Encodes a json value into a pooled send buffer as a binary data package.
+ * @param json Json value
+ * @param requestID Request ID associated with the data package
+ * @return Data package in network byte order
+ */
+[[nodiscard]] std::string makeBinaryFrame(const qjson::JObject& json, long long requestID = 0);
+
+} // namespace qls
+
+#endif // !BINARY_CODEC_H
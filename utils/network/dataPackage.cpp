@@ -8,6 +8,8 @@
 
 #include "networkEndianness.hpp"
 #include "qls_error.h"
+#include "lzCodec.h"
+#include "jsonStreamWriter.h"
 
 namespace qls
 {
@@ -103,6 +105,88 @@ std::string DataPackage::packageToString() noexcept
     return strdata;
 }
 
+void DataPackage::writeHeader(char* out, int length, DataPackageType type,
+    long long requestID, int sequence, int sequenceSize) noexcept
+{
+    int int_type = static_cast<int>(type);
+    if (!isBigEndianness()) {
+        length = swapEndianness(length);
+        int_type = swapEndianness(int_type);
+        sequenceSize = swapEndianness(sequenceSize);
+        sequence = swapEndianness(sequence);
+        requestID = swapEndianness(requestID);
+    }
+
+    // Same layout as the packed members of DataPackage
+    std::memcpy(out, &length, sizeof(int));
+    std::memcpy(out + 4, &int_type, sizeof(int));
+    std::memcpy(out + 8, &sequenceSize, sizeof(int));
+    std::memcpy(out + 12, &sequence, sizeof(int));
+    std::memcpy(out + 16, &requestID, sizeof(long long));
+}
+
+std::string DataPackage::compressFrame(std::string_view frame, LzCompressor& compressor)
+{
+    // Keep the header, the original size follows it
+    std::string compressed = acquireSendBuffer();
+    compressed.assign(frame.substr(0, sizeof(DataPackage)));
+    compressed.resize(sizeof(DataPackage) + sizeof(int));
+    compressor.compress(frame.substr(sizeof(DataPackage)), compressed);
+    if (compressed.size() >= frame.size()) {
+        releaseSendBuffer(std::move(compressed));
+        return {};
+    }
+
+    int length = static_cast<int>(compressed.size());
+    int original_size = static_cast<int>(frame.size() - sizeof(DataPackage));
+    int type = 0;
+    std::memcpy(&type, frame.data() + 4, sizeof(int));
+    if (!isBigEndianness()) {
+        length = swapEndianness(length);
+        original_size = swapEndianness(original_size);
+        type = swapEndianness(swapEndianness(type) | compressed_flag);
+    } else {
+        type |= compressed_flag;
+    }
+
+    std::memcpy(compressed.data(), &length, sizeof(int));
+    std::memcpy(compressed.data() + 4, &type, sizeof(int));
+    std::memcpy(compressed.data() + sizeof(DataPackage), &original_size, sizeof(int));
+    return compressed;
+}
+
+std::vector<std::string> DataPackage::splitFrame(std::string_view frame, std::size_t max_frame_size)
+{
+    if (max_frame_size <= sizeof(DataPackage))
+        throw std::system_error(qls_errc::invalid_data);
+
+    int type = 0;
+    long long requestID = 0;
+    std::memcpy(&type, frame.data() + 4, sizeof(int));
+    std::memcpy(&requestID, frame.data() + 16, sizeof(long long));
+    if (!isBigEndianness()) {
+        type = swapEndianness(type);
+        requestID = swapEndianness(requestID);
+    }
+
+    const std::string_view data = frame.substr(sizeof(DataPackage));
+    const std::size_t fragment_data_size = max_frame_size - sizeof(DataPackage);
+    const std::size_t count = (data.size() + fragment_data_size - 1) / fragment_data_size;
+
+    std::vector<std::string> fragments;
+    fragments.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        std::string fragment = acquireSendBuffer();
+        fragment.resize(sizeof(DataPackage));
+        fragment += data.substr(i * fragment_data_size, fragment_data_size);
+        writeHeader(fragment.data(), static_cast<int>(fragment.size()),
+            static_cast<DataPackageType>(type), requestID,
+            static_cast<int>(i), static_cast<int>(count));
+        fragments.emplace_back(std::move(fragment));
+    }
+    return fragments;
+}
+
 std::size_t DataPackage::getPackageSize() noexcept
 {
     int size = 0;
@@ -4,10 +4,13 @@
 #include <string>
 #include <memory>
 #include <string_view>
+#include <vector>
 
 namespace qls
 {
 
+class LzCompressor;
+
 /**
  * @class DataPackage
  * @brief Represents a data package with metadata and binary data.
@@ -24,6 +27,10 @@ public:
         HeartBeat = 4
     };
 
+    /// Set in the type field when the data is compressed by LzCompressor,
+    /// the data then starts with its original size as an int in network byte order
+    static constexpr int compressed_flag = 0x100;
+
 private:
 #pragma pack(1)
     int                 length = 0;                         ///< Length of the data package.
@@ -64,6 +71,37 @@ public:
      */
     [[nodiscard]] std::string packageToString() noexcept;
 
+    /**
+     * @brief Writes a data package header in network byte order.
+     * @param out Buffer of at least sizeof(DataPackage) bytes
+     * @param length Length of the whole data package, including the header
+     * @param type Type identifier of the data package
+     * @param requestID Request ID associated with the data package
+     * @param sequence Sequence number of the data package
+     * @param sequenceSize Sequence size
+     */
+    static void writeHeader(char* out, int length, DataPackageType type,
+        long long requestID = 0, int sequence = 0, int sequenceSize = 1) noexcept;
+
+    /**
+     * @brief Compresses the data of a data package in network byte order
+     *        and sets compressed_flag in its type field.
+     * @param frame Data package, e.g. from JsonStreamWriter::finish()
+     * @param compressor Compressor of the connection
+     * @return Compressed data package, or an empty string if it wouldn't be smaller
+     */
+    [[nodiscard]] static std::string compressFrame(std::string_view frame, LzCompressor& compressor);
+
+    /**
+     * @brief Splits a data package in network byte order into fragments, each of
+     *        which keeps the type and requestID and gets its sequence and sequenceSize.
+     * @param frame Data package with sequenceSize 1
+     * @param max_frame_size Maximum size of a fragment, including the header
+     * @return Fragments in order
+     */
+    [[nodiscard]] static std::vector<std::string> splitFrame(std::string_view frame,
+        std::size_t max_frame_size);
+
     /**
      * @brief Gets the size of this data package.
      * @return Size of this data package.
@@ -0,0 +1,56 @@
+#include "fragmentAssembler.h"
+
+#include <system_error>
+
+#include "qls_error.h"
+
+namespace qls
+{
+
+FragmentAssembler::FragmentAssembler(std::size_t memory_limit, std::size_t max_pending):
+    m_memory_limit(memory_limit),
+    m_max_pending(max_pending) {}
+
+std::optional<std::string> FragmentAssembler::feed(DataPackage& pack)
+{
+    if (pack.sequenceSize < 2 || pack.sequence < 0 || pack.sequence >= pack.sequenceSize)
+        throw std::system_error(qls_errc::invalid_data);
+
+    const std::size_t size = pack.getDataSize();
+    if (size > m_memory_limit - m_buffered_size)
+        throw std::system_error(qls_errc::data_too_large);
+
+    auto iter = m_partials.find(pack.requestID);
+    if (iter == m_partials.end()) {
+        // The first fragment opens a new message
+        if (pack.sequence != 0)
+            throw std::system_error(qls_errc::invalid_data);
+        if (m_partials.size() >= m_max_pending)
+            throw std::system_error(qls_errc::data_too_large);
+        iter = m_partials.emplace(pack.requestID,
+            PartialMessage{ pack.type, pack.sequenceSize, 0, {} }).first;
+    }
+
+    PartialMessage& message = iter->second;
+    if (message.next_sequence != pack.sequence ||
+        message.sequenceSize != pack.sequenceSize ||
+        message.type != pack.type)
+        throw std::system_error(qls_errc::invalid_data);
+
+    message.data.append(pack.data, size);
+    m_buffered_size += size;
+    if (++message.next_sequence < message.sequenceSize)
+        return std::nullopt;
+
+    std::string data = std::move(message.data);
+    m_buffered_size -= data.size();
+    m_partials.erase(iter);
+    return data;
+}
+
+std::size_t FragmentAssembler::getBufferedSize() const noexcept
+{
+    return m_buffered_size;
+}
+
+} // namespace qls
@@ -0,0 +1,70 @@
+#ifndef FRAGMENT_ASSEMBLER_H
+#define FRAGMENT_ASSEMBLER_H
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "dataPackage.h"
+
+namespace qls
+{
+
+/**
+ * @class FragmentAssembler
+ * @brief Reassembles messages split over several data packages.
+ *
+ * Fragments of a message share its requestID and type, and carry their
+ * position in sequence and the number of fragments in sequenceSize.
+ * Fragments of different messages may interleave, but the fragments of
+ * one message must arrive in order. Each connection has its own assembler.
+ */
+class FragmentAssembler final
+{
+public:
+    /// Default limit of the memory held by unfinished messages of a connection
+    static constexpr std::size_t default_memory_limit = 16 * 1024 * 1024;
+    /// Default limit of the number of unfinished messages of a connection
+    static constexpr std::size_t default_max_pending = 16;
+
+    FragmentAssembler(std::size_t memory_limit = default_memory_limit,
+        std::size_t max_pending = default_max_pending);
+    FragmentAssembler(const FragmentAssembler&) = delete;
+    FragmentAssembler(FragmentAssembler&&) = delete;
+    ~FragmentAssembler() noexcept = default;
+
+    FragmentAssembler& operator=(const FragmentAssembler&) = delete;
+    FragmentAssembler& operator=(FragmentAssembler&&) = delete;
+
+    /**
+     * @brief Adds a fragment.
+     * @param pack Data package with sequenceSize > 1
+     * @return Data of the whole message if this was its last fragment
+     * @throw std::system_error(qls_errc::invalid_data) if the fragment is out of order,
+     *        std::system_error(qls_errc::data_too_large) if a limit is exceeded
+     */
+    [[nodiscard]] std::optional<std::string> feed(DataPackage& pack);
+
+    /**
+     * @brief Gets the number of bytes held by unfinished messages.
+     */
+    [[nodiscard]] std::size_t getBufferedSize() const noexcept;
+
+private:
+    struct PartialMessage
+    {
+        DataPackage::DataPackageType    type;
+        int                             sequenceSize;
+        int                             next_sequence;
+        std::string                     data;
+    };
+
+    std::unordered_map<long long, PartialMessage>   m_partials;
+    std::size_t                                     m_buffered_size = 0;
+    const std::size_t                               m_memory_limit;
+    const std::size_t                               m_max_pending;
+};
+
+} // namespace qls
+
+#endif // !FRAGMENT_ASSEMBLER_H
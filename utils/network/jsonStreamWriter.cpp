@@ -0,0 +1,260 @@
+#include "jsonStreamWriter.h"
+
+#include <charconv>
+#include <cmath>
+
+namespace qls
+{
+
+static constexpr std::size_t initial_buffer_capacity = 1024;
+static constexpr std::size_t max_pooled_buffer_capacity = 64 * 1024;
+static constexpr std::size_t max_pooled_buffers = 64;
+
+static thread_local std::vector<std::string> local_send_buffer_pool;
+
+std::string acquireSendBuffer()
+{
+    if (local_send_buffer_pool.empty()) {
+        std::string buffer;
+        buffer.reserve(initial_buffer_capacity);
+        return buffer;
+    }
+
+    std::string buffer = std::move(local_send_buffer_pool.back());
+    local_send_buffer_pool.pop_back();
+    return buffer;
+}
+
+void releaseSendBuffer(std::string&& buffer) noexcept
+{
+    // Huge buffers are freed instead of being kept by the pool
+    if (buffer.capacity() > max_pooled_buffer_capacity ||
+        local_send_buffer_pool.size() >= max_pooled_buffers)
+        return;
+
+    try {
+        buffer.clear();
+        local_send_buffer_pool.emplace_back(std::move(buffer));
+    } catch (...) {}
+}
+
+std::shared_ptr<const std::string> makeSharedSendBuffer(std::string&& buffer)
+{
+    return std::shared_ptr<const std::string>(new std::string(std::move(buffer)),
+        [](const std::string* buffer_ptr) {
+            releaseSendBuffer(std::move(*const_cast<std::string*>(buffer_ptr)));
+            delete buffer_ptr;
+        });
+}
+
+JsonStreamWriter::JsonStreamWriter():
+    m_buffer(acquireSendBuffer())
+{
+    m_buffer.resize(sizeof(DataPackage));
+}
+
+JsonStreamWriter::~JsonStreamWriter() noexcept
+{
+    releaseSendBuffer(std::move(m_buffer));
+}
+
+void JsonStreamWriter::beforeValue()
+{
+    if (m_after_key) {
+        m_after_key = false;
+        return;
+    }
+    if (!m_has_element.empty()) {
+        if (m_has_element.back())
+            m_buffer += ',';
+        m_has_element.back() = true;
+    }
+}
+
+JsonStreamWriter& JsonStreamWriter::startObject()
+{
+    beforeValue();
+    m_buffer += '{';
+    m_has_element.push_back(false);
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::endObject()
+{
+    m_buffer += '}';
+    m_has_element.pop_back();
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::startArray()
+{
+    beforeValue();
+    m_buffer += '[';
+    m_has_element.push_back(false);
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::endArray()
+{
+    m_buffer += ']';
+    m_has_element.pop_back();
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::key(std::string_view name)
+{
+    beforeValue();
+    writeString(name);
+    m_buffer += ':';
+    m_after_key = true;
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::value(std::string_view str)
+{
+    beforeValue();
+    writeString(str);
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::value(bool boolean)
+{
+    beforeValue();
+    m_buffer += boolean ? "true" : "false";
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::value(double number)
+{
+    beforeValue();
+    // Json has no representation of nan and inf
+    if (!std::isfinite(number)) {
+        m_buffer += "null";
+        return *this;
+    }
+    char local[32];
+    auto result = std::to_chars(local, local + sizeof(local), number);
+    m_buffer.append(local, result.ptr);
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::value(const qjson::JObject& json)
+{
+    switch (json.getType()) {
+    case qjson::JNull:
+        return nullValue();
+    case qjson::JInt:
+        return writeInteger(json.getInt());
+    case qjson::JDouble:
+        return value(static_cast<double>(json.getDouble()));
+    case qjson::JBool:
+        return value(json.getBool());
+    case qjson::JString:
+        return value(json.getString());
+    case qjson::JList:
+        startArray();
+        for (const auto& element: json.getList())
+            value(element);
+        return endArray();
+    case qjson::JDict:
+        startObject();
+        for (const auto& [name, element]: json.getDict()) {
+            key(name);
+            value(element);
+        }
+        return endObject();
+    default:
+        return nullValue();
+    }
+}
+
+JsonStreamWriter& JsonStreamWriter::nullValue()
+{
+    beforeValue();
+    m_buffer += "null";
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::raw(std::string_view json)
+{
+    beforeValue();
+    m_buffer += json;
+    return *this;
+}
+
+JsonStreamWriter& JsonStreamWriter::message(std::string_view state, std::string_view msg)
+{
+    return startObject()
+        .member("state", state)
+        .member("message", msg)
+        .endObject();
+}
+
+std::string_view JsonStreamWriter::getJson() const noexcept
+{
+    return std::string_view(m_buffer).substr(sizeof(DataPackage));
+}
+
+std::string JsonStreamWriter::finish(DataPackage::DataPackageType type,
+    long long requestID, int sequence, int sequenceSize)
+{
+    DataPackage::writeHeader(m_buffer.data(), static_cast<int>(m_buffer.size()),
+        type, requestID, sequence, sequenceSize);
+
+    std::string frame = std::move(m_buffer);
+    m_buffer = acquireSendBuffer();
+    m_buffer.resize(sizeof(DataPackage));
+    m_has_element.clear();
+    m_after_key = false;
+    return frame;
+}
+
+std::shared_ptr<const std::string> JsonStreamWriter::finishShared(
+    DataPackage::DataPackageType type, long long requestID)
+{
+    return makeSharedSendBuffer(finish(type, requestID));
+}
+
+JsonStreamWriter& JsonStreamWriter::writeInteger(long long number)
+{
+    beforeValue();
+    char local[24];
+    auto result = std::to_chars(local, local + sizeof(local), number);
+    m_buffer.append(local, result.ptr);
+    return *this;
+}
+
+void JsonStreamWriter::writeString(std::string_view str)
+{
+    static constexpr char hex_digits[] = "0123456789abcdef";
+
+    m_buffer += '"';
+    std::size_t plain_begin = 0;
+    for (std::size_t i = 0; i < str.size(); ++i) {
+        unsigned char ch = static_cast<unsigned char>(str[i]);
+        if (ch >= 0x20 && ch != '"' && ch != '\\')
+            continue;
+
+        // Copy the run of characters that need no escaping at once
+        m_buffer.append(str.data() + plain_begin, i - plain_begin);
+        plain_begin = i + 1;
+        switch (ch) {
+        case '"':   m_buffer += "\\\""; break;
+        case '\\':  m_buffer += "\\\\"; break;
+        case '\b':  m_buffer += "\\b"; break;
+        case '\f':  m_buffer += "\\f"; break;
+        case '\n':  m_buffer += "\\n"; break;
+        case '\r':  m_buffer += "\\r"; break;
+        case '\t':  m_buffer += "\\t"; break;
+        default:
+            m_buffer += "\\u00";
+            m_buffer += hex_digits[ch >> 4];
+            m_buffer += hex_digits[ch & 0xF];
+            break;
+        }
+    }
+    m_buffer.append(str.data() + plain_begin, str.size() - plain_begin);
+    m_buffer += '"';
+}
+
+} // namespace qls
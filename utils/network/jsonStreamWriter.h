@@ -0,0 +1,127 @@
+#ifndef JSON_STREAM_WRITER_H
+#define JSON_STREAM_WRITER_H
+
+#include <concepts>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <Json.h>
+
+#include "dataPackage.h"
+
+namespace qls
+{
+
+/**
+ * @brief Gets an empty send buffer from the pool of this thread.
+ */
+[[nodiscard]] std::string acquireSendBuffer();
+
+/**
+ * @brief Gives a send buffer back to the pool of this thread.
+ */
+void releaseSendBuffer(std::string&& buffer) noexcept;
+
+/**
+ * @brief Wraps a send buffer so it can be shared by several writes,
+ *        the buffer goes back to the pool when the last owner releases it.
+ */
+[[nodiscard]] std::shared_ptr<const std::string> makeSharedSendBuffer(std::string&& buffer);
+
+/**
+ * @class JsonStreamWriter
+ * @brief Serializes json straight into a pooled send buffer.
+ *
+ * Room for the data package header is reserved at the front of the buffer
+ * and filled in by finish(), so the frame is written without intermediate copies.
+ */
+class JsonStreamWriter final
+{
+public:
+    JsonStreamWriter();
+    JsonStreamWriter(const JsonStreamWriter&) = delete;
+    JsonStreamWriter(JsonStreamWriter&&) = delete;
+    ~JsonStreamWriter() noexcept;
+
+    JsonStreamWriter& operator=(const JsonStreamWriter&) = delete;
+    JsonStreamWriter& operator=(JsonStreamWriter&&) = delete;
+
+    JsonStreamWriter& startObject();
+    JsonStreamWriter& endObject();
+    JsonStreamWriter& startArray();
+    JsonStreamWriter& endArray();
+
+    /**
+     * @brief Writes the key of the next member of the current object.
+     */
+    JsonStreamWriter& key(std::string_view name);
+
+    JsonStreamWriter& value(std::string_view str);
+    JsonStreamWriter& value(const char* str) { return value(std::string_view(str)); }
+    JsonStreamWriter& value(const std::string& str) { return value(std::string_view(str)); }
+    JsonStreamWriter& value(bool boolean);
+    JsonStreamWriter& value(double number);
+    JsonStreamWriter& value(const qjson::JObject& json);
+    JsonStreamWriter& nullValue();
+
+    template<std::integral T>
+        requires (!std::same_as<T, bool>)
+    JsonStreamWriter& value(T number)
+    {
+        return writeInteger(static_cast<long long>(number));
+    }
+
+    /**
+     * @brief Writes a member of the current object.
+     */
+    template<class T>
+    JsonStreamWriter& member(std::string_view name, T&& val)
+    {
+        key(name);
+        return value(std::forward<T>(val));
+    }
+
+    /**
+     * @brief Writes already serialized json as the next value.
+     */
+    JsonStreamWriter& raw(std::string_view json);
+
+    /**
+     * @brief Writes {"state": state, "message": msg}, same as makeMessage().
+     */
+    JsonStreamWriter& message(std::string_view state, std::string_view msg);
+
+    /**
+     * @brief Gets the json that has been written.
+     */
+    [[nodiscard]] std::string_view getJson() const noexcept;
+
+    /**
+     * @brief Fills the reserved header and hands the frame over.
+     *        The writer is reset and can be used again.
+     * @return Data package in network byte order
+     */
+    [[nodiscard]] std::string finish(DataPackage::DataPackageType type,
+        long long requestID = 0, int sequence = 0, int sequenceSize = 1);
+
+    /**
+     * @brief Same as finish(), but the frame can be shared by several writes.
+     */
+    [[nodiscard]] std::shared_ptr<const std::string> finishShared(
+        DataPackage::DataPackageType type, long long requestID = 0);
+
+private:
+    JsonStreamWriter& writeInteger(long long number);
+    void writeString(std::string_view str);
+    void beforeValue();
+
+    std::string         m_buffer;
+    /// For each open object or array: whether it already has an element
+    std::vector<bool>   m_has_element;
+    bool                m_after_key = false;
+};
+
+} // namespace qls
+
+#endif // !JSON_STREAM_WRITER_H
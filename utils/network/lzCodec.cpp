@@ -0,0 +1,197 @@
+#include "lzCodec.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace qls
+{
+
+static constexpr int            hash_log = 12;
+static constexpr std::size_t    min_match = 4;
+static constexpr std::size_t    max_offset = 65535;
+static constexpr std::size_t    last_literals = 5;  ///< The block must end with literals
+static constexpr std::size_t    match_find_limit = 12;  ///< No match starts this close to the end
+
+/// Fragments of the replies that are sent the most
+static constexpr std::string_view default_dictionary =
+    R"({"state":"error","message":"UserID is invalid!"})"
+    R"({"state":"error","message":"GroupID is invalid!"})"
+    R"({"state":"error","message":"You haven't logged in!"})"
+    R"({"state":"success","message":"Successfully sent a message!"})"
+    R"({"state":"success","message":"Successfully getting result!","result":true})"
+    R"({"state":"success","message":"Successfully obtained group list!","group_list":[)"
+    R"({"state":"success","message":"Successfully obtained verification list!","result":[)"
+    R"({"user_id":,"verification_type":,"message":""},)"
+    R"({"group_id":,"user_id":,"verification_type":,"message":""},)"
+    R"({"type":"private_message","data":{"user_id":,"message":""}})"
+    R"({"type":"group_message","data":{"group_id":,"user_id":,"message":""}})"
+    R"({"state":"success","message":"Successfully obtained friend list!","friend_list":[)";
+
+std::string_view getDefaultCompressionDictionary() noexcept
+{
+    return default_dictionary;
+}
+
+static inline std::uint32_t read32(const char* ptr) noexcept
+{
+    std::uint32_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static inline std::uint32_t hashSequence(std::uint32_t sequence) noexcept
+{
+    return (sequence * 2654435761u) >> (32 - hash_log);
+}
+
+static void writeLengthExtension(std::string& out, std::size_t length)
+{
+    while (length >= 255) {
+        out += static_cast<char>(255);
+        length -= 255;
+    }
+    out += static_cast<char>(length);
+}
+
+static void writeLiterals(std::string& out, char& token, const char* literals, std::size_t size)
+{
+    token = static_cast<char>(std::min<std::size_t>(size, 15) << 4);
+    if (size >= 15)
+        writeLengthExtension(out, size - 15);
+    out.append(literals, size);
+}
+
+LzCompressor::LzCompressor(std::string_view dictionary):
+    m_dictionary_size(std::min(dictionary.size(), max_offset)),
+    m_dictionary_table(std::size_t(1) << hash_log, 0)
+{
+    m_window.assign(dictionary.substr(dictionary.size() - m_dictionary_size));
+    for (std::size_t pos = 0; pos + min_match <= m_dictionary_size; ++pos)
+        m_dictionary_table[hashSequence(read32(m_window.data() + pos))] = static_cast<std::uint32_t>(pos);
+    m_table.resize(m_dictionary_table.size());
+}
+
+std::size_t LzCompressor::compress(std::string_view data, std::string& out)
+{
+    const std::size_t out_begin = out.size();
+
+    m_window.resize(m_dictionary_size);
+    m_window.append(data);
+    std::copy(m_dictionary_table.cbegin(), m_dictionary_table.cend(), m_table.begin());
+
+    const char*         src = m_window.data();
+    const std::size_t   end = m_window.size();
+    std::size_t         anchor = m_dictionary_size;
+    std::size_t         ip = m_dictionary_size;
+
+    if (data.size() > match_find_limit) {
+        const std::size_t match_start_limit = end - match_find_limit;
+        const std::size_t match_end_limit = end - last_literals;
+        while (ip < match_start_limit) {
+            const std::uint32_t sequence = read32(src + ip);
+            const std::uint32_t hash = hashSequence(sequence);
+            std::size_t ref = m_table[hash];
+            m_table[hash] = static_cast<std::uint32_t>(ip);
+            if (ref >= ip || ip - ref > max_offset || read32(src + ref) != sequence) {
+                // Skip faster through data that doesn't compress
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                --ip;
+                --ref;
+            }
+            std::size_t length = min_match;
+            while (ip + length < match_end_limit && src[ref + length] == src[ip + length])
+                ++length;
+
+            // token, literals, offset, match length
+            const std::size_t token_pos = out.size();
+            out += '\0';
+            char token;
+            writeLiterals(out, token, src + anchor, ip - anchor);
+            const std::size_t offset = ip - ref;
+            out += static_cast<char>(offset & 0xFF);
+            out += static_cast<char>(offset >> 8);
+            token |= static_cast<char>(std::min<std::size_t>(length - min_match, 15));
+            if (length - min_match >= 15)
+                writeLengthExtension(out, length - min_match - 15);
+            out[token_pos] = token;
+
+            ip += length;
+            anchor = ip;
+            if (ip < match_start_limit)
+                m_table[hashSequence(read32(src + ip - 2))] = static_cast<std::uint32_t>(ip - 2);
+        }
+    }
+
+    const std::size_t token_pos = out.size();
+    out += '\0';
+    char token;
+    writeLiterals(out, token, src + anchor, end - anchor);
+    out[token_pos] = token;
+    return out.size() - out_begin;
+}
+
+std::string_view LzCompressor::getDictionary() const noexcept
+{
+    return std::string_view(m_window).substr(0, m_dictionary_size);
+}
+
+static bool readLengthExtension(std::string_view block, std::size_t& pos, std::size_t& length)
+{
+    while (true) {
+        if (pos >= block.size())
+            return false;
+        auto byte = static_cast<std::uint8_t>(block[pos++]);
+        length += byte;
+        if (byte != 255)
+            return true;
+    }
+}
+
+bool lzDecompress(std::string_view block, std::size_t original_size,
+    std::string& out, std::string_view dictionary)
+{
+    dictionary = dictionary.substr(dictionary.size() - std::min(dictionary.size(), max_offset));
+    out.resize(original_size);
+    char*       dst = out.data();
+    std::size_t op = 0;
+    std::size_t pos = 0;
+
+    while (pos < block.size()) {
+        const auto token = static_cast<std::uint8_t>(block[pos++]);
+
+        std::size_t literals = token >> 4;
+        if (literals == 15 && !readLengthExtension(block, pos, literals))
+            return false;
+        if (literals > block.size() - pos || literals > original_size - op)
+            return false;
+        std::memcpy(dst + op, block.data() + pos, literals);
+        pos += literals;
+        op += literals;
+        if (pos == block.size())
+            break;
+
+        if (block.size() - pos < 2)
+            return false;
+        const std::size_t offset = static_cast<std::uint8_t>(block[pos]) |
+            (static_cast<std::size_t>(static_cast<std::uint8_t>(block[pos + 1])) << 8);
+        pos += 2;
+        std::size_t length = (token & 15) + min_match;
+        if ((token & 15) == 15 && !readLengthExtension(block, pos, length))
+            return false;
+        if (offset == 0 || offset > op + dictionary.size() || length > original_size - op)
+            return false;
+
+        // Copy byte by byte, the match may overlap the output
+        for (std::size_t i = 0; i < length; ++i, ++op) {
+            dst[op] = offset > op ?
+                dictionary[dictionary.size() - (offset - op)] : dst[op - offset];
+        }
+    }
+    return op == original_size;
+}
+
+} // namespace qls
@@ -0,0 +1,82 @@
+#ifndef LZ_CODEC_H
+#define LZ_CODEC_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace qls
+{
+
+/**
+ * @brief Gets the built-in dictionary shared by the server and the clients.
+ *
+ * It holds fragments that appear in most replies, so even small frames
+ * find matches. Changing it breaks compatibility with existing clients.
+ *
+ * Every frame is compressed against this dictionary alone, the window doesn't
+ * carry over from one frame to the next. Replies of pipelined requests are
+ * fragmented and interleaved, so a client completes them in another order than
+ * they were compressed and couldn't rebuild a shared window. Repeated content
+ * across frames is therefore not found, only what the dictionary holds.
+ */
+[[nodiscard]] std::string_view getDefaultCompressionDictionary() noexcept;
+
+/**
+ * @class LzCompressor
+ * @brief LZ77 compressor that writes the LZ4 block format.
+ *
+ * Matches may reference the dictionary as if it preceded the data. The hash
+ * table of the dictionary is computed once and every compressor keeps its
+ * own working buffers, so compressing a frame doesn't allocate after warm-up.
+ * A compressor isn't thread safe, keep one per connection.
+ */
+class LzCompressor final
+{
+public:
+    /**
+     * @param dictionary Dictionary, only the last 64 KiB are used
+     */
+    explicit LzCompressor(std::string_view dictionary = getDefaultCompressionDictionary());
+    LzCompressor(const LzCompressor&) = delete;
+    LzCompressor(LzCompressor&&) = delete;
+    ~LzCompressor() noexcept = default;
+
+    LzCompressor& operator=(const LzCompressor&) = delete;
+    LzCompressor& operator=(LzCompressor&&) = delete;
+
+    /**
+     * @brief Compresses data and appends the block to a buffer.
+     * @param data Data to compress
+     * @param out Buffer to append to
+     * @return Size of the compressed block
+     */
+    std::size_t compress(std::string_view data, std::string& out);
+
+    /**
+     * @brief Gets the dictionary of this compressor.
+     */
+    [[nodiscard]] std::string_view getDictionary() const noexcept;
+
+private:
+    std::size_t                 m_dictionary_size;
+    std::string                 m_window;           ///< Dictionary followed by the data
+    std::vector<std::uint32_t>  m_dictionary_table; ///< Hash table of the dictionary
+    std::vector<std::uint32_t>  m_table;            ///< Working hash table
+};
+
+/**
+ * @brief Decompresses an LZ4 block.
+ * @param block Compressed block
+ * @param original_size Size of the data before compression
+ * @param out Receives the data
+ * @param dictionary Dictionary used by the compressor
+ * @return false if the block is malformed
+ */
+[[nodiscard]] bool lzDecompress(std::string_view block, std::size_t original_size,
+    std::string& out, std::string_view dictionary = getDefaultCompressionDictionary());
+
+} // namespace qls
+
+#endif // !LZ_CODEC_H
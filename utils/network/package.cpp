@@ -1,5 +1,6 @@
 #include "package.h"
 
+#include <algorithm>
 #include <system_error>
 #include <cstring>
 
@@ -8,31 +9,40 @@
 
 void qls::Package::write(std::string_view data)
 {
+    // Drop the data packages that were read before the buffer grows,
+    // so the unread bytes are moved once instead of after every read
+    if (m_read_offset == m_buffer.size()) {
+        m_buffer.clear();
+        m_read_offset = 0;
+    } else if (m_read_offset >= compact_threshold && m_read_offset >= m_buffer.size() / 2) {
+        m_buffer.erase(0, m_read_offset);
+        m_read_offset = 0;
+    }
     m_buffer += data;
 }
 
 bool qls::Package::canRead() const
 {
-    if (m_buffer.size() < sizeof(int))
+    if (m_buffer.size() - m_read_offset < sizeof(int))
         return false;
 
     int length = 0;
-    std::memcpy(&length, m_buffer.c_str(), sizeof(int));
+    std::memcpy(&length, m_buffer.c_str() + m_read_offset, sizeof(int));
     length = qls::swapNetworkEndianness(length);
-    if (length > INT32_MAX / 2)
+    if (length < 0 || std::size_t(length) > m_max_frame_size)
         throw std::system_error(qls_errc::data_too_large);
-    else if (length > m_buffer.size())
+    else if (std::size_t(length) > m_buffer.size() - m_read_offset)
         return false;
     return true;
 }
 
 std::size_t qls::Package::firstMsgLength() const
 {
-    if (m_buffer.size() < sizeof(int))
+    if (m_buffer.size() - m_read_offset < sizeof(int))
         return 0;
 
     int length = 0;
-    std::memcpy(&length, m_buffer.c_str(), sizeof(int));
+    std::memcpy(&length, m_buffer.c_str() + m_read_offset, sizeof(int));
     length = qls::swapNetworkEndianness(length);
     return std::size_t(length);
 }
@@ -44,20 +54,31 @@ std::string qls::Package::read()
     else if (!firstMsgLength())
         throw std::system_error(qls_errc::empty_length);
 
-    std::string result = m_buffer.substr(0, firstMsgLength());
-    m_buffer = m_buffer.substr(firstMsgLength());
+    std::string result = m_buffer.substr(m_read_offset, firstMsgLength());
+    m_read_offset += result.size();
 
     return result;
 }
 
 std::string_view qls::Package::readBuffer() const
 {
-    return m_buffer;
+    return std::string_view(m_buffer).substr(m_read_offset);
 }
 
 void qls::Package::setBuffer(std::string_view b)
 {
     m_buffer = b;
+    m_read_offset = 0;
+}
+
+void qls::Package::setMaxFrameSize(std::size_t size)
+{
+    m_max_frame_size = std::min<std::size_t>(size, INT32_MAX / 2);
+}
+
+std::size_t qls::Package::getMaxFrameSize() const
+{
+    return m_max_frame_size;
 }
 
 std::string qls::Package::makePackage(std::string_view data)
@@ -13,6 +13,11 @@ namespace qls
 class Package final
 {
 public:
+    /// Default maximum size of a data package, larger messages must be fragmented
+    static constexpr std::size_t default_max_frame_size = 1024 * 1024;
+    /// Read bytes kept at the front of the buffer before it is compacted
+    static constexpr std::size_t compact_threshold = 64 * 1024;
+
     Package() = default;
     ~Package() noexcept = default;
 
@@ -58,6 +63,18 @@ public:
      */
     void setBuffer(std::string_view buffer);
 
+    /**
+     * @brief Sets the maximum size of a data package, canRead() throws
+     *        qls_errc::data_too_large for larger ones.
+     * @param size Maximum size in bytes, including the header
+     */
+    void setMaxFrameSize(std::size_t size);
+
+    /**
+     * @brief Gets the maximum size of a data package.
+     */
+    [[nodiscard]] std::size_t getMaxFrameSize() const;
+
     /**
      * @brief Creates a data package from binary data.
      * @param data The binary data.
@@ -67,6 +84,8 @@ public:
 
 private:
     std::string m_buffer; ///< The buffer to store the data.
+    std::size_t m_read_offset = 0; ///< Start of the data that wasn't read yet.
+    std::size_t m_max_frame_size = default_max_frame_size; ///< Maximum size of a data package.
 };
 
 } // namespace qls
@@ -0,0 +1,350 @@
+#ifndef PROFILED_SHARED_MUTEX_HPP
+#define PROFILED_SHARED_MUTEX_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace qls
+{
+
+/**
+ * @brief Profile of the shared mutexes of a site, taken while profiling is on.
+ */
+struct SharedLockStatistics
+{
+    static constexpr std::size_t histogram_size = 16;
+
+    struct ModeStatistics
+    {
+        std::uint64_t   acquisitions = 0;
+        std::uint64_t   contended = 0;      ///< Acquisitions that found the lock taken
+        std::uint64_t   total_wait_ns = 0;
+        std::uint64_t   max_wait_ns = 0;
+        std::uint64_t   total_hold_ns = 0;
+        std::uint64_t   max_hold_ns = 0;
+        /// Bucket i counts the times shorter than 256ns << i, the last one counts the longer ones too
+        std::array<std::uint64_t, histogram_size> wait_histogram{};
+        std::array<std::uint64_t, histogram_size> hold_histogram{};
+    };
+
+    std::string     name;
+    ModeStatistics  shared;
+    ModeStatistics  exclusive;
+};
+
+/**
+ * @class SharedLockProfile
+ * @brief Counters shared by the profiled mutexes of a site, kept for the life of the process.
+ *
+ * Profiling is off until setEnabled(true) is called, then every acquisition of a
+ * profiled mutex reads the clock.
+ */
+class SharedLockProfile final
+{
+public:
+    SharedLockProfile(const SharedLockProfile&) = delete;
+    SharedLockProfile(SharedLockProfile&&) = delete;
+
+    SharedLockProfile& operator=(const SharedLockProfile&) = delete;
+    SharedLockProfile& operator=(SharedLockProfile&&) = delete;
+
+    /**
+     * @brief Gets the counters of a site, they are created on first use.
+     */
+    static SharedLockProfile& get(std::string_view name)
+    {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto iter = registry.entries.find(name);
+        if (iter == registry.entries.end())
+            iter = registry.entries.emplace(std::string(name),
+                std::unique_ptr<SharedLockProfile>(new SharedLockProfile(name))).first;
+        return *iter->second;
+    }
+
+    /**
+     * @brief Gets the statistics of every site.
+     */
+    static std::vector<SharedLockStatistics> getAllStatistics()
+    {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        std::vector<SharedLockStatistics> result;
+        result.reserve(registry.entries.size());
+        for (const auto& [name, entry]: registry.entries)
+            result.push_back(entry->getStatistics());
+        return result;
+    }
+
+    static void setEnabled(bool enabled) noexcept
+    {
+        s_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] static bool isEnabled() noexcept
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    void recordAcquisition(bool shared, bool contended, std::uint64_t wait_ns) noexcept
+    {
+        ModeCounters& counters = shared ? m_shared : m_exclusive;
+        counters.acquisitions.fetch_add(1, std::memory_order_relaxed);
+        if (!contended)
+            return;
+        counters.contended.fetch_add(1, std::memory_order_relaxed);
+        counters.total_wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+        updateMax(counters.max_wait_ns, wait_ns);
+        counters.wait_histogram[getBucket(wait_ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void recordHold(bool shared, std::uint64_t hold_ns) noexcept
+    {
+        ModeCounters& counters = shared ? m_shared : m_exclusive;
+        counters.total_hold_ns.fetch_add(hold_ns, std::memory_order_relaxed);
+        updateMax(counters.max_hold_ns, hold_ns);
+        counters.hold_histogram[getBucket(hold_ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] SharedLockStatistics getStatistics() const
+    {
+        SharedLockStatistics statistics;
+        statistics.name = m_name;
+        m_shared.copyTo(statistics.shared);
+        m_exclusive.copyTo(statistics.exclusive);
+        return statistics;
+    }
+
+private:
+    struct Registry
+    {
+        std::mutex                                                          mutex;
+        std::map<std::string, std::unique_ptr<SharedLockProfile>, std::less<>>  entries;
+    };
+
+    struct alignas(64) ModeCounters
+    {
+        std::atomic<std::uint64_t>  acquisitions = 0;
+        std::atomic<std::uint64_t>  contended = 0;
+        std::atomic<std::uint64_t>  total_wait_ns = 0;
+        std::atomic<std::uint64_t>  max_wait_ns = 0;
+        std::atomic<std::uint64_t>  total_hold_ns = 0;
+        std::atomic<std::uint64_t>  max_hold_ns = 0;
+        std::array<std::atomic<std::uint64_t>, SharedLockStatistics::histogram_size>
+                                    wait_histogram{};
+        std::array<std::atomic<std::uint64_t>, SharedLockStatistics::histogram_size>
+                                    hold_histogram{};
+
+        void copyTo(SharedLockStatistics::ModeStatistics& statistics) const noexcept
+        {
+            statistics.acquisitions = acquisitions.load(std::memory_order_relaxed);
+            statistics.contended = contended.load(std::memory_order_relaxed);
+            statistics.total_wait_ns = total_wait_ns.load(std::memory_order_relaxed);
+            statistics.max_wait_ns = max_wait_ns.load(std::memory_order_relaxed);
+            statistics.total_hold_ns = total_hold_ns.load(std::memory_order_relaxed);
+            statistics.max_hold_ns = max_hold_ns.load(std::memory_order_relaxed);
+            for (std::size_t i = 0; i < SharedLockStatistics::histogram_size; ++i) {
+                statistics.wait_histogram[i] = wait_histogram[i].load(std::memory_order_relaxed);
+                statistics.hold_histogram[i] = hold_histogram[i].load(std::memory_order_relaxed);
+            }
+        }
+    };
+
+    explicit SharedLockProfile(std::string_view name):
+        m_name(name) {}
+
+    static Registry& getRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    static std::size_t getBucket(std::uint64_t ns) noexcept
+    {
+        return std::min<std::size_t>(std::bit_width(ns >> 8),
+            SharedLockStatistics::histogram_size - 1);
+    }
+
+    static void updateMax(std::atomic<std::uint64_t>& max, std::uint64_t value) noexcept
+    {
+        std::uint64_t current = max.load(std::memory_order_relaxed);
+        while (value > current &&
+            !max.compare_exchange_weak(current, value, std::memory_order_relaxed));
+    }
+
+    inline static std::atomic<bool> s_enabled = false;
+
+    const std::string   m_name;
+    ModeCounters        m_shared;
+    ModeCounters        m_exclusive;
+};
+
+/**
+ * @class profiled_shared_mutex
+ * @brief Drop-in std::shared_mutex that profiles its site while profiling is on.
+ *
+ * The wait of a contended acquisition and the hold time of every acquisition are
+ * recorded per mode in the SharedLockProfile of the site. The start of an exclusive
+ * hold is kept in the mutex, the starts of shared holds are kept per thread, so a
+ * shared lock must be released on the thread that took it, as std::shared_mutex
+ * requires anyway. When profiling is off the cost is one relaxed load per call.
+ */
+class profiled_shared_mutex
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    profiled_shared_mutex() = default;
+
+    /**
+     * @param name Name of the site, the mutexes of the same member share it
+     */
+    explicit profiled_shared_mutex(std::string_view name):
+        m_profile(&SharedLockProfile::get(name)) {}
+
+    ~profiled_shared_mutex() = default;
+
+    profiled_shared_mutex(const profiled_shared_mutex&) = delete;
+    profiled_shared_mutex(profiled_shared_mutex&&) = delete;
+
+    profiled_shared_mutex& operator=(const profiled_shared_mutex&) = delete;
+    profiled_shared_mutex& operator=(profiled_shared_mutex&&) = delete;
+
+    void lock()
+    {
+        if (!isProfiled()) {
+            m_mutex.lock();
+            return;
+        }
+        m_exclusive_start = acquire(false,
+            [this] { return m_mutex.try_lock(); }, [this] { m_mutex.lock(); });
+    }
+
+    bool try_lock()
+    {
+        if (!m_mutex.try_lock())
+            return false;
+        if (isProfiled()) {
+            m_exclusive_start = clock::now();
+            m_profile->recordAcquisition(false, false, 0);
+        }
+        return true;
+    }
+
+    void unlock()
+    {
+        // Read before the unlock, the next owner writes it
+        clock::time_point start = std::exchange(m_exclusive_start, clock::time_point());
+        m_mutex.unlock();
+        if (start != clock::time_point())
+            m_profile->recordHold(false, elapsedSince(start));
+    }
+
+    void lock_shared()
+    {
+        if (!isProfiled()) {
+            m_mutex.lock_shared();
+            return;
+        }
+        pushSharedHold(acquire(true,
+            [this] { return m_mutex.try_lock_shared(); }, [this] { m_mutex.lock_shared(); }));
+    }
+
+    bool try_lock_shared()
+    {
+        if (!m_mutex.try_lock_shared())
+            return false;
+        if (isProfiled()) {
+            pushSharedHold(clock::now());
+            m_profile->recordAcquisition(true, false, 0);
+        }
+        return true;
+    }
+
+    void unlock_shared()
+    {
+        m_mutex.unlock_shared();
+        if (t_shared_hold_count == 0)
+            return;
+        // Shared locks are usually released in the reverse order they were taken
+        for (std::size_t i = t_shared_hold_count; i-- > 0;) {
+            if (t_shared_holds[i].mutex != this)
+                continue;
+            clock::time_point start = t_shared_holds[i].start;
+            std::copy(t_shared_holds.begin() + i + 1, t_shared_holds.begin() + t_shared_hold_count,
+                t_shared_holds.begin() + i);
+            --t_shared_hold_count;
+            m_profile->recordHold(true, elapsedSince(start));
+            return;
+        }
+    }
+
+private:
+    struct SharedHold
+    {
+        const profiled_shared_mutex*    mutex;
+        clock::time_point               start;
+    };
+
+    /// Shared holds deeper than this on one thread aren't timed
+    static constexpr std::size_t max_shared_holds = 16;
+
+    bool isProfiled() const noexcept
+    {
+        return m_profile && SharedLockProfile::isEnabled();
+    }
+
+    static std::uint64_t elapsedSince(clock::time_point start) noexcept
+    {
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+    }
+
+    /**
+     * @brief Acquires the mutex and records the acquisition.
+     * @return Time at which the mutex was acquired
+     */
+    template<class TryLock, class Lock>
+    clock::time_point acquire(bool shared, TryLock try_lock, Lock lock)
+    {
+        if (try_lock()) {
+            m_profile->recordAcquisition(shared, false, 0);
+            return clock::now();
+        }
+        clock::time_point start = clock::now();
+        lock();
+        clock::time_point acquired = clock::now();
+        m_profile->recordAcquisition(shared, true, static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(acquired - start).count()));
+        return acquired;
+    }
+
+    void pushSharedHold(clock::time_point start) noexcept
+    {
+        if (t_shared_hold_count < max_shared_holds)
+            t_shared_holds[t_shared_hold_count++] = {this, start};
+    }
+
+    inline static thread_local std::array<SharedHold, max_shared_holds> t_shared_holds{};
+    inline static thread_local std::size_t t_shared_hold_count = 0;
+
+    std::shared_mutex   m_mutex;
+    SharedLockProfile*  m_profile = nullptr;
+    clock::time_point   m_exclusive_start{};    ///< Guarded by the mutex itself
+};
+
+} // namespace qls
+
+#endif // !PROFILED_SHARED_MUTEX_HPP
@@ -0,0 +1,118 @@
+#ifndef RECORD_RING_HPP
+#define RECORD_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+namespace Log
+{
+
+/**
+ * @class RecordRing
+ * @brief Bounded lock-free ring buffer of fixed-size records,
+ *        for many producers and a single consumer.
+ *
+ * A producer claims a slot, writes its record in place and publishes it.
+ * Each slot carries a sequence number, see the bounded queue of Dmitry Vyukov,
+ * so neither side takes a lock or allocates.
+ *
+ * @tparam RecordSize Maximum size of a record
+ * @tparam Capacity Number of slots, a power of two
+ */
+template<std::size_t RecordSize, std::size_t Capacity>
+    requires (Capacity > 0 && (Capacity & (Capacity - 1)) == 0)
+class RecordRing
+{
+public:
+    static constexpr std::size_t record_size = RecordSize;
+    static constexpr std::size_t capacity = Capacity;
+
+    /// Slot claimed by a producer
+    struct Claim
+    {
+        char*       data = nullptr;     ///< record_size bytes to write the record to
+        std::size_t position = 0;
+    };
+
+    RecordRing() :
+        m_slots(std::make_unique<Slot[]>(Capacity))
+    {
+        for (std::size_t i = 0; i < Capacity; ++i)
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    RecordRing(const RecordRing&) = delete;
+    RecordRing& operator=(const RecordRing&) = delete;
+
+    /**
+     * @brief Claims the next slot, the claim must be published.
+     * @return false if the ring buffer is full
+     */
+    bool tryClaim(Claim& claim) noexcept
+    {
+        std::size_t position = m_tail.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = m_slots[position & (Capacity - 1)];
+            std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::ptrdiff_t>(sequence - position);
+            if (difference == 0) {
+                if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    claim.data = slot.data;
+                    claim.position = position;
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Hands a written record over to the consumer.
+     * @param length Size of the record, at most record_size
+     */
+    void publish(const Claim& claim, std::size_t length) noexcept
+    {
+        Slot& slot = m_slots[claim.position & (Capacity - 1)];
+        slot.length = length;
+        slot.sequence.store(claim.position + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Passes the next ready record to a function and frees its slot.
+     *        Only the consumer thread may call this.
+     * @return false if no record is ready
+     */
+    template<class Function>
+    bool consume(Function&& function)
+    {
+        Slot& slot = m_slots[m_head & (Capacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != m_head + 1)
+            return false;
+        function(std::string_view(slot.data, slot.length));
+        // Hand the slot back to the producers
+        slot.sequence.store(m_head + Capacity, std::memory_order_release);
+        ++m_head;
+        return true;
+    }
+
+private:
+    struct alignas(64) Slot
+    {
+        std::atomic<std::size_t>    sequence;   ///< position + 1 when the record is ready
+        std::size_t                 length = 0;
+        char                        data[RecordSize];
+    };
+
+    std::unique_ptr<Slot[]>                 m_slots;
+    alignas(64) std::atomic<std::size_t>    m_tail = 0;     ///< Position of the next slot to claim
+    alignas(64) std::size_t                 m_head = 0;     ///< Position of the next record to consume
+};
+
+} // namespace Log
+
+#endif // !RECORD_RING_HPP
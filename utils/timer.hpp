@@ -1,145 +1,296 @@
 #ifndef TIMER_HPP
 #define TIMER_HPP
 
-#include <ctime>
-#include <thread>
+#include <asio.hpp>
+#include <atomic>
 #include <chrono>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
-#include <queue>
-#include <functional>
 
 namespace qls
 {
 
-class Timers
+/**
+ * @class Timers
+ * @brief Scheduler of periodic tasks on an asio executor.
+ *
+ * Each task waits on its own steady_timer and runs on its own strand, so a task
+ * never overlaps itself and no thread is kept for the scheduler. Runs are planned
+ * from the previous planned time rather than from when the task finished, so they
+ * don't drift under load. Runs missed because the executor was busy are coalesced
+ * into one instead of being caught up back to back, and an optional jitter spreads
+ * tasks with the same interval apart.
+ */
+class Timers final
 {
 public:
-    Timers() :
-        m_isRunning(true),
-        m_thread(std::bind(&Timers::workFunction, this))
+    using clock = std::chrono::steady_clock;
+    using Task = std::function<void()>;
+
+    /// Run-time statistics of a task
+    struct TaskStatistics
     {
-    }
+        std::string         name;
+        clock::duration     interval{};
+        std::size_t         run_count = 0;
+        std::size_t         coalesced_count = 0;    ///< Missed runs that were merged into a later one
+        clock::duration     total_run_time{};
+        clock::duration     max_run_time{};
+        clock::duration     max_delay{};            ///< Longest time a run started after its planned time
+        clock::time_point   next_run{};
+    };
 
-    ~Timers()
+private:
+    struct TaskState
     {
-        m_isRunning = false;
-        m_cv.notify_all();
+        TaskState(asio::any_io_executor executor, std::string task_name,
+            clock::duration task_interval, clock::duration task_jitter, Task task):
+            name(std::move(task_name)),
+            interval(task_interval),
+            jitter(task_jitter),
+            function(std::move(task)),
+            strand(asio::make_strand(std::move(executor))),
+            timer(strand) {}
 
-        if (m_thread.joinable())
-            m_thread.join();
-    }
+        const std::string                       name;
+        const clock::duration                   interval;
+        const clock::duration                   jitter;
+        Task                                    function;
+        asio::strand<asio::any_io_executor>     strand;
+        asio::steady_timer                      timer;      ///< Only used on the strand
+        clock::time_point                       planned{};  ///< Planned time of the next run, without jitter
+        std::atomic<bool>                       cancelled = false;
 
+        mutable std::mutex                      statistics_mutex;
+        TaskStatistics                          statistics;
+    };
 
-    // 添加函数任务
-    template<typename Func, typename... Args>
-    bool addTask(const std::string& taskName, long long interval, Func&& func, Args&&... args)
+public:
+    /**
+     * @class TaskHandle
+     * @brief Refers to a scheduled task, an empty handle refers to none.
+     */
+    class TaskHandle
     {
-        if (std::find(m_taskNames.begin(), m_taskNames.end(), taskName) != m_taskNames.end()) {
-            return false;
-        }
+    public:
+        TaskHandle() = default;
 
+        /**
+         * @brief Checks whether the task is still scheduled.
+         */
+        [[nodiscard]] bool isScheduled() const noexcept
         {
-            std::unique_lock<std::mutex> lock(m_mutex);
-            m_taskNames.push_back(taskName);
-            m_tasks.push({ std::clock(), taskName, std::bind(std::forward<Func>(func),
-                std::forward<Args>(args)...), interval });
+            auto state = m_state.lock();
+            return state && !state->cancelled;
         }
-        m_cv.notify_all();
 
-        return true;
+    private:
+        friend class Timers;
+
+        TaskHandle(std::weak_ptr<TaskState> state) :
+            m_state(std::move(state)) {}
+
+        std::weak_ptr<TaskState> m_state;
+    };
+
+    Timers(asio::any_io_executor executor) :
+        m_executor(std::move(executor)) {}
+    Timers(const Timers&) = delete;
+    Timers(Timers&&) = delete;
+
+    /**
+     * @brief Cancels every task, a run in progress finishes.
+     */
+    ~Timers() noexcept
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (auto& [name, state]: m_tasks)
+            cancelState(state);
+        m_tasks.clear();
     }
 
-    // 删除任务
-    void removeTask(long long postion)
+    Timers& operator=(const Timers&) = delete;
+    Timers& operator=(Timers&&) = delete;
+
+    /**
+     * @brief Adds a periodic task, its first run is one interval from now.
+     * @param taskName Name of the task, unique among the scheduled tasks
+     * @param interval Time between two runs
+     * @param func Function of the task, called on the strand of the task
+     * @param jitter Each run is delayed by a random time up to this
+     * @return Handle of the task, empty if the name is taken or the interval isn't positive
+     */
+    TaskHandle addTask(std::string_view taskName, clock::duration interval, Task func,
+        clock::duration jitter = clock::duration::zero())
     {
-        if (postion >= static_cast<long long>(m_taskNames.size()))
-            throw std::logic_error("The postion is invalid.");
+        if (interval <= clock::duration::zero() || !func)
+            return {};
 
         std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_tasks.find(taskName) != m_tasks.cend())
+            return {};
+        auto state = std::make_shared<TaskState>(m_executor, std::string(taskName),
+            interval, std::max(jitter, clock::duration::zero()), std::move(func));
+        state->statistics.name = state->name;
+        state->statistics.interval = interval;
+        state->planned = clock::now() + interval;
+        m_tasks.emplace(state->name, state);
+        lock.unlock();
 
-        std::string taskName = *(m_taskNames.begin() + postion);
-
-        m_removeTask.push(taskName);
-        m_taskNames.erase(m_taskNames.begin() + postion);
+        asio::dispatch(state->strand, [state]() { scheduleNext(state); });
+        return TaskHandle(state);
+    }
 
-        m_cv.notify_all();
+    /**
+     * @brief Cancels a task, a run in progress finishes.
+     * @return true if the task was scheduled
+     */
+    bool removeTask(const TaskHandle& handle)
+    {
+        auto state = handle.m_state.lock();
+        if (!state)
+            return false;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto iter = m_tasks.find(state->name);
+        if (iter == m_tasks.cend() || iter->second != state)
+            return false;
+        m_tasks.erase(iter);
+        return cancelState(state);
     }
 
-    // 获取任务列表
-    const std::vector<std::string>& getTaskList() const
+    /**
+     * @brief Cancels a task by name, a run in progress finishes.
+     * @return true if the task was scheduled
+     */
+    bool removeTask(std::string_view taskName)
     {
-        return m_taskNames;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto iter = m_tasks.find(taskName);
+        if (iter == m_tasks.cend())
+            return false;
+        auto state = std::move(iter->second);
+        m_tasks.erase(iter);
+        return cancelState(state);
     }
 
-protected:
-    struct Task
+    /**
+     * @brief Gets the names of the scheduled tasks.
+     */
+    [[nodiscard]] std::vector<std::string> getTaskList() const
     {
-        std::clock_t            clock = 0;
-        std::string             taskName;
-        std::function<void()>   function;
-        long long               interval = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::vector<std::string> names;
+        names.reserve(m_tasks.size());
+        for (const auto& [name, state]: m_tasks)
+            names.push_back(name);
+        return names;
+    }
 
-        Task& operator =(const Task& t)
-        {
-            if (this == &t)
-                return *this;
-
-            clock = t.clock;
-            taskName = t.taskName;
-            function = t.function;
-            interval = t.interval;
-            return *this;
+    /**
+     * @brief Gets the run-time statistics of the scheduled tasks.
+     */
+    [[nodiscard]] std::vector<TaskStatistics> getStatistics() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::vector<TaskStatistics> result;
+        result.reserve(m_tasks.size());
+        for (const auto& [name, state]: m_tasks) {
+            std::unique_lock<std::mutex> statistics_lock(state->statistics_mutex);
+            result.push_back(state->statistics);
         }
-    };
+        return result;
+    }
 
-    struct Lesser
+private:
+    struct NameHash
     {
-        bool operator()(const Task& a, const Task& b)
+        using is_transparent = void;
+
+        std::size_t operator()(std::string_view name) const noexcept
         {
-            return a.clock > b.clock;
+            return std::hash<std::string_view>{}(name);
         }
     };
 
-    void workFunction()
+    static bool cancelState(const std::shared_ptr<TaskState>& state)
+    {
+        if (state->cancelled.exchange(true))
+            return false;
+        asio::post(state->strand, [state]() { state->timer.cancel(); });
+        return true;
+    }
+
+    static clock::duration randomJitter(clock::duration jitter)
     {
-        while (m_isRunning)
+        if (jitter <= clock::duration::zero())
+            return clock::duration::zero();
+        thread_local std::minstd_rand engine(std::random_device{}());
+        std::uniform_int_distribution<clock::rep> distribution(0, jitter.count());
+        return clock::duration(distribution(engine));
+    }
+
+    /**
+     * @brief Waits for the planned time of the next run, called on the strand.
+     */
+    static void scheduleNext(const std::shared_ptr<TaskState>& state)
+    {
+        if (state->cancelled)
+            return;
+        clock::time_point run_time = state->planned + randomJitter(state->jitter);
         {
-            std::unique_lock<std::mutex> lock(m_mutex);
-            m_cv.wait(lock, [&]() {return (!m_tasks.empty() && m_tasks.top().clock <= std::clock()) || !m_isRunning; });
-            if (!m_isRunning)
+            std::unique_lock<std::mutex> lock(state->statistics_mutex);
+            state->statistics.next_run = run_time;
+        }
+        state->timer.expires_at(run_time);
+        state->timer.async_wait([state](const std::error_code& ec) {
+            if (ec || state->cancelled)
                 return;
+            run(state);
+            scheduleNext(state);
+        });
+    }
+
+    /**
+     * @brief Runs a task and plans its next run, called on the strand.
+     */
+    static void run(const std::shared_ptr<TaskState>& state)
+    {
+        auto start = clock::now();
+        try {
+            state->function();
+        } catch (...) {
+            // A failing run doesn't stop the task
+        }
+        auto end = clock::now();
 
-            if (!m_removeTask.empty() && m_removeTask.front() == m_tasks.top().taskName) {
-                m_removeTask.pop();
-                m_tasks.pop();
-                lock.unlock();
-                if (!m_tasks.empty())
-                    std::this_thread::sleep_for(std::chrono::milliseconds((m_tasks.top().clock - std::clock()) > 0 ? (m_tasks.top().clock - std::clock()) : 0));
-                continue;
-            }
-
-            Task task = m_tasks.top();
-            m_tasks.pop();
-            task.function();
-            task.clock += task.interval;
-            m_tasks.push(std::move(task));
-            lock.unlock();
-            std::this_thread::sleep_for(std::chrono::milliseconds((m_tasks.top().clock - std::clock()) > 0 ? (m_tasks.top().clock - std::clock()) : 0));
+        // Runs that were missed while the executor was busy are merged into the next one
+        std::size_t coalesced = 0;
+        state->planned += state->interval;
+        if (state->planned <= end) {
+            auto missed = (end - state->planned) / state->interval + 1;
+            state->planned += state->interval * missed;
+            coalesced = static_cast<std::size_t>(missed);
         }
+
+        std::unique_lock<std::mutex> lock(state->statistics_mutex);
+        TaskStatistics& statistics = state->statistics;
+        ++statistics.run_count;
+        statistics.coalesced_count += coalesced;
+        statistics.total_run_time += end - start;
+        statistics.max_run_time = std::max(statistics.max_run_time, end - start);
+        statistics.max_delay = std::max(statistics.max_delay, start - statistics.next_run);
     }
 
-private:
-    std::vector<std::string>    m_taskNames;
-    std::priority_queue<Task,
-        std::vector<Task>,
-        Lesser>                 m_tasks;
-    std::queue<std::string>     m_removeTask;
-
-    std::condition_variable     m_cv;
-    std::mutex                  m_mutex;
-    std::thread                 m_thread;
-    std::atomic<bool>           m_isRunning;
+    asio::any_io_executor   m_executor;
+    std::unordered_map<std::string, std::shared_ptr<TaskState>, NameHash, std::equal_to<>>
+                            m_tasks;
+    mutable std::mutex      m_mutex;
 };
 
 } // namespace qls